@@ -0,0 +1,92 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pytt.h"
+
+/*
+   Lookups one at a time with pytt_entry_get against pytt_entry_get_batch,
+   on a table too big for the cache and loaded to several entries per
+   bucket, so most of the time goes into waiting for chain pointers.
+
+   Usage: batch_bench [key_bits] [lookups] [batch]
+*/
+
+static void done(size_t i, pytt_entry_t *ent, void *arg)
+{
+  (void) i;
+  *(uint64_t *) arg += ent != NULL;
+}
+
+int main(int argc, char **argv)
+{
+  int key_bits = 22;
+  size_t lookups = 4000000;
+  size_t batch = 256;
+  uint64_t *keys;
+  const void **key_ptrs;
+  uint16_t *keylens;
+  uint64_t state = 1, i, nkeys, found;
+  double start, single, batched;
+  int shift;
+
+  if(argc > 1 && atoi(argv[1]) > 0) {
+    key_bits = atoi(argv[1]);
+  }
+  if(argc > 2 && atol(argv[2]) > 0) {
+    lookups = atol(argv[2]);
+  }
+  if(argc > 3 && atol(argv[3]) > 0) {
+    batch = atol(argv[3]);
+  }
+
+  nkeys = (uint64_t) 1 << key_bits;
+  keys = malloc(lookups * sizeof(uint64_t));
+  key_ptrs = malloc(lookups * sizeof(void *));
+  keylens = malloc(lookups * sizeof(uint16_t));
+
+  /* Half hits, half misses. */
+  for(i = 0; i != lookups; ++i) {
+    keys[i] = bench_rand(&state) % (2 * nkeys);
+    key_ptrs[i] = &keys[i];
+    keylens[i] = sizeof(uint64_t);
+  }
+
+  printf("Keys: 2^%d, lookups: %lu, batches of %lu (ns per lookup)\n", key_bits,
+	 (unsigned long) lookups, (unsigned long) batch);
+  printf("%-6s %9s %9s\n", "load", "single", "batch");
+
+  for(shift = 0; shift != 4; ++shift) {
+    pytt_t *ht = pytt_create(key_bits - shift, sizeof(uint64_t));
+
+    for(i = 0; i != nkeys; ++i) {
+      pytt_entry_create(ht, &i, sizeof(i));
+    }
+
+    found = 0;
+    start = bench_now();
+    for(i = 0; i != lookups; ++i) {
+      found += pytt_entry_get(ht, key_ptrs[i], keylens[i]) != NULL;
+    }
+    single = bench_now() - start;
+
+    start = bench_now();
+    for(i = 0; i < lookups; i += batch) {
+      pytt_entry_get_batch(ht, lookups - i < batch ? lookups - i : batch,
+			   key_ptrs + i, keylens + i, done, &found);
+    }
+    batched = bench_now() - start;
+
+    printf("%-6d %9.1f %9.1f\n", 1 << shift, single * 1e9 / lookups, batched * 1e9 / lookups);
+
+    bench_sink = found;
+    pytt_destroy(ht);
+  }
+
+  free(keys);
+  free(key_ptrs);
+  free(keylens);
+
+  return 0;
+}
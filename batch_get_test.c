@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+#define NKEYS 3000
+
+typedef struct batch_result_t
+{
+  pytt_entry_t *ents[2 * NKEYS];
+  int           calls[2 * NKEYS];
+} batch_result_t;
+
+static void done(size_t i, pytt_entry_t *ent, void *arg)
+{
+  batch_result_t *r = arg;
+
+  r->ents[i] = ent;
+  ++r->calls[i];
+}
+
+/* Looks up twice as many keys as were inserted, in one batch, and checks
+ * each against pytt_entry_get. */
+static int check(pytt_t *ht, const char *what)
+{
+  static char buffer[2 * NKEYS][16];
+  static batch_result_t r;
+  const void *keys[2 * NKEYS];
+  uint16_t keylens[2 * NKEYS];
+  int i;
+
+  memset(&r, 0, sizeof(r));
+  for(i = 0; i != 2 * NKEYS; ++i) {
+    sprintf(buffer[i], "key%d", i);
+    keys[i] = buffer[i];
+    keylens[i] = (uint16_t) strlen(buffer[i]);
+  }
+
+  pytt_entry_get_batch(ht, 2 * NKEYS, keys, keylens, done, &r);
+
+  for(i = 0; i != 2 * NKEYS; ++i) {
+    if(r.calls[i] != 1 || r.ents[i] != pytt_entry_get(ht, keys[i], keylens[i])) {
+      printf("Wrong result for %s in %s table\n", buffer[i], what);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int fill_and_check(pytt_t *ht, const char *what)
+{
+  int_entry_t *he;
+  char key[16];
+  int failure;
+  int i;
+
+  for(i = 0; i != NKEYS; ++i) {
+    sprintf(key, "key%d", i);
+    if(i % 5 != 0) {
+      he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+      he->value = i;
+    }
+  }
+
+  failure = check(ht, what);
+  pytt_destroy(ht);
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  int failure = 0;
+
+  // Few buckets, so every lookup walks a long chain.
+  failure |= fill_and_check(pytt_create(6, sizeof(int)), "chained");
+  failure |= fill_and_check(pytt_create(14, sizeof(int)), "roomy");
+  failure |= fill_and_check(pytt_create_custom(6, sizeof(int), malloc, free,
+					       PYTT_DEFAULT_HASH_INITIALIZER,
+					       PYTT_BUCKET_TAGS), "tagged");
+  failure |= fill_and_check(pytt_create_custom(6, sizeof(int), malloc, free,
+					       PYTT_DEFAULT_HASH_INITIALIZER,
+					       PYTT_TTL), "TTL");
+
+  printf("Batch get test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pytt.h"
+
+/* Every batch size up to 40 with mixed lengths and alignments, so each
+ * kernel and the leftovers after it get keys that end in every block. */
+int main(int argc, char **argv)
+{
+  static unsigned char bytes[4096];
+  const void *keys[40];
+  uint16_t keylens[40];
+  pytt_hash_t hashes[40];
+  uint32_t state = 12345;
+  int failure = 0;
+  size_t count, i;
+  int round;
+
+  for(i = 0; i != sizeof(bytes); ++i) {
+    state = state * 1103515245 + 12345;
+    bytes[i] = (unsigned char) (state >> 16);
+  }
+
+  for(round = 0; round != 50; ++round) {
+    for(count = 0; count <= 40; ++count) {
+      for(i = 0; i != count; ++i) {
+	state = state * 1103515245 + 12345;
+	keylens[i] = (uint16_t) ((state >> 16) % (round < 25 ? 17 : 100));
+	keys[i] = bytes + (state >> 8) % (sizeof(bytes) - 100);
+      }
+
+      pytt_hash_seeded_batch(PYTT_DEFAULT_HASH_INITIALIZER + round, count, keys, keylens, hashes);
+
+      for(i = 0; i != count; ++i) {
+	if(hashes[i] != pytt_hash_seeded(PYTT_DEFAULT_HASH_INITIALIZER + round, keys[i], keylens[i])) {
+	  printf("Mismatch for key %lu of %lu, length %d\n",
+		 (unsigned long) i, (unsigned long) count, keylens[i]);
+	  failure = 1;
+	}
+      }
+    }
+  }
+
+  printf("Batch hash test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
@@ -0,0 +1,194 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Bits shared by the benchmark programs. Not part of the library.
+ * Include it first, since it asks for POSIX and Linux declarations. */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_HAVE_PERF
+#endif
+
+/* Results go here so the compiler can't drop the work producing them. */
+static volatile uint64_t bench_sink;
+
+static inline double bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Cheap deterministic key stream, so runs are comparable. */
+static inline uint64_t bench_rand(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* One hardware counter for this thread, or -1 if the kernel won't give
+ * us one (no perf support, perf_event_paranoid, running in a VM, ...).
+ * Counters that had to share the PMU with others are scaled up to the
+ * whole time they were enabled. */
+static inline int bench_counter_open(uint32_t type, uint64_t config)
+{
+#ifdef BENCH_HAVE_PERF
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  (void) type;
+  (void) config;
+  return -1;
+#endif
+}
+
+static inline int bench_dtlb_open(void)
+{
+#ifdef BENCH_HAVE_PERF
+  return bench_counter_open(PERF_TYPE_HW_CACHE,
+			    PERF_COUNT_HW_CACHE_DTLB
+			    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#else
+  return -1;
+#endif
+}
+
+static inline void bench_counter_start(int fd)
+{
+#ifdef BENCH_HAVE_PERF
+  if(fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+/* Returns the count since bench_counter_start, or -1 if unavailable. */
+static inline int64_t bench_counter_stop(int fd)
+{
+#ifdef BENCH_HAVE_PERF
+  uint64_t value[3];
+
+  if(fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if(read(fd, value, sizeof(value)) == sizeof(value) && value[2]) {
+      return (int64_t) ((double) value[0] * value[1] / value[2]);
+    }
+  }
+#endif
+  (void) fd;
+  return -1;
+}
+
+static inline void bench_counter_close(int fd)
+{
+#ifdef BENCH_HAVE_PERF
+  if(fd >= 0) {
+    close(fd);
+  }
+#endif
+}
+
+/* A standard set of counters to read around a phase of a benchmark.
+ * Any of them can be missing; bench_counters_stop gives -1 for those. */
+enum
+{
+  BENCH_CYCLES,
+  BENCH_INSTRUCTIONS,
+  BENCH_L1D_MISSES,
+  BENCH_LLC_MISSES,
+  BENCH_DTLB_MISSES,
+  BENCH_BRANCH_MISSES,
+  BENCH_COUNTERS
+};
+
+static const char *const bench_counter_names[BENCH_COUNTERS] = {
+  "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses"
+};
+
+typedef struct bench_counters_t
+{
+  int fds[BENCH_COUNTERS];
+} bench_counters_t;
+
+/* Returns the number of counters that could be opened. */
+static inline int bench_counters_open(bench_counters_t *c)
+{
+  int i, opened = 0;
+
+#ifdef BENCH_HAVE_PERF
+  c->fds[BENCH_CYCLES] = bench_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  c->fds[BENCH_INSTRUCTIONS] = bench_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  c->fds[BENCH_L1D_MISSES] = bench_counter_open(PERF_TYPE_HW_CACHE,
+						PERF_COUNT_HW_CACHE_L1D
+						| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+						| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  c->fds[BENCH_LLC_MISSES] = bench_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  c->fds[BENCH_DTLB_MISSES] = bench_dtlb_open();
+  c->fds[BENCH_BRANCH_MISSES] = bench_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#else
+  for(i = 0; i != BENCH_COUNTERS; ++i) {
+    c->fds[i] = -1;
+  }
+#endif
+
+  for(i = 0; i != BENCH_COUNTERS; ++i) {
+    opened += c->fds[i] >= 0;
+  }
+
+  return opened;
+}
+
+static inline void bench_counters_start(bench_counters_t *c)
+{
+  int i;
+
+  for(i = 0; i != BENCH_COUNTERS; ++i) {
+    bench_counter_start(c->fds[i]);
+  }
+}
+
+static inline void bench_counters_stop(bench_counters_t *c, int64_t values[BENCH_COUNTERS])
+{
+  int i;
+
+  for(i = 0; i != BENCH_COUNTERS; ++i) {
+    values[i] = bench_counter_stop(c->fds[i]);
+  }
+}
+
+static inline void bench_counters_close(bench_counters_t *c)
+{
+  int i;
+
+  for(i = 0; i != BENCH_COUNTERS; ++i) {
+    bench_counter_close(c->fds[i]);
+    c->fds[i] = -1;
+  }
+}
+
+#endif /* BENCH_H */
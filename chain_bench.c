@@ -0,0 +1,139 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pytt.h"
+
+/*
+   Chain length distribution at sizes far beyond what fits in memory.
+
+   Every key is hashed exactly as pytt_entry_create would, but instead of
+   building the table we only count the keys landing in an evenly spaced
+   sample of 2^window_bits buckets. That is enough to see the shape of
+   the chain length distribution for 2^33+ keys in a few megabytes.
+
+   The same hashes are also counted truncated to 32 bits, which is what
+   tables got before pytt_hash was widened: past 2^32 buckets half the
+   table is unreachable and the other half gets twice the load.
+
+   Usage: chain_bench [key_bits] [bucket_bits] [window_bits]
+*/
+
+#define MAX_CHAIN 64
+
+static void report(const char *name, uint16_t *counts, size_t window, double load)
+{
+  uint64_t hist[MAX_CHAIN + 1];
+  uint64_t total = 0;
+  double expected = exp(-load);
+  int longest = 0;
+  size_t i;
+  int len;
+
+  memset(hist, 0, sizeof(hist));
+  for(i = 0; i != window; ++i) {
+    len = counts[i] > MAX_CHAIN ? MAX_CHAIN : counts[i];
+    ++hist[len];
+    total += counts[i];
+    if(counts[i] > longest) {
+      longest = counts[i];
+    }
+  }
+
+  printf("\n%s\n", name);
+  printf("Average chain:  %10.3f\n", (double) total / (double) window);
+  printf("Longest chain:  %8d\n", longest);
+  printf("Chain   Observed    Expected\n");
+
+  for(len = 0; len <= longest && len <= MAX_CHAIN; ++len) {
+    printf("%5d %10.6f  %10.6f\n", len, (double) hist[len] / (double) window, expected);
+    expected = expected * load / (len + 1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int key_bits = 26;
+  int bucket_bits = -1;
+  int window_bits = 20;
+  pytt_t *seed_table;
+  uint16_t *counts64, *counts32;
+  uint64_t nkeys, i;
+  size_t window;
+  int skip;
+  clock_t start;
+  double seconds;
+
+  if(argc > 1 && atoi(argv[1]) > 0) {
+    key_bits = atoi(argv[1]);
+  }
+
+  bucket_bits = key_bits;
+  if(argc > 2 && atoi(argv[2]) > 0) {
+    bucket_bits = atoi(argv[2]);
+  }
+
+  if(argc > 3 && atoi(argv[3]) > 0) {
+    window_bits = atoi(argv[3]);
+  }
+
+  if(window_bits > bucket_bits) {
+    window_bits = bucket_bits;
+  }
+
+  if(bucket_bits > 62 || key_bits > 62) {
+    fprintf(stderr, "At most 62 bits, please.\n");
+    return 1;
+  }
+
+  // Only the seed matters for hashing, so a single bucket will do.
+  seed_table = pytt_create(0, 0);
+  nkeys = (uint64_t) 1 << key_bits;
+  window = (size_t) 1 << window_bits;
+  skip = bucket_bits - window_bits;
+  counts64 = calloc(window, sizeof(uint16_t));
+  counts32 = calloc(window, sizeof(uint16_t));
+
+  start = clock();
+
+  for(i = 0; i != nkeys; ++i) {
+    unsigned char key[8];
+    pytt_hash_t hash;
+    uint64_t bucket;
+    int b;
+
+    for(b = 0; b != 8; ++b) {
+      key[b] = (unsigned char) (i >> (b * 8));
+    }
+
+    hash = pytt_hash(seed_table, key, sizeof(key));
+
+    bucket = hash & (((uint64_t) 1 << bucket_bits) - 1);
+    if(! (bucket & (((uint64_t) 1 << skip) - 1)) && counts64[bucket >> skip] != 0xffff) {
+      ++counts64[bucket >> skip];
+    }
+
+    bucket = (uint32_t) hash & (((uint64_t) 1 << bucket_bits) - 1);
+    if(! (bucket & (((uint64_t) 1 << skip) - 1)) && counts32[bucket >> skip] != 0xffff) {
+      ++counts32[bucket >> skip];
+    }
+  }
+
+  seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+  printf("Keys:           2^%d\n", key_bits);
+  printf("Buckets:        2^%d (sampled 2^%d)\n", bucket_bits, window_bits);
+  printf("Load factor:    %10.3f\n", ldexp(1.0, key_bits - bucket_bits));
+  printf("Hash rate:      %10.1f Mkeys/s\n", seconds > 0 ? nkeys / seconds / 1e6 : 0.0);
+
+  report("64-bit hash (pytt_hash):", counts64, window, ldexp(1.0, key_bits - bucket_bits));
+  report("Truncated to 32 bits:", counts32, window, ldexp(1.0, key_bits - bucket_bits));
+
+  free(counts64);
+  free(counts32);
+  pytt_destroy(seed_table);
+
+  return 0;
+}
@@ -1,110 +1,450 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #include "pytt.h"
+#include "lookup3.h"
 
-typedef struct int_entry_t
+/*
+   How well a hash function spreads a set of keys over the buckets.
+
+   The keys are hashed into 2^bucket_bits buckets the way a table would,
+   taking the low bits of the hash, and the report shows:
+
+   - bucket loads, and the chi-squared statistic of their uniformity,
+     with its z-score against a truly random hash (|z| much above 3 is
+     suspicious);
+   - the chain length distribution next to the Poisson one a random hash
+     gives at that load;
+   - the average number of entries a successful lookup compares, against
+     what a random hash would give (unsuccessful ones walk a whole chain,
+     the load factor on average, whatever the hash);
+   - avalanche: how often flipping one bit of a key flips each bit of the
+     hash, which should be half the time;
+   - the same load figures for bucket counts around the chosen one.
+
+   Keys are either data.txt-style lines from a file, loaded into a table
+   with pytt_load_text (which then also checks that the table's chains
+   are the ones predicted here), or one of the synthetic sets:
+
+     words   "key0", "key1", ...
+     ints    sequential 32-bit integers, little endian
+     random  16 random bytes each
+
+   Usage: collision_test [bucket_bits] [hash] [seed] [keys] [count]
+
+   bucket_bits 0 sizes the buckets to the keys. hash is pytt (pytt_hash,
+   the default), lookup3 (hashlittle, 32 bits) or fnv1a (64 bits, weak,
+   as a reference).
+*/
+
+#define MAX_CHAIN	   64
+#define AVALANCHE_KEYS	 2000
+#define AVALANCHE_BYTES	   16
+#define AVALANCHE_TRIALS  100
+
+typedef struct hash_func_t
 {
-  struct pytt_entry_hdr_t hdr;
-  int value;
-  char key[];
-} int_entry_t;
+  const char *name;
+  int         bits;
+  uint64_t  (*hash)(uint32_t seed, const void *key, uint16_t keylen);
+} hash_func_t;
+
+static uint64_t hash_pytt(uint32_t seed, const void *key, uint16_t keylen)
+{
+  return pytt_hash_seeded(seed, key, keylen);
+}
+
+static uint64_t hash_lookup3(uint32_t seed, const void *key, uint16_t keylen)
+{
+  return hashlittle(key, keylen, seed);
+}
+
+static uint64_t hash_fnv1a(uint32_t seed, const void *key, uint16_t keylen)
+{
+  const unsigned char *p = key;
+  uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+
+  while(keylen--) {
+    h = (h ^ *p++) * 0x100000001b3ULL;
+  }
+
+  return h;
+}
+
+static const hash_func_t hash_funcs[] = {
+  { "pytt",    64, hash_pytt },
+  { "lookup3", 32, hash_lookup3 },
+  { "fnv1a",   64, hash_fnv1a },
+};
+
+typedef struct key_set_t
+{
+  size_t           count;
+  const void     **keys;
+  uint16_t        *keylens;
+  unsigned char   *bytes;
+} key_set_t;
+
+static uint64_t next_rand(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Fills keys with a synthetic set. Returns 0 for an unknown name. */
+static int make_keys(key_set_t *keys, const char *name, size_t count)
+{
+  uint64_t state = 1;
+  size_t i, b;
+
+  if(strcmp(name, "words") && strcmp(name, "ints") && strcmp(name, "random")) {
+    return 0;
+  }
+
+  keys->count = count;
+  keys->keys = malloc(count * sizeof(void *));
+  keys->keylens = malloc(count * sizeof(uint16_t));
+  keys->bytes = malloc(count * AVALANCHE_BYTES);
+
+  for(i = 0; i != count; ++i) {
+    unsigned char *key = keys->bytes + i * AVALANCHE_BYTES;
+
+    if(name[0] == 'w') {
+      keys->keylens[i] = (uint16_t) sprintf((char *) key, "key%lu", (unsigned long) i);
+    } else if(name[0] == 'i') {
+      for(b = 0; b != 4; ++b) {
+	key[b] = (unsigned char) (i >> (b * 8));
+      }
+      keys->keylens[i] = 4;
+    } else {
+      for(b = 0; b != AVALANCHE_BYTES; ++b) {
+	key[b] = (unsigned char) next_rand(&state);
+      }
+      keys->keylens[i] = AVALANCHE_BYTES;
+    }
+    keys->keys[i] = key;
+  }
+
+  return 1;
+}
+
+/* Fills keys with the ones in ht, which must outlive them. */
+static void table_keys(key_set_t *keys, pytt_t *ht)
+{
+  pytt_entry_t *ent;
+  size_t i = 0;
+
+  keys->count = pytt_get_entry_count(ht);
+  keys->keys = malloc(keys->count * sizeof(void *));
+  keys->keylens = malloc(keys->count * sizeof(uint16_t));
+  keys->bytes = NULL;
+
+  for(ent = ht->first; ent; ent = ent->hdr.next) {
+    keys->keys[i] = pytt_entry_get_key_ptr(ht, ent);
+    keys->keylens[i++] = ent->hdr.keylen;
+  }
+}
+
+typedef struct load_stats_t
+{
+  size_t used;
+  size_t largest;
+  double chi2;
+  double z;
+  double hit_cost;
+  double ideal_hit_cost;
+} load_stats_t;
+
+/* Bucket loads of hashes in 2^bits buckets. counts may be NULL, or
+ * 2^bits zeroed counters that are left holding the loads. */
+static int bucket_loads(const uint64_t *hashes, size_t n, int bits, uint32_t *counts,
+			load_stats_t *stats)
+{
+  size_t buckets = (size_t) 1 << bits;
+  uint64_t mask = ((uint64_t) 1 << bits) - 1;
+  uint32_t *own = NULL;
+  double sum_squares = 0, expected, dof;
+  size_t i;
+
+  if(! counts) {
+    counts = own = calloc(buckets, sizeof(uint32_t));
+    if(! counts) {
+      return -1;
+    }
+  }
+
+  for(i = 0; i != n; ++i) {
+    ++counts[hashes[i] & mask];
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  for(i = 0; i != buckets; ++i) {
+    if(counts[i]) {
+      ++stats->used;
+      sum_squares += (double) counts[i] * counts[i];
+      if(counts[i] > stats->largest) {
+	stats->largest = counts[i];
+      }
+    }
+  }
+
+  // Sum of (c - E)^2 / E over the buckets, E being the load factor.
+  expected = (double) n / (double) buckets;
+  dof = (double) buckets - 1;
+  stats->chi2 = n ? sum_squares / expected - (double) n : 0;
+  stats->z = dof > 0 ? (stats->chi2 - dof) / sqrt(2 * dof) : 0;
+
+  // A hit on the k:th entry of a chain compares k entries.
+  stats->hit_cost = n ? (sum_squares + (double) n) / 2 / (double) n : 0;
+  stats->ideal_hit_cost = 1 + ((double) n - 1) / 2 / (double) buckets;
+
+  free(own);
+
+  return 0;
+}
+
+static void report_chains(const uint32_t *counts, size_t buckets, double load)
+{
+  uint64_t hist[MAX_CHAIN + 1];
+  double expected = exp(-load);
+  size_t longest = 0, i;
+  int len;
+
+  memset(hist, 0, sizeof(hist));
+  for(i = 0; i != buckets; ++i) {
+    ++hist[counts[i] > MAX_CHAIN ? MAX_CHAIN : counts[i]];
+    if(counts[i] > longest) {
+      longest = counts[i];
+    }
+  }
+
+  puts("");
+  printf("Chain   Observed    Expected\n");
+  for(len = 0; len <= (int) longest && len <= MAX_CHAIN; ++len) {
+    printf("%5d %10.6f  %10.6f\n", len, (double) hist[len] / (double) buckets, expected);
+    expected = expected * load / (len + 1);
+  }
+}
+
+/* Flips every bit in the first AVALANCHE_BYTES of a sample of the keys
+ * and counts how often each hash bit follows. */
+static void report_avalanche(const hash_func_t *func, uint32_t seed, const key_set_t *keys,
+			     int bucket_bits)
+{
+  static uint32_t flips[AVALANCHE_BYTES * 8][64];
+  uint32_t trials[AVALANCHE_BYTES * 8];
+  unsigned char key[AVALANCHE_BYTES];
+  size_t step = keys->count / AVALANCHE_KEYS + 1;
+  double bias, worst = 0, worst_bucket = 0, total = 0;
+  size_t cells = 0;
+  uint32_t fewest = 0;
+  int covered = 0;
+  size_t i;
+  int in, out, len;
+
+  memset(flips, 0, sizeof(flips));
+  memset(trials, 0, sizeof(trials));
+
+  for(i = 0; i < keys->count; i += step) {
+    uint64_t hash, diff;
+
+    // Longer keys are cut short, which is still a key to hash.
+    len = keys->keylens[i] < AVALANCHE_BYTES ? keys->keylens[i] : AVALANCHE_BYTES;
+    memcpy(key, keys->keys[i], len);
+    hash = func->hash(seed, key, (uint16_t) len);
+
+    for(in = 0; in != len * 8; ++in) {
+      key[in / 8] ^= (unsigned char) (1 << (in % 8));
+      diff = hash ^ func->hash(seed, key, (uint16_t) len);
+      key[in / 8] ^= (unsigned char) (1 << (in % 8));
+
+      ++trials[in];
+      for(out = 0; out != func->bits; ++out) {
+	flips[in][out] += (uint32_t) (diff >> out) & 1;
+      }
+    }
+  }
+
+  for(in = 0; in != AVALANCHE_BYTES * 8; ++in) {
+    // Key bits that few keys reach would only show noise.
+    if(trials[in] < AVALANCHE_TRIALS) {
+      continue;
+    }
+    ++covered;
+    if(! fewest || trials[in] < fewest) {
+      fewest = trials[in];
+    }
+    for(out = 0; out != func->bits; ++out) {
+      bias = fabs(2.0 * flips[in][out] / trials[in] - 1);
+      total += bias;
+      ++cells;
+      if(bias > worst) {
+	worst = bias;
+      }
+      if(out < bucket_bits && bias > worst_bucket) {
+	worst_bucket = bias;
+      }
+    }
+  }
+
+  puts("");
+  if(! cells) {
+    printf("Avalanche:      too few keys to flip\n");
+    return;
+  }
+  printf("Avalanche bias (0 is ideal, 1 is a bit that never or always flips):\n");
+  printf("Mean:           %10.4f\n", total / cells);
+  printf("Worst:          %10.4f\n", worst);
+  printf("Worst in index: %10.4f\n", worst_bucket);
+  printf("Noise level:    %10.4f (%d key bits, %lu flips each or more)\n",
+	 2 / sqrt((double) fewest), covered, (unsigned long) fewest);
+}
 
 int main(int argc, char **argv)
 {
-  pytt_t *ht;
-  int_entry_t *he;
+  const hash_func_t *func = &hash_funcs[0];
+  uint32_t seed = PYTT_DEFAULT_HASH_INITIALIZER;
+  const char *source = "data.txt";
+  size_t count = (size_t) 1 << 20;
+  pytt_t *ht = NULL;
+  key_set_t keys;
+  load_stats_t stats;
+  uint64_t *hashes;
+  uint32_t *counts;
   int bits = 16;
-  FILE *datafile;
-  char buffer[512];
-  int entry_count = 0;
-  int collision_count = 0;
-  int bucket_count = 0;
-  int largest_bucket = 0;
-  pytt_entry_t **bucketptr;
-
-  if(argc > 1 && atoi(argv[1])>0) {
+  int failure = 0;
+  size_t i;
+  int b;
+
+  if(argc > 1) {
     bits = atoi(argv[1]);
   }
 
-  // Really. This won't work.
-  if(bits > 32) {
-    bits = 32;
+  // The bucket array alone is 8 << bits bytes.
+  if(bits > 40) {
+    bits = 40;
   }
 
-  datafile = fopen("data.txt", "r");
-  if(! datafile) {
-    fprintf(stderr, "Unable to open data.txt.\n");
-    exit(1);
+  if(argc > 2) {
+    for(i = 0; i != sizeof(hash_funcs) / sizeof(hash_funcs[0]); ++i) {
+      if(! strcmp(argv[2], hash_funcs[i].name)) {
+	func = &hash_funcs[i];
+	break;
+      }
+    }
+    if(i == sizeof(hash_funcs) / sizeof(hash_funcs[0])) {
+      fprintf(stderr, "Unknown hash %s.\n", argv[2]);
+      exit(1);
+    }
+  }
+
+  if(argc > 3) {
+    seed = (uint32_t) strtoul(argv[3], NULL, 0);
+  }
+
+  if(argc > 4) {
+    source = argv[4];
   }
 
-  ht = pytt_create(bits, 4);
+  if(argc > 5 && atol(argv[5]) > 0) {
+    count = (size_t) atol(argv[5]);
+  }
 
-  while(fgets(buffer, 512, datafile)) {
-    char *word = strchr(buffer, ' ');
-    int idx = strlen(buffer);
-    if(word) {
-      *word = 0;
-      ++word;
+  if(! make_keys(&keys, source, count)) {
+    ht = pytt_load_text(source, bits > 0 ? bits : 0, 4, pytt_parse_int_word, NULL, 0, NULL);
+    if(! ht) {
+      fprintf(stderr, "Unable to open %s.\n", source);
+      exit(1);
     }
-    
-    while(idx-- > 0) {
-      if(buffer[idx] >= 0 && buffer[idx] <= 32) {
-	buffer[idx] = 0;
-      } else {
-	break;
-      }
+    table_keys(&keys, ht);
+    if(bits <= 0) {
+      bits = ht->bucket_bits;
+    }
+  }
+
+  if(bits <= 0) {
+    for(bits = 1; ((size_t) 1 << bits) < keys.count; ++bits) {
     }
-   
-    he = (int_entry_t *) pytt_entry_create(ht, word, strlen(word));
-    he->value = atoi(buffer);
+  }
+  if(bits > func->bits) {
+    bits = func->bits;
+  }
+
+  hashes = malloc(keys.count * sizeof(uint64_t) + 1);
+  for(i = 0; i != keys.count; ++i) {
+    hashes[i] = func->hash(seed, keys.keys[i], keys.keylens[i]);
   }
 
-  fclose(datafile);
+  counts = calloc((size_t) 1 << bits, sizeof(uint32_t));
+  if(! counts || bucket_loads(hashes, keys.count, bits, counts, &stats)) {
+    fprintf(stderr, "Not enough memory for 2^%d buckets.\n", bits);
+    exit(1);
+  }
+
+  puts("");
+  printf("Keys:           %8lu (%s)\n", (unsigned long) keys.count, source);
+  printf("Hash:           %8s (seed 0x%08x)\n", func->name, (unsigned int) seed);
+  printf("Buckets total:  %8lu\n", (unsigned long) ((size_t) 1 << bits));
+  printf("Load factor:    %10.3f\n", ldexp((double) keys.count, -bits));
+  printf("Buckets used:   %8lu\n", (unsigned long) stats.used);
+  printf("Collisions:     %8lu\n", (unsigned long) (keys.count - stats.used));
+  printf("Collision ratio:  %.4f\n", keys.count ? (double) (keys.count - stats.used) / (double) keys.count : 0.0);
+  printf("Largest bucket: %8lu\n", (unsigned long) stats.largest);
+  printf("Average bucket: %10.1f\n", stats.used ? (double) keys.count / (double) stats.used : 0.0);
+  printf("Chi-squared:    %12.1f (%lu degrees of freedom, z %.2f)\n", stats.chi2,
+	 (unsigned long) (((size_t) 1 << bits) - 1), stats.z);
+  printf("Hit cost:       %10.3f entries (random hash %.3f)\n", stats.hit_cost, stats.ideal_hit_cost);
+  printf("Miss cost:      %10.3f entries\n", ldexp((double) keys.count, -bits));
 
-  he = (int_entry_t *) ht->first;
-  while(he) {
-    ++entry_count;
-    if(! (he->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET)) {
-      ++collision_count;
+  report_chains(counts, (size_t) 1 << bits, ldexp((double) keys.count, -bits));
+  report_avalanche(func, seed, &keys, bits);
+
+  puts("");
+  printf("Bits      Load   Used  Largest    Chi2/dof       z  Hit cost  (random)\n");
+  for(b = bits - 4 > 0 ? bits - 4 : 1; b <= bits + 2 && b <= func->bits && b <= 30; ++b) {
+    if(bucket_loads(hashes, keys.count, b, NULL, &stats)) {
+      break;
     }
-    he = (int_entry_t *) he->hdr.next;
-  }
-
-  bucketptr = ht->buckets+pytt_get_bucket_count(ht);
-  while(bucketptr-- > ht->buckets) {
-    if(*bucketptr) {
-      int bucketsize = 0;
-      
-      he = (int_entry_t *) *bucketptr;
-      while(he) {
-	++bucketsize;
-	if(he->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+    printf("%4d %9.3f %5.1f%% %8lu %11.3f %7.2f %9.3f %9.3f\n", b, ldexp((double) keys.count, -b),
+	   100.0 * stats.used / ldexp(1.0, b), (unsigned long) stats.largest,
+	   stats.chi2 / (ldexp(1.0, b) - 1), stats.z, stats.hit_cost, stats.ideal_hit_cost);
+  }
+
+  // The table must have chained its entries exactly as predicted.
+  if(ht && func->hash == hash_pytt && seed == ht->hash_initializer && bits == ht->bucket_bits) {
+    for(i = 0; i != pytt_get_bucket_count(ht); ++i) {
+      pytt_entry_t *ent = ht->buckets[i];
+      uint32_t length = 0;
+
+      while(ent) {
+	++length;
+	if(ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
 	  break;
 	}
-	he = (int_entry_t *) he->hdr.next;
+	ent = ent->hdr.next;
       }
 
-      if(bucketsize > largest_bucket) {
-	largest_bucket = bucketsize;
+      if(length != counts[i]) {
+	printf("\nBucket %lu holds %lu entries instead of %lu\n", (unsigned long) i,
+	       (unsigned long) length, (unsigned long) counts[i]);
+	failure = 1;
+	break;
       }
-
-      ++bucket_count;
-    } 
+    }
   }
 
-  puts("");
-  printf("Entries:        %8d\n", entry_count);
-  printf("Buckets total:  %8d\n", pytt_get_bucket_count(ht));
-  printf("Buckets used:   %8d\n", bucket_count);
-  printf("Collisions:     %8d\n", collision_count);
-  printf("Collision ratio:  %.4f\n", (double) collision_count / (double) entry_count);
-  printf("Largest bucket: %8d\n", largest_bucket);
-  printf("Average bucket: %10.1f\n", (double) entry_count / (double) bucket_count);
-
-  pytt_destroy(ht);
+  free(counts);
+  free(hashes);
+  free(keys.keys);
+  free(keys.keylens);
+  free(keys.bytes);
+  if(ht) {
+    pytt_destroy(ht);
+  }
 
-  return 0;
+  return failure;
 }
@@ -0,0 +1,230 @@
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pytt.h"
+
+/*
+   Word counting with several threads, into one table behind a mutex
+   and into a PYTT_CONCURRENT one that they all insert into at once.
+
+   The words are drawn from data.txt at the frequencies it gives, so a
+   few words take most of the updates, like in real text. With ids, each
+   word gets a number out of 2^20 after it, which makes most tokens new
+   keys and the run mostly inserts. Times are for counting all tokens
+   split evenly over the threads; end is pytt_concurrent_end linking the
+   entries up afterwards.
+
+   Usage: concurrent_bench [tokens] [max_threads]
+*/
+
+#define MAX_WORD 48
+
+typedef struct count_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  uint64_t count;
+  char key[];
+} count_entry_t;
+
+typedef struct tokens_t
+{
+  size_t         count;
+  char          *bytes;
+  uint16_t      *lens;
+} tokens_t;
+
+typedef struct worker_t
+{
+  pytt_t         *ht;
+  const tokens_t *tokens;
+  size_t          from, to;
+  pthread_mutex_t *lock;
+} worker_t;
+
+/* Tokens drawn from data.txt's words by their counts. Returns 0 if the
+ * file can't be read. */
+static int make_tokens(tokens_t *t, size_t count, int ids)
+{
+  FILE *f = fopen("data.txt", "r");
+  char (*words)[MAX_WORD] = NULL;
+  uint64_t *cumulative = NULL, total = 0, state = 1, r;
+  size_t nwords = 0, capacity = 0, lo, hi, mid, i;
+  char line[256], word[MAX_WORD];
+  unsigned long n;
+
+  if(! f) {
+    return 0;
+  }
+
+  while(fgets(line, sizeof(line), f)) {
+    if(sscanf(line, "%lu %40s", &n, word) != 2 || ! n) {
+      continue;
+    }
+    if(nwords == capacity) {
+      capacity = capacity ? 2 * capacity : 1024;
+      words = realloc(words, capacity * MAX_WORD);
+      cumulative = realloc(cumulative, capacity * sizeof(uint64_t));
+    }
+    strcpy(words[nwords], word);
+    total += n;
+    cumulative[nwords++] = total;
+  }
+  fclose(f);
+
+  if(! nwords) {
+    free(words);
+    free(cumulative);
+    return 0;
+  }
+
+  t->count = count;
+  t->bytes = malloc(count * MAX_WORD);
+  t->lens = malloc(count * sizeof(uint16_t));
+
+  for(i = 0; i != count; ++i) {
+    r = bench_rand(&state) % total;
+    for(lo = 0, hi = nwords - 1; lo < hi; ) {
+      mid = (lo + hi) / 2;
+      if(cumulative[mid] > r) {
+	hi = mid;
+      } else {
+	lo = mid + 1;
+      }
+    }
+
+    if(ids) {
+      t->lens[i] = (uint16_t) sprintf(t->bytes + i * MAX_WORD, "%s:%lu", words[lo],
+				      (unsigned long) (bench_rand(&state) & 0xfffff));
+    } else {
+      t->lens[i] = (uint16_t) strlen(words[lo]);
+      memcpy(t->bytes + i * MAX_WORD, words[lo], t->lens[i]);
+    }
+  }
+
+  free(words);
+  free(cumulative);
+
+  return 1;
+}
+
+static void *count_locked(void *arg)
+{
+  worker_t *w = arg;
+  count_entry_t *ent;
+  size_t i;
+
+  for(i = w->from; i != w->to; ++i) {
+    pthread_mutex_lock(w->lock);
+    ent = (count_entry_t *) pytt_entry_create(w->ht, w->tokens->bytes + i * MAX_WORD,
+					      w->tokens->lens[i]);
+    ++ent->count;
+    pthread_mutex_unlock(w->lock);
+  }
+
+  return NULL;
+}
+
+static void *count_concurrent(void *arg)
+{
+  worker_t *w = arg;
+  count_entry_t *ent;
+  size_t i;
+
+  for(i = w->from; i != w->to; ++i) {
+    ent = (count_entry_t *) pytt_entry_create(w->ht, w->tokens->bytes + i * MAX_WORD,
+					      w->tokens->lens[i]);
+    __atomic_fetch_add(&ent->count, 1, __ATOMIC_RELAXED);
+  }
+
+  return NULL;
+}
+
+/* Counts the tokens with threads threads, and returns the seconds it
+ * took. *end gets the time for pytt_concurrent_end. */
+static double run(const tokens_t *t, int threads, int concurrent, double *end)
+{
+  pthread_t ids[256];
+  worker_t workers[256];
+  pthread_mutex_t lock;
+  double start, seconds;
+  unsigned int bits = 0;
+  pytt_t *ht;
+  int i;
+
+  while(((size_t) 1 << bits) < t->count / 4) {
+    ++bits;
+  }
+  ht = pytt_create_custom(bits, sizeof(uint64_t), malloc, free, PYTT_DEFAULT_HASH_INITIALIZER,
+			  concurrent ? PYTT_CONCURRENT : 0);
+  pthread_mutex_init(&lock, NULL);
+
+  start = bench_now();
+  for(i = 0; i != threads; ++i) {
+    workers[i].ht = ht;
+    workers[i].tokens = t;
+    workers[i].from = t->count * i / threads;
+    workers[i].to = t->count * (i + 1) / threads;
+    workers[i].lock = &lock;
+    pthread_create(&ids[i], NULL, concurrent ? count_concurrent : count_locked, &workers[i]);
+  }
+  for(i = 0; i != threads; ++i) {
+    pthread_join(ids[i], NULL);
+  }
+  seconds = bench_now() - start;
+
+  start = bench_now();
+  pytt_concurrent_end(ht);
+  *end = bench_now() - start;
+
+  bench_sink = pytt_get_entry_count(ht);
+  pytt_destroy(ht);
+  pthread_mutex_destroy(&lock);
+
+  return seconds;
+}
+
+int main(int argc, char **argv)
+{
+  size_t count = 4000000;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_threads = cpus > 1 ? (int) cpus : 8;
+  double locked, concurrent, end;
+  tokens_t tokens;
+  int ids, threads;
+
+  if(argc > 1 && atol(argv[1]) > 0) {
+    count = atol(argv[1]);
+  }
+  if(argc > 2 && atoi(argv[2]) > 0) {
+    max_threads = atoi(argv[2]);
+  }
+  if(max_threads > 256) {
+    max_threads = 256;
+  }
+
+  printf("%lu tokens, %ld CPUs (Mtokens/s)\n", (unsigned long) count, cpus);
+  printf("%-8s %8s %10s %10s %10s\n", "", "threads", "locked", "concurrent", "end (ms)");
+
+  for(ids = 0; ids != 2; ++ids) {
+    if(! make_tokens(&tokens, count, ids)) {
+      fprintf(stderr, "Unable to read data.txt.\n");
+      return 1;
+    }
+
+    for(threads = 1; threads <= max_threads; threads *= 2) {
+      locked = run(&tokens, threads, 0, &end);
+      concurrent = run(&tokens, threads, 1, &end);
+      printf("%-8s %8d %10.2f %10.2f %10.2f\n", ids ? "ids" : "words", threads,
+	     count / locked / 1e6, count / concurrent / 1e6, end * 1e3);
+    }
+
+    free(tokens.bytes);
+    free(tokens.lens);
+  }
+
+  return 0;
+}
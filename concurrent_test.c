@@ -0,0 +1,251 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt_inline.h"
+
+#define THREADS 8
+#define KEYS    20000
+
+typedef struct count_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int count;
+  char key[];
+} count_entry_t;
+
+typedef struct id_entry_t
+{
+  PYTT_HDR;
+  int count;
+} id_entry_t;
+
+PYTT_INLINE_TYPED(id_entry_t, id_table, uint64_t)
+
+typedef struct worker_t
+{
+  pytt_t *ht;
+  int     id;
+} worker_t;
+
+/* Every thread counts every key, in its own order, and half of them twice
+ * over, through different ways in. */
+static void *count_keys(void *arg)
+{
+  worker_t *w = arg;
+  pytt_keyvec_t parts[2];
+  count_entry_t *ent;
+  char key[32];
+  int i, k;
+
+  for(i = 0; i != KEYS; ++i) {
+    k = (int) (((unsigned int) i * 7919u + (unsigned int) w->id * 104729u) % KEYS);
+    sprintf(key, "key%d", k);
+
+    ent = (count_entry_t *) pytt_entry_create(w->ht, key, strlen(key));
+    __atomic_fetch_add(&ent->count, 1, __ATOMIC_RELAXED);
+
+    if(k % 2) {
+      parts[0].base = key;
+      parts[0].len = 3;
+      parts[1].base = key + 3;
+      parts[1].len = strlen(key) - 3;
+      ent = (count_entry_t *) pytt_entry_createv(w->ht, parts, 2);
+      __atomic_fetch_add(&ent->count, 1, __ATOMIC_RELAXED);
+    }
+
+    if(! pytt_entry_get(w->ht, key, strlen(key))) {
+      return "lost";
+    }
+  }
+
+  return NULL;
+}
+
+/* The same through the inline functions, which must not take their fast
+ * path into a table other threads insert into. */
+static void *count_ids(void *arg)
+{
+  worker_t *w = arg;
+  id_table_t *ht = (id_table_t *) w->ht;
+  id_entry_t *ent;
+  uint64_t k;
+  int i;
+
+  for(i = 0; i != KEYS; ++i) {
+    k = ((uint64_t) i * 7919u + (uint64_t) w->id * 104729u) % KEYS;
+
+    ent = id_table_entry_create(ht, k);
+    __atomic_fetch_add(&ent->count, 1, __ATOMIC_RELAXED);
+
+    if(id_table_entry_get(ht, k) != ent) {
+      return "lost";
+    }
+  }
+
+  return NULL;
+}
+
+static int run_inline(void)
+{
+  id_table_t *ht = (id_table_t *) pytt_create_custom(8, id_table_data_size, malloc, free,
+						      PYTT_DEFAULT_HASH_INITIALIZER,
+						      PYTT_CONCURRENT);
+  pthread_t threads[THREADS];
+  worker_t workers[THREADS];
+  id_entry_t *ent;
+  void *result;
+  int failure = 0;
+  uint64_t k;
+  int i;
+
+  for(i = 0; i != THREADS; ++i) {
+    workers[i].ht = (pytt_t *) ht;
+    workers[i].id = i;
+    pthread_create(&threads[i], NULL, count_ids, &workers[i]);
+  }
+  for(i = 0; i != THREADS; ++i) {
+    pthread_join(threads[i], &result);
+    if(result) {
+      printf("A thread lost an inline entry\n");
+      failure = 1;
+    }
+  }
+
+  pytt_concurrent_end((pytt_t *) ht);
+
+  if(pytt_get_entry_count((pytt_t *) ht) != KEYS) {
+    printf("%lu inline entries\n", (unsigned long) pytt_get_entry_count((pytt_t *) ht));
+    failure = 1;
+  }
+  for(k = 0; k != KEYS; ++k) {
+    ent = id_table_entry_get(ht, k);
+    if(! ent || ent->count != THREADS) {
+      printf("Wrong count for inline key %lu\n", (unsigned long) k);
+      failure = 1;
+      break;
+    }
+  }
+
+  id_table_destroy(ht);
+
+  return failure;
+}
+
+static int run(pytt_t *ht, const char *what)
+{
+  pthread_t threads[THREADS];
+  worker_t workers[THREADS];
+  count_entry_t *ent;
+  pytt_entry_t *e;
+  void *result;
+  char key[32];
+  size_t listed = 0;
+  int failure = 0;
+  int i;
+
+  for(i = 0; i != THREADS; ++i) {
+    workers[i].ht = ht;
+    workers[i].id = i;
+    pthread_create(&threads[i], NULL, count_keys, &workers[i]);
+  }
+  for(i = 0; i != THREADS; ++i) {
+    pthread_join(threads[i], &result);
+    if(result) {
+      printf("A thread lost an entry %s\n", what);
+      failure = 1;
+    }
+  }
+
+  pytt_concurrent_end(ht);
+
+  if(pytt_get_entry_count(ht) != KEYS) {
+    printf("%lu entries %s\n", (unsigned long) pytt_get_entry_count(ht), what);
+    failure = 1;
+  }
+
+  // The list is whole again, and every bucket ends where it should.
+  for(e = ht->first; e; e = e->hdr.next) {
+    if(e->hdr.next && e->hdr.next->hdr.prev != e) {
+      failure = 1;
+    }
+    ++listed;
+  }
+  if(listed != KEYS) {
+    printf("%lu entries listed %s\n", (unsigned long) listed, what);
+    failure = 1;
+  }
+
+  for(i = 0; i != KEYS; ++i) {
+    sprintf(key, "key%d", i);
+    ent = (count_entry_t *) pytt_entry_get(ht, key, strlen(key));
+    if(! ent || ent->count != (i % 2 ? 2 : 1) * THREADS) {
+      printf("Wrong count for %s %s\n", key, what);
+      return 1;
+    }
+  }
+
+  // An ordinary table again, that can go concurrent once more.
+  for(i = 0; i < KEYS; i += 2) {
+    sprintf(key, "key%d", i);
+    pytt_entry_remove(ht, key, strlen(key));
+  }
+  if(pytt_concurrent_begin(ht)) {
+    failure = 1;
+  }
+  for(i = 0; i != KEYS; ++i) {
+    sprintf(key, "key%d", i);
+    ent = (count_entry_t *) pytt_entry_get(ht, key, strlen(key));
+    if(! ent != ! (i % 2)) {
+      printf("Wrong entries after removing %s\n", what);
+      return 1;
+    }
+  }
+  for(i = 0; i != KEYS; ++i) {
+    sprintf(key, "key%d", i);
+    ent = (count_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    if(ent->count != (i % 2 ? 2 * THREADS : 0)) {
+      printf("Wrong data in %s %s\n", key, what);
+      return 1;
+    }
+  }
+
+  // pytt_destroy ends the concurrent mode by itself.
+  pytt_destroy(ht);
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  pytt_t *ht;
+  int failure = 0;
+
+  failure |= run(pytt_create_custom(16, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_CONCURRENT),
+		 "in a roomy table");
+  failure |= run(pytt_create_custom(4, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_CONCURRENT),
+		 "in long chains");
+
+  ht = pytt_create(8, sizeof(int));
+  if(pytt_concurrent_begin(ht)) {
+    failure = 1;
+  }
+  failure |= run(ht, "after pytt_concurrent_begin");
+
+  failure |= run_inline();
+
+  // Tables with parts that can't go concurrent say so.
+  ht = pytt_create_custom(8, sizeof(int), malloc, free, PYTT_DEFAULT_HASH_INITIALIZER,
+			  PYTT_BUCKET_TAGS);
+  if(! pytt_concurrent_begin(ht)) {
+    failure = 1;
+  }
+  pytt_destroy(ht);
+
+  printf("Concurrent test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
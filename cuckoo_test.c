@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pytt_cuckoo.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+int main(int argc, char **argv)
+{
+  // Start tiny so that the table has to grow a few times.
+  pytt_cuckoo_t *ht = pytt_cuckoo_create(2, sizeof(int));
+  int_entry_t *he;
+  pytt_entry_t *ent;
+  char key[32];
+  int failure = 0;
+  int count;
+  int i;
+
+  for(i = 0; i != 100000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_cuckoo_entry_create(ht, key, strlen(key) + 1);
+    he->value = i;
+  }
+
+  // Creating again returns the same entries.
+  for(i = 0; i < 100000; i += 7) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_cuckoo_entry_create(ht, key, strlen(key) + 1);
+    if(he->value != i) {
+      failure = 1;
+    }
+  }
+
+  for(i = 0; i < 100000; i += 2) {
+    sprintf(key, "key%d", i);
+    pytt_cuckoo_entry_remove(ht, key, strlen(key) + 1);
+  }
+
+  for(i = 0; i != 100000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_cuckoo_entry_get(ht, key, strlen(key) + 1);
+    if((i & 1) ? (! he || he->value != i || strcmp(he->key, key)) : he != NULL) {
+      printf("Wrong result for %s\n", key);
+      failure = 1;
+    }
+  }
+
+  count = 0;
+  for(ent = ht->first; ent; ent = ent->hdr.next) {
+    ++count;
+  }
+
+  printf("%d entries, %d listed, 2^%d buckets\n", (int) ht->count, count, ht->bucket_bits);
+  if(count != 50000 || ht->count != 50000) {
+    failure = 1;
+  }
+
+  printf("Cuckoo test %s.\n", failure ? "failed" : "succeeded");
+
+  pytt_cuckoo_destroy(ht);
+
+  return failure;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pytt_frozen.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+int main(int argc, char **argv)
+{
+  pytt_t *ht = pytt_create(16, sizeof(int));
+  pytt_frozen_t *fz;
+  int_entry_t *he;
+  const void *key_ptr;
+  uint16_t keylen;
+  size_t slot;
+  char key[64];
+  int failure = 0;
+  int *value;
+  int i;
+
+  // An empty table freezes into an empty index.
+  fz = pytt_freeze(ht);
+  if(! fz || fz->count || pytt_frozen_get(fz, "key", 3)) {
+    failure = 1;
+  }
+  pytt_frozen_destroy(fz);
+
+  for(i = 0; i != 100000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+
+  fz = pytt_freeze(ht);
+  if(! fz || fz->count != 100000) {
+    printf("Freezing failed\n");
+    return 1;
+  }
+
+  // Short keys get records of one size, found without an offset.
+  if(! fz->stride || fz->offsets) {
+    printf("Short keys have offsets\n");
+    failure = 1;
+  }
+
+  for(i = 0; i != 200000; ++i) {
+    sprintf(key, "key%d", i);
+    value = pytt_frozen_get(fz, key, strlen(key));
+    if(i < 100000 ? (! value || *value != i) : value != NULL) {
+      printf("Wrong result for %s\n", key);
+      failure = 1;
+    }
+  }
+
+  // Every slot holds exactly one entry.
+  for(slot = 0; slot != fz->count; ++slot) {
+    value = pytt_frozen_at(fz, slot, &key_ptr, &keylen);
+    if(pytt_frozen_get(fz, key_ptr, keylen) != value) {
+      printf("Slot %lu is not reachable\n", (unsigned long) slot);
+      failure = 1;
+    }
+  }
+
+  // The table is untouched and the copy independent of it.
+  pytt_destroy(ht);
+  value = pytt_frozen_get(fz, "key4711", 7);
+  if(! value || *value != 4711) {
+    failure = 1;
+  }
+
+  printf("%lu entries in %lu bytes (%.1f per entry), %lu slots, seed %x\n",
+	 (unsigned long) fz->count, (unsigned long) pytt_frozen_memory(fz),
+	 (double) pytt_frozen_memory(fz) / fz->count, (unsigned long) fz->slot_count, fz->seed);
+
+  pytt_frozen_destroy(fz);
+
+  // Long keys of different lengths are found through offsets.
+  ht = pytt_create(10, sizeof(int));
+  for(i = 0; i != 1000; ++i) {
+    sprintf(key, "%0*d", 24 + i % 20, i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+  fz = pytt_freeze(ht);
+  pytt_destroy(ht);
+  if(! fz || fz->stride || ! fz->offsets) {
+    printf("Long keys have no offsets\n");
+    return 1;
+  }
+  for(i = 0; i != 1000; ++i) {
+    sprintf(key, "%0*d", 24 + i % 20, i);
+    value = pytt_frozen_get(fz, key, strlen(key));
+    if(! value || *value != i) {
+      printf("Wrong result for %s\n", key);
+      failure = 1;
+    }
+    value = pytt_frozen_at(fz, (size_t) i, &key_ptr, &keylen);
+    if(pytt_frozen_get(fz, key_ptr, keylen) != value) {
+      failure = 1;
+    }
+  }
+  pytt_frozen_destroy(fz);
+
+  printf("Frozen test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
@@ -0,0 +1,97 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pytt.h"
+
+/*
+   Hash throughput for short keys, one at a time with pytt_hash_seeded and
+   in batches with pytt_hash_seeded_batch.
+
+   Usage: hash_bench [keys] [batch]
+*/
+
+#define MAX_KEY 16
+
+int main(int argc, char **argv)
+{
+  size_t nkeys = 4096;
+  size_t batch = 64;
+  size_t rounds;
+  unsigned char *bytes;
+  const void **keys;
+  uint16_t *keylens;
+  pytt_hash_t *hashes;
+  uint64_t state = 1, sum = 0;
+  double start, seconds;
+  size_t i, j;
+  int lengths[] = { 4, 8, 12, 16, 0 };
+  size_t r;
+  int l;
+
+  if(argc > 1 && atol(argv[1]) > 0) {
+    nkeys = atol(argv[1]);
+  }
+  if(argc > 2 && atol(argv[2]) > 0) {
+    batch = atol(argv[2]);
+  }
+
+  // About 20M hashes per measurement, whatever the number of keys.
+  rounds = 20000000 / nkeys + 1;
+
+  bytes = malloc(nkeys * MAX_KEY);
+  keys = malloc(nkeys * sizeof(void *));
+  keylens = malloc(nkeys * sizeof(uint16_t));
+  hashes = malloc(nkeys * sizeof(pytt_hash_t));
+
+  for(i = 0; i != nkeys * MAX_KEY; ++i) {
+    bytes[i] = (unsigned char) bench_rand(&state);
+  }
+
+  printf("%lu keys, batches of %lu (Mkeys/s)\n", (unsigned long) nkeys, (unsigned long) batch);
+  printf("%-8s %10s %10s\n", "length", "single", "batch");
+
+  // 0 stands for lengths mixed between 1 and MAX_KEY.
+  for(l = 0; l != sizeof(lengths) / sizeof(lengths[0]); ++l) {
+    for(i = 0; i != nkeys; ++i) {
+      keys[i] = bytes + i * MAX_KEY;
+      keylens[i] = (uint16_t) (lengths[l] ? (uint64_t) lengths[l] : 1 + bench_rand(&state) % MAX_KEY);
+    }
+
+    if(lengths[l]) {
+      printf("%-8d ", lengths[l]);
+    } else {
+      printf("%-8s ", "1-16");
+    }
+
+    start = bench_now();
+    for(r = 0; r != rounds; ++r) {
+      for(i = 0; i != nkeys; ++i) {
+	sum += pytt_hash_seeded(PYTT_DEFAULT_HASH_INITIALIZER, keys[i], keylens[i]);
+      }
+    }
+    seconds = bench_now() - start;
+    printf("%10.1f ", nkeys * rounds / seconds / 1e6);
+
+    start = bench_now();
+    for(r = 0; r != rounds; ++r) {
+      for(i = 0; i < nkeys; i += batch) {
+	j = nkeys - i < batch ? nkeys - i : batch;
+	pytt_hash_seeded_batch(PYTT_DEFAULT_HASH_INITIALIZER, j, keys + i, keylens + i, hashes + i);
+      }
+      sum += hashes[nkeys - 1];
+    }
+    seconds = bench_now() - start;
+    printf("%10.1f\n", nkeys * rounds / seconds / 1e6);
+  }
+
+  bench_sink = sum;
+
+  free(bytes);
+  free(keys);
+  free(keylens);
+  free(hashes);
+
+  return 0;
+}
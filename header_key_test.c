@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+#include "pytt_cuckoo.h"
+#include "pytt_robin.h"
+
+/* Built once like the library, and once with PYTT_HEADER_KEY_BYTES set
+ * differently and PYTT_EXPECT_MISMATCH, where no table may be made. */
+#ifdef PYTT_EXPECT_MISMATCH
+#define MATCH 0
+#else
+#define MATCH 1
+#endif
+
+#if PYTT_HEADER_KEY_BYTES > 0
+#define SHORT_KEY(ent) ((void *) (ent)->hdr.short_key)
+#else
+#define SHORT_KEY(ent) NULL
+#endif
+
+int main(int argc, char **argv)
+{
+  pytt_cuckoo_t *ct;
+  pytt_robin_t *rt;
+  pytt_t *ht;
+  uint16_t flags;
+  int failure = 0;
+
+  if(pytt_header_key_bytes_match(PYTT_HEADER_KEY_BYTES) != MATCH
+     || pytt_header_key_bytes_match(PYTT_HEADER_KEY_BYTES + 1)) {
+    printf("Wrong answer about PYTT_HEADER_KEY_BYTES %d\n", PYTT_HEADER_KEY_BYTES);
+    failure = 1;
+  }
+
+  ht = pytt_create(4, sizeof(int));
+  if(! ht != ! MATCH) {
+    failure = 1;
+  }
+  if(ht) {
+    pytt_destroy(ht);
+  }
+
+  ht = pytt_create_custom(4, sizeof(int), malloc, free, PYTT_DEFAULT_HASH_INITIALIZER, 0);
+  if(! ht != ! MATCH) {
+    failure = 1;
+  }
+  if(ht) {
+    pytt_destroy(ht);
+  }
+
+  // Keys that fit in the header are kept only there, longer ones after
+  // the data, for both layouts.
+  for(flags = 0; MATCH && flags <= PYTT_VARIABLE_DATA; flags += PYTT_VARIABLE_DATA) {
+    char key[40];
+    pytt_entry_t *ent;
+    int len, i;
+
+    ht = pytt_create_custom(4, sizeof(int), malloc, free, PYTT_DEFAULT_HASH_INITIALIZER, flags);
+    for(len = 1; len <= (int) sizeof(key); ++len) {
+      memset(key, 'a' + len, len);
+      ent = pytt_entry_create_sized(ht, key, len, sizeof(int));
+      *(int *) pytt_entry_data(ht, ent) = len;
+    }
+    for(len = 1; len <= (int) sizeof(key); ++len) {
+      memset(key, 'a' + len, len);
+      ent = pytt_entry_get(ht, key, len);
+      if(! ent || *(int *) pytt_entry_data(ht, ent) != len
+	 || memcmp(pytt_entry_get_key_ptr(ht, ent), key, len)
+	 || (len <= PYTT_HEADER_KEY_BYTES) != (pytt_entry_get_key_ptr(ht, ent) == SHORT_KEY(ent))) {
+	printf("Wrong entry for a %d byte key\n", len);
+	failure = 1;
+      }
+    }
+    for(len = 1; len <= (int) sizeof(key); len += 2) {
+      memset(key, 'a' + len, len);
+      pytt_entry_remove(ht, key, len);
+    }
+    for(i = 0, ent = ht->first; ent; ent = ent->hdr.next, ++i) {
+      if(ent->hdr.keylen % 2 || memchr(pytt_entry_get_key_ptr(ht, ent), 'a' + ent->hdr.keylen,
+				       ent->hdr.keylen) == NULL) {
+	failure = 1;
+      }
+    }
+    if(i != (int) sizeof(key) / 2) {
+      failure = 1;
+    }
+    pytt_destroy(ht);
+  }
+
+  ct = pytt_cuckoo_create(4, sizeof(int));
+  rt = pytt_robin_create(4, sizeof(int));
+  if(! ct != ! MATCH || ! rt != ! MATCH) {
+    failure = 1;
+  }
+  if(ct) {
+    pytt_cuckoo_destroy(ct);
+  }
+  if(rt) {
+    pytt_robin_destroy(rt);
+  }
+
+  printf("Header key test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
@@ -0,0 +1,85 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pytt.h"
+
+/*
+   Random lookups in a large table, with and without PYTT_HUGE_PAGES,
+   reporting time and dTLB misses per lookup.
+
+   Usage: hugepage_bench [bucket_bits] [key_bits] [numa_node]
+*/
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  uint64_t value;
+  char key[];
+} int_entry_t;
+
+static void run(const char *name, int bucket_bits, int key_bits, uint16_t flags, int numa_node)
+{
+  pytt_t *ht = pytt_create_numa(bucket_bits, sizeof(uint64_t), flags, numa_node);
+  uint64_t nkeys = (uint64_t) 1 << key_bits;
+  uint64_t lookups = nkeys * 2;
+  uint64_t state = 1, i, sum = 0;
+  int fd = bench_dtlb_open();
+  double start, insert_time, lookup_time;
+  int64_t misses;
+
+  start = bench_now();
+  for(i = 0; i != nkeys; ++i) {
+    int_entry_t *ent = (int_entry_t *) pytt_entry_create(ht, &i, sizeof(i));
+    ent->value = i;
+  }
+  insert_time = bench_now() - start;
+
+  bench_counter_start(fd);
+  start = bench_now();
+  for(i = 0; i != lookups; ++i) {
+    uint64_t key = bench_rand(&state) & (nkeys - 1);
+    int_entry_t *ent = (int_entry_t *) pytt_entry_get(ht, &key, sizeof(key));
+    sum += ent->value;
+  }
+  lookup_time = bench_now() - start;
+  misses = bench_counter_stop(fd);
+  bench_counter_close(fd);
+
+  printf("%-12s %10.1f %10.1f ", name, insert_time * 1e9 / nkeys, lookup_time * 1e9 / lookups);
+  if(misses >= 0) {
+    printf("%12.3f\n", (double) misses / lookups);
+  } else {
+    printf("%12s\n", "n/a");
+  }
+
+  bench_sink = sum;
+
+  pytt_destroy(ht);
+}
+
+int main(int argc, char **argv)
+{
+  int bucket_bits = 24;
+  int key_bits = 22;
+  int numa_node = -1;
+
+  if(argc > 1 && atoi(argv[1]) > 0) {
+    bucket_bits = atoi(argv[1]);
+  }
+  if(argc > 2 && atoi(argv[2]) > 0) {
+    key_bits = atoi(argv[2]);
+  }
+  if(argc > 3) {
+    numa_node = atoi(argv[3]);
+  }
+
+  printf("Buckets: 2^%d, keys: 2^%d, NUMA node: %d\n", bucket_bits, key_bits, numa_node);
+  printf("%-12s %10s %10s %12s\n", "", "ns/insert", "ns/lookup", "dTLB/lookup");
+
+  run("4K pages", bucket_bits, key_bits, 0, numa_node);
+  run("Huge pages", bucket_bits, key_bits, PYTT_HUGE_PAGES, numa_node);
+
+  return 0;
+}
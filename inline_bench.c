@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pytt_inline.h"
+
+/*
+   The same uint64_t-keyed table through the generic typed wrappers and
+   through PYTT_INLINE_TYPED. Small tables show the call, hash and compare
+   overhead; large ones show how much of it cache misses hide.
+
+   Usage: inline_bench [key_bits] [lookups]
+*/
+
+typedef struct int_entry_t
+{
+  PYTT_HDR;
+  uint64_t value;
+} int_entry_t;
+
+PYTT_TYPED_WITH_OPTIONS(int_entry_t, generic_table, &key, sizeof(key), PYTT_NO_INITIALIZER,
+			uint64_t key)
+
+PYTT_INLINE_TYPED(int_entry_t, inline_table, uint64_t)
+
+static void report(const char *name, double insert_time, double lookup_time,
+		   uint64_t nkeys, uint64_t lookups)
+{
+  printf("%-10s %10.1f %10.1f\n", name, insert_time * 1e9 / nkeys, lookup_time * 1e9 / lookups);
+}
+
+static void run(int key_bits, uint64_t lookups)
+{
+  uint64_t nkeys = (uint64_t) 1 << key_bits;
+  uint64_t state, i, sum;
+  double start, insert_time;
+  generic_table_t *gt;
+  inline_table_t *it;
+
+  printf("\nKeys: 2^%d\n", key_bits);
+  printf("%-10s %10s %10s\n", "", "ns/insert", "ns/lookup");
+
+  gt = generic_table_create(key_bits);
+  start = bench_now();
+  for(i = 0; i != nkeys; ++i) {
+    generic_table_entry_create(gt, i)->value = i;
+  }
+  insert_time = bench_now() - start;
+
+  state = 1;
+  sum = 0;
+  start = bench_now();
+  for(i = 0; i != lookups; ++i) {
+    int_entry_t *ent = generic_table_entry_get(gt, bench_rand(&state) & (2 * nkeys - 1));
+    sum += ent ? ent->value : 0;
+  }
+  report("generic", insert_time, bench_now() - start, nkeys, lookups);
+  bench_sink = sum;
+  generic_table_destroy(gt);
+
+  it = inline_table_create(key_bits);
+  start = bench_now();
+  for(i = 0; i != nkeys; ++i) {
+    inline_table_entry_create(it, i)->value = i;
+  }
+  insert_time = bench_now() - start;
+
+  state = 1;
+  sum = 0;
+  start = bench_now();
+  for(i = 0; i != lookups; ++i) {
+    int_entry_t *ent = inline_table_entry_get(it, bench_rand(&state) & (2 * nkeys - 1));
+    sum += ent ? ent->value : 0;
+  }
+  report("inline", insert_time, bench_now() - start, nkeys, lookups);
+  bench_sink = sum;
+  inline_table_destroy(it);
+}
+
+int main(int argc, char **argv)
+{
+  int key_bits = 0;
+  uint64_t lookups = 10000000;
+
+  if(argc > 1 && atoi(argv[1]) > 0) {
+    key_bits = atoi(argv[1]);
+  }
+  if(argc > 2 && atol(argv[2]) > 0) {
+    lookups = atol(argv[2]);
+  }
+
+  if(key_bits) {
+    run(key_bits, lookups);
+  } else {
+    run(10, lookups);
+    run(22, lookups);
+  }
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt_inline.h"
+
+typedef struct point_entry_t
+{
+  PYTT_HDR;
+  double value;
+} point_entry_t;
+
+typedef struct
+{
+  uint32_t x, y, z;
+} point_t;
+
+typedef struct int_entry_t
+{
+  PYTT_HDR;
+  int value;
+} int_entry_t;
+
+PYTT_INLINE_TYPED(int_entry_t, int_table, uint64_t)
+PYTT_INLINE_TYPED(point_entry_t, point_table, point_t)
+
+int main(int argc, char **argv)
+{
+  unsigned char bytes[64];
+  int_table_t *ht;
+  point_table_t *pt;
+  int_entry_t *ie;
+  point_entry_t *pe;
+  point_t p;
+  uint64_t key;
+  size_t len;
+  int failure = 0;
+  int i;
+
+  // The inline hash has to agree with pytt_hash for every length.
+  for(i = 0; i != sizeof(bytes); ++i) {
+    bytes[i] = (unsigned char) (i * 37 + 11);
+  }
+  for(len = 0; len <= sizeof(bytes); ++len) {
+    for(i = 0; i != 4; ++i) {
+      uint32_t seed = PYTT_DEFAULT_HASH_INITIALIZER + i * 0x01000193;
+      // Misaligned on purpose, lookup3 reads aligned keys differently.
+      const void *k = bytes + (i & 3);
+      size_t n = len + (i & 3) > sizeof(bytes) ? sizeof(bytes) - (i & 3) : len;
+
+      if(pytt_inline_hash(seed, k, n) != pytt_hash_seeded(seed, k, (uint16_t) n)) {
+	printf("Hash mismatch for length %lu\n", (unsigned long) n);
+	failure = 1;
+      }
+    }
+  }
+
+  ht = int_table_create(10);
+  for(key = 0; key != 10000; ++key) {
+    int_table_entry_create(ht, key)->value = (int) key;
+  }
+
+  // Inline and generic calls find each other's entries.
+  for(key = 0; key != 20000; ++key) {
+    ie = int_table_entry_get(ht, key);
+    if(key < 10000 ? (! ie || ie->value != (int) key) : ie != NULL) {
+      printf("Wrong result for %lu\n", (unsigned long) key);
+      failure = 1;
+    }
+    if((int_entry_t *) pytt_entry_get((pytt_t *) ht, &key, sizeof(key)) != ie) {
+      failure = 1;
+    }
+  }
+
+  key = 20000;
+  pytt_entry_create((pytt_t *) ht, &key, sizeof(key));
+  if(! int_table_entry_get(ht, key) || int_table_entry_create(ht, key) != int_table_entry_get(ht, key)) {
+    failure = 1;
+  }
+
+  for(key = 0; key < 10000; key += 2) {
+    int_table_entry_remove(ht, key);
+  }
+  for(key = 0; key != 10000; ++key) {
+    if(! int_table_entry_get(ht, key) != ! (key & 1)) {
+      failure = 1;
+    }
+  }
+
+  i = 0;
+  for(ie = ht->first; ie; ie = int_table_entry_next(ie)) {
+    ++i;
+  }
+  if(i != 5001) {
+    failure = 1;
+  }
+
+  int_table_destroy(ht);
+
+  // PYTT_VARIABLE_DATA entries keep their key first, so the inline
+  // functions must leave them to the library.
+  ht = (int_table_t *) pytt_create_custom(8, sizeof(int), malloc, free,
+					  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_VARIABLE_DATA);
+  for(key = 0; key != 1000; ++key) {
+    if(key & 1) {
+      ie = (int_entry_t *) pytt_entry_create_sized((pytt_t *) ht, &key, sizeof(key), sizeof(int));
+    } else {
+      // No data yet, like from pytt_entry_create.
+      ie = int_table_entry_create(ht, key);
+      ie = (int_entry_t *) pytt_entry_set_data_size((pytt_t *) ht, (pytt_entry_t *) ie,
+						    sizeof(int));
+    }
+    *(int *) pytt_entry_data((pytt_t *) ht, (pytt_entry_t *) ie) = (int) key;
+  }
+  for(key = 0; key != 1000; ++key) {
+    ie = int_table_entry_get(ht, key);
+    if(! ie || ie != (int_entry_t *) pytt_entry_get((pytt_t *) ht, &key, sizeof(key))
+       || ie != int_table_entry_create(ht, key)
+       || *int_table_entry_key(ie) != key
+       || *(int *) pytt_entry_data((pytt_t *) ht, (pytt_entry_t *) ie) != (int) key) {
+      printf("Wrong variable-data entry for %lu\n", (unsigned long) key);
+      failure = 1;
+      break;
+    }
+  }
+  if(pytt_get_entry_count((pytt_t *) ht) != 1000) {
+    printf("%lu variable-data entries\n", (unsigned long) pytt_get_entry_count((pytt_t *) ht));
+    failure = 1;
+  }
+  int_table_destroy(ht);
+
+  pt = point_table_create(4);
+  p.x = 1;
+  p.y = 2;
+  p.z = 3;
+  point_table_entry_create(pt, p)->value = 1.5;
+  pe = point_table_entry_get(pt, p);
+  if(! pe || pe->value != 1.5 || point_table_entry_key(pe)->z != 3) {
+    failure = 1;
+  }
+  p.z = 4;
+  if(point_table_entry_get(pt, p)) {
+    failure = 1;
+  }
+  point_table_destroy(pt);
+
+  printf("Inline test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
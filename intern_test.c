@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  pytt_handle_t key;
+} int_entry_t;
+
+const char *countWords[] = {"zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten", NULL};
+
+int main(int argc, char **argv)
+{
+  pytt_intern_t *pool = pytt_intern_create(6);
+  pytt_t *squares = pytt_create_interned(5, sizeof(int), pool);
+  pytt_t *doubles = pytt_create_interned(5, sizeof(int), pool);
+  const char **word;
+  int_entry_t *he;
+  int failure = 0;
+  int count;
+
+  for(word = countWords, count = 0; *word; ++word, ++count) {
+    he = (int_entry_t *) pytt_entry_create(squares, *word, strlen(*word));
+    he->value = count * count;
+    he = (int_entry_t *) pytt_entry_create(doubles, *word, strlen(*word));
+    he->value = count * 2;
+  }
+
+  // Both tables share one copy of each key.
+  printf("Pool holds %d keys\n", (int) pytt_intern_count(pool));
+  if(pytt_intern_count(pool) != 11) {
+    failure = 1;
+  }
+
+  puts("Lookups:");
+  for(word = countWords, count = 0; *word; ++word, ++count) {
+    pytt_handle_t handle = pytt_intern_find(pool, *word, strlen(*word));
+    int_entry_t *sq = (int_entry_t *) pytt_entry_get_handle(squares, handle);
+    int_entry_t *db = (int_entry_t *) pytt_entry_get(doubles, *word, strlen(*word));
+    uint16_t keylen;
+    const char *key = pytt_intern_get(pool, sq->key, &keylen);
+
+    printf("%.*s = %d, %d\n", (int) keylen, key, sq->value, db->value);
+
+    if(sq->value != count * count || db->value != count * 2
+       || sq->key != handle || db->key != handle
+       || pytt_entry_get_key_ptr(squares, (pytt_entry_t *) sq) != key) {
+      failure = 1;
+    }
+  }
+
+  if(pytt_entry_get(squares, "eleven", 6) || pytt_intern_find(pool, "eleven", 6) != PYTT_NO_HANDLE) {
+    puts("Found a key that was never added");
+    failure = 1;
+  }
+
+  pytt_entry_remove(squares, "four", 4);
+  if(pytt_entry_get(squares, "four", 4) || ! pytt_entry_get(doubles, "four", 4)) {
+    puts("Removal from one table affected the wrong entries");
+    failure = 1;
+  }
+
+  printf("Intern test %s.\n", failure ? "failed" : "succeeded");
+
+  pytt_destroy(squares);
+  pytt_destroy(doubles);
+  pytt_intern_destroy(pool);
+
+  return failure;
+}
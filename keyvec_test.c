@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+/* Splits key into parts at the cuts, some of them empty. */
+static int split(const char *key, size_t keylen, pytt_keyvec_t *parts, uint64_t *state)
+{
+  size_t at = 0, len;
+  int count = 0;
+
+  while(at < keylen || count == 0) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    len = (size_t) (*state >> 33) % 20;
+    if(len > keylen - at) {
+      len = keylen - at;
+    }
+    parts[count].base = key + at;
+    parts[count].len = len;
+    at += len;
+    ++count;
+  }
+
+  return count;
+}
+
+/* A composite key: tenant id, user id and a name. */
+static int composite(pytt_keyvec_t *parts, const uint32_t *tenant, const uint64_t *user,
+		     const char *name)
+{
+  parts[0].base = tenant;
+  parts[0].len = sizeof(*tenant);
+  parts[1].base = user;
+  parts[1].len = sizeof(*user);
+  parts[2].base = name;
+  parts[2].len = strlen(name);
+
+  return 3;
+}
+
+static int run(pytt_t *ht, const char *what)
+{
+  pytt_keyvec_t parts[3];
+  char flat[64];
+  uint32_t tenant;
+  uint64_t user;
+  int_entry_t *he;
+  int failure = 0;
+  int i, count;
+
+  for(i = 0; i != 10000; ++i) {
+    tenant = i % 7;
+    user = i;
+    count = composite(parts, &tenant, &user, i % 2 ? "profile" : "settings.json");
+    he = (int_entry_t *) pytt_entry_createv(ht, parts, count);
+    he->value = i;
+  }
+
+  for(i = 0; i != 10000; ++i) {
+    tenant = i % 7;
+    user = i;
+    count = composite(parts, &tenant, &user, i % 2 ? "profile" : "settings.json");
+
+    // The same entry in parts and in one piece.
+    memcpy(flat, &tenant, 4);
+    memcpy(flat + 4, &user, 8);
+    strcpy(flat + 12, (const char *) parts[2].base);
+
+    he = (int_entry_t *) pytt_entry_getv(ht, parts, count);
+    if(! he || he->value != i
+       || (pytt_entry_t *) he != pytt_entry_get(ht, flat, 12 + parts[2].len)
+       || (pytt_entry_t *) he != pytt_entry_createv(ht, parts, count)) {
+      printf("Wrong entry for %d %s\n", i, what);
+      return 1;
+    }
+
+    // Same length, different parts.
+    parts[2].base = i % 2 ? "profilf" : "settings.jsoo";
+    if(pytt_entry_getv(ht, parts, count)) {
+      printf("False match for %d %s\n", i, what);
+      return 1;
+    }
+  }
+
+  for(i = 0; i < 10000; i += 2) {
+    tenant = i % 7;
+    user = i;
+    count = composite(parts, &tenant, &user, "settings.json");
+    pytt_entry_removev(ht, parts, count);
+    if(pytt_entry_getv(ht, parts, count)) {
+      failure = 1;
+    }
+  }
+
+  pytt_destroy(ht);
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  pytt_keyvec_t parts[128];
+  static char big[70000];
+  char key[128];
+  uint64_t state = 1;
+  size_t keylen, i;
+  int failure = 0;
+  int count, round;
+
+  // Every way of cutting a key up hashes like the whole key.
+  for(keylen = 0; keylen != 100; ++keylen) {
+    for(i = 0; i != keylen; ++i) {
+      key[i] = (char) (keylen * 31 + i);
+    }
+    for(round = 0; round != 50; ++round) {
+      count = split(key, keylen, parts, &state);
+      if(pytt_hash_seededv(1234, parts, count) != pytt_hash_seeded(1234, key, keylen)) {
+	printf("Wrong hash for %lu bytes in %d parts\n", (unsigned long) keylen, count);
+	failure = 1;
+      }
+    }
+  }
+
+  failure |= run(pytt_create(10, sizeof(int)), "in a chained table");
+  failure |= run(pytt_create_custom(10, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS),
+		 "in a tagged table");
+  failure |= run(pytt_create_interned(10, sizeof(int), NULL), "in an interned table");
+
+  // Keys too long for an entry are never there.
+  parts[0].base = big;
+  parts[0].len = sizeof(big);
+  {
+    pytt_t *ht = pytt_create(4, sizeof(int));
+    if(pytt_entry_createv(ht, parts, 1) || pytt_entry_getv(ht, parts, 1)) {
+      failure = 1;
+    }
+    pytt_destroy(ht);
+  }
+
+  printf("Key vector test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
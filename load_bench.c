@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pytt.h"
+
+/*
+   Compares loading a "<int> <word>" file the way collision_test used to
+   (fgets, strchr, atoi) with pytt_load_text.
+
+   Usage: load_bench [file] [threads]
+          load_bench -g lines file     (writes a synthetic file first)
+*/
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void generate(const char *path, long lines)
+{
+  FILE *f = fopen(path, "w");
+  long i;
+
+  if(! f) {
+    fprintf(stderr, "Unable to write %s.\n", path);
+    exit(1);
+  }
+
+  for(i = 0; i != lines; ++i) {
+    fprintf(f, "%ld word%lxsuffix%ld\n", lines - i, i * 2654435761UL % (lines * 4), i % 97);
+  }
+
+  fclose(f);
+}
+
+static pytt_t *load_fgets(const char *path, unsigned int bits, size_t *bytes)
+{
+  FILE *datafile = fopen(path, "r");
+  char buffer[512];
+  pytt_t *ht;
+  int_entry_t *he;
+
+  if(! datafile) {
+    return NULL;
+  }
+
+  *bytes = 0;
+  ht = pytt_create(bits, 4);
+
+  while(fgets(buffer, 512, datafile)) {
+    char *word = strchr(buffer, ' ');
+    int idx = strlen(buffer);
+    *bytes += idx;
+    if(! word) {
+      continue;
+    }
+    *word = 0;
+    ++word;
+
+    while(idx-- > 0) {
+      if(buffer[idx] >= 0 && buffer[idx] <= 32) {
+	buffer[idx] = 0;
+      } else {
+	break;
+      }
+    }
+
+    he = (int_entry_t *) pytt_entry_create(ht, word, strlen(word));
+    he->value = atoi(buffer);
+  }
+
+  fclose(datafile);
+
+  return ht;
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = "data.txt";
+  int threads = 0;
+  pytt_load_stats_t stats;
+  size_t bytes = 0;
+  double start, seconds;
+  unsigned int bits;
+  pytt_t *ht;
+
+  if(argc > 3 && ! strcmp(argv[1], "-g")) {
+    generate(argv[3], atol(argv[2]));
+    path = argv[3];
+  } else {
+    if(argc > 1) {
+      path = argv[1];
+    }
+    if(argc > 2) {
+      threads = atoi(argv[2]);
+    }
+  }
+
+  ht = pytt_load_text(path, 0, 4, NULL, NULL, 1, &stats);
+  if(! ht) {
+    fprintf(stderr, "Unable to load %s.\n", path);
+    return 1;
+  }
+  bits = 0;
+  while(((size_t) 1 << bits) < pytt_get_bucket_count(ht)) {
+    ++bits;
+  }
+  pytt_destroy(ht);
+
+  start = now_seconds();
+  ht = load_fgets(path, bits, &bytes);
+  seconds = now_seconds() - start;
+  pytt_destroy(ht);
+
+  printf("File:           %s, %lu bytes\n", path, (unsigned long) bytes);
+  printf("fgets/atoi:     %10.1f MB/s\n", bytes / seconds / 1e6);
+
+  ht = pytt_load_text(path, bits, 4, NULL, NULL, 1, &stats);
+  pytt_destroy(ht);
+  printf("pytt_load_text: %10.1f MB/s (%d thread)\n", stats.mb_per_sec, stats.threads);
+
+  ht = pytt_load_text(path, bits, 4, NULL, NULL, threads, &stats);
+  pytt_destroy(ht);
+  printf("pytt_load_text: %10.1f MB/s (%d threads)\n", stats.mb_per_sec, stats.threads);
+  printf("Lines:          %8lu\n", (unsigned long) stats.lines);
+  printf("Records:        %8lu\n", (unsigned long) stats.records);
+
+  return 0;
+}
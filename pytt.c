@@ -1,236 +1,2317 @@
+/* Without pytt.h's checking macros, which would turn the definitions of
+ * the create functions below into calls. */
+#define PYTT_BUILDING_LIBRARY
+
 #include <stdlib.h>
 #include <string.h>
 #include "lookup3.h"
 #include "pytt.h"
+#include "pytt_inline.h"
+#include "pytt_mem.h"
 
-#define PYTT_DEFAULT_HASH_INITIALIZER         0x20071023
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-static void ll_insert_before(pytt_entry_t *pos, pytt_entry_t *node)
+/* The atomics PYTT_CONCURRENT tables need. MSVC has no __atomic
+ * builtins, but on x86 and x64 its volatile loads acquire, and its
+ * interlocked functions are full barriers. */
+static pytt_entry_t *atomic_load_entry(pytt_entry_t **p)
 {
-  node->hdr.prev = pos->hdr.prev;
-  node->hdr.next = pos;
-	
-  if(node->hdr.prev) {
-    node->hdr.prev->hdr.next = node;
+#if defined(_MSC_VER)
+  return *(pytt_entry_t *volatile *) p;
+#else
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/* Stores desired in *p if it still holds *expected, and returns 1.
+ * Otherwise puts what *p holds in *expected and returns 0. */
+static int atomic_cas_entry(pytt_entry_t **p, pytt_entry_t **expected, pytt_entry_t *desired)
+{
+#if defined(_MSC_VER)
+  pytt_entry_t *old;
+
+#if defined(_WIN64)
+  old = (pytt_entry_t *) _InterlockedCompareExchangePointer((void *volatile *) p, desired,
+							     *expected);
+#else
+  old = (pytt_entry_t *) (size_t) _InterlockedCompareExchange((long volatile *) p,
+							       (long) (size_t) desired,
+							       (long) (size_t) *expected);
+#endif
+  if(old == *expected) {
+    return 1;
   }
+  *expected = old;
+  return 0;
+#else
+  return __atomic_compare_exchange_n(p, expected, desired, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE);
+#endif
+}
 
-  if(node->hdr.next) {
-    node->hdr.next->hdr.prev = node;
+static void atomic_inc_size(size_t *p)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+  _InterlockedExchangeAdd64((__int64 volatile *) p, 1);
+#elif defined(_MSC_VER)
+  _InterlockedExchangeAdd((long volatile *) p, 1);
+#else
+  __atomic_fetch_add(p, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Timer wheel geometry: PYTT_WHEEL_LEVELS levels of PYTT_WHEEL_SLOTS slots.
+ * Level n has a granularity of PYTT_WHEEL_SLOTS^n ticks, so the wheel spans
+ * 2^24 ticks before entries start getting parked in the last slot of the
+ * top level and cascaded around again. */
+#define PYTT_WHEEL_BITS                       6
+#define PYTT_WHEEL_SLOTS                      (1<<PYTT_WHEEL_BITS)
+#define PYTT_WHEEL_MASK                       (PYTT_WHEEL_SLOTS-1)
+#define PYTT_WHEEL_LEVELS                     4
+
+/* Expiry bookkeeping for PYTT_TTL tables. It lives in front of the
+ * entry header so that the key-at-end-of-data layout is unchanged. */
+struct pytt_ttl_t
+{
+  uint64_t       expires;       /* 0 means never */
+  pytt_entry_t  *wnext;         /* Next entry in the same timer wheel slot */
+  pytt_entry_t **wpprev;        /* The pointer that points to us */
+};
+
+/* Rounded up to 16 bytes to keep the entry as aligned as malloc made it. */
+#define PYTT_TTL_PREFIX   ((sizeof(struct pytt_ttl_t) + 15) & ~(size_t) 15)
+#define ENTRY_TTL(ent)    ((struct pytt_ttl_t *) ((char *) (ent) - PYTT_TTL_PREFIX))
+
+struct pytt_wheel_t
+{
+  uint64_t       now;           /* Time as last given by the user */
+  uint64_t       tick;          /* All slots before this one have been drained */
+  size_t         count;         /* Number of entries in the wheel */
+  pytt_entry_t  *slots[PYTT_WHEEL_LEVELS][PYTT_WHEEL_SLOTS];
+};
+
+/* Lookup metadata for PYTT_BUCKET_TAGS tables, one cache line per bucket.
+ * The first PYTT_TAG_WAYS entries of a bucket get a slot with a 16-bit tag
+ * from their hash and a pointer to them, so a lookup checks the tags and
+ * touches only an entry whose tag matches. The rest of a long chain is
+ * counted in overflow and searched the usual way. */
+#define PYTT_TAG_WAYS                         6
+#define PYTT_TAG_ALIGN                        64
+
+struct pytt_tags_t
+{
+  uint16_t       tags[PYTT_TAG_WAYS];   /* 0 means the slot is free */
+  uint16_t       overflow;              /* Entries in the bucket without a slot */
+  uint16_t       pad;
+  pytt_entry_t  *ents[PYTT_TAG_WAYS];
+};
+
+/* Copy-on-write snapshots. Each snapshot keeps the buckets that changed
+ * after it was taken, as copies of their entries, in a small open
+ * addressing map by bucket. A bucket that changed after a newer snapshot
+ * was taken, but not before, is the same for both, so lookups check the
+ * snapshot and then the newer ones, and only then the live table. Writes
+ * only ever save into the newest snapshot. */
+struct pytt_snapshot_saved_t
+{
+  size_t         bucket_plus_one;       /* 0 means the slot is free */
+  pytt_entry_t  *chain;                 /* Copies, NULL for an empty bucket */
+};
+
+struct pytt_snapshot_t
+{
+  pytt_t        *ht;
+  struct pytt_snapshot_t *older;
+  struct pytt_snapshot_t *newer;
+  struct pytt_snapshot_saved_t *saved;
+  size_t         saved_count;
+  size_t         saved_capacity;        /* A power of two, or 0 */
+};
+
+/* Entry arena for PYTT_HUGE_PAGES and NUMA bound tables. Entries are
+ * carved out of large page-allocated chunks and recycled through free
+ * lists by size, in steps of PYTT_ARENA_ALIGN. Blocks too big for the
+ * free lists get pages of their own. */
+#define PYTT_ARENA_ALIGN                      16
+#define PYTT_ARENA_CLASSES                    256
+#define PYTT_ARENA_CHUNK                      PYTT_HUGE_PAGE_SIZE
+
+struct pytt_arena_chunk_t
+{
+  struct pytt_arena_chunk_t *next;
+  size_t         size;
+};
+
+#define PYTT_ARENA_CHUNK_HDR  ((sizeof(struct pytt_arena_chunk_t) + PYTT_ARENA_ALIGN - 1) \
+			       & ~(size_t) (PYTT_ARENA_ALIGN - 1))
+
+struct pytt_arena_t
+{
+  struct pytt_arena_chunk_t *chunks;
+  char          *cursor;        /* Free space in the newest chunk */
+  char          *limit;
+  void          *free[PYTT_ARENA_CLASSES];
+  int            huge;
+  int            numa_node;
+  int            paged_header;  /* The table header came from pytt_pages_alloc */
+};
+
+/* Size of a page allocation, rounded to whole huge pages when that
+ * doesn't waste too much. */
+static size_t paged_size(size_t size, int huge)
+{
+  if(huge && size >= PYTT_HUGE_PAGE_SIZE / 2) {
+    return (size + PYTT_HUGE_PAGE_SIZE - 1) & ~(PYTT_HUGE_PAGE_SIZE - 1);
   }
+
+  return size;
 }
 
-pytt_t *pytt_create(unsigned int bucket_bits, size_t data_size)
+/* Blocks larger than this get pages of their own. */
+static int arena_is_large(size_t size)
 {
-  return pytt_create_custom(bucket_bits,
-			    data_size,
-			    &malloc,
-			    &free, 
-			    PYTT_DEFAULT_HASH_INITIALIZER,
-			    0);
+  return size > (PYTT_ARENA_CLASSES - 1) * PYTT_ARENA_ALIGN;
 }
 
-pytt_t *pytt_create_custom(unsigned int		bucket_bits,
-			   size_t		data_size,
-			   pytt_allocator_f	alloc,
-			   pytt_deallocator_f	dealloc,
-			   uint32_t		hash_initializer,
-			   uint16_t		flags)
+static void *arena_alloc(struct pytt_arena_t *arena, size_t size)
 {
-  pytt_t *ht;
-  uint32_t nbuckets = 1<<(bucket_bits);
-  uint32_t table_size = sizeof(pytt_t) + nbuckets * sizeof(pytt_entry_t *);
+  size_t cls;
+  void *p;
 
-  if((flags & PYTT_MALLOC_TABLE_HEADER) || !alloc) {
-    ht = malloc(table_size);
-  } else {
-    ht = alloc(table_size);
+  size = (size + PYTT_ARENA_ALIGN - 1) & ~(size_t) (PYTT_ARENA_ALIGN - 1);
+  cls = size / PYTT_ARENA_ALIGN;
+
+  if(cls >= PYTT_ARENA_CLASSES) {
+    return pytt_pages_alloc(paged_size(size, arena->huge), arena->huge, arena->numa_node);
   }
 
-  memset(ht, 0, table_size);
+  if(arena->free[cls]) {
+    p = arena->free[cls];
+    memcpy(&arena->free[cls], p, sizeof(void *));
+    return p;
+  }
 
-  if(alloc) {
-    ht->alloc = alloc;
-  } else {
-    ht->alloc = malloc;
+  if((size_t) (arena->limit - arena->cursor) < size) {
+    struct pytt_arena_chunk_t *chunk =
+      pytt_pages_alloc(PYTT_ARENA_CHUNK, arena->huge, arena->numa_node);
+
+    chunk->size = PYTT_ARENA_CHUNK;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->cursor = (char *) chunk + PYTT_ARENA_CHUNK_HDR;
+    arena->limit = (char *) chunk + PYTT_ARENA_CHUNK;
   }
 
-  if(dealloc) {
-    ht->dealloc = dealloc;
-  } else {
-    ht->dealloc = free;
+  p = arena->cursor;
+  arena->cursor += size;
+
+  return p;
+}
+
+static void arena_free(struct pytt_arena_t *arena, void *p, size_t size)
+{
+  size_t cls;
+
+  size = (size + PYTT_ARENA_ALIGN - 1) & ~(size_t) (PYTT_ARENA_ALIGN - 1);
+  cls = size / PYTT_ARENA_ALIGN;
+
+  if(cls >= PYTT_ARENA_CLASSES) {
+    pytt_pages_free(p, paged_size(size, arena->huge));
+    return;
   }
 
-  ht->data_size	       = data_size;
-  ht->bucket_bits      = bucket_bits;
-  ht->flags	       = flags;
-  ht->hash_initializer = hash_initializer;
-  ht->first	       = NULL;
+  memcpy(p, &arena->free[cls], sizeof(void *));
+  arena->free[cls] = p;
+}
 
-  return ht;
+/* Releases every chunk at once. Blocks with pages of their own must
+ * have been freed already. */
+static void arena_release(struct pytt_arena_t *arena)
+{
+  struct pytt_arena_chunk_t *chunk = arena->chunks;
+
+  while(chunk) {
+    struct pytt_arena_chunk_t *next = chunk->next;
+    pytt_pages_free(chunk, chunk->size);
+    chunk = next;
+  }
+
+  memset(arena->free, 0, sizeof(arena->free));
+  arena->chunks = NULL;
+  arena->cursor = arena->limit = NULL;
 }
 
-uint32_t pytt_get_bucket_count(pytt_t *ht)
+static size_t entry_prefix(pytt_t *ht)
 {
-  return 1<<(ht->bucket_bits);
+  return (ht->flags & PYTT_TTL) ? PYTT_TTL_PREFIX : 0;
 }
 
-void *pytt_entry_get_key_ptr(pytt_t *ht, pytt_entry_t *ent)
+/* Keys that fit in the header live there instead of after the data.
+ * Interned tables keep the handle after the data, where the entry types
+ * declare it. */
+static int key_in_header(pytt_t *ht, uint16_t keylen)
+{
+#if PYTT_HEADER_KEY_BYTES > 0
+  return keylen <= PYTT_HEADER_KEY_BYTES && ! ht->intern;
+#else
+  return 0;
+#endif
+}
+
+static char *entry_key(pytt_t *ht, pytt_entry_t *ent)
 {
+#if PYTT_HEADER_KEY_BYTES > 0
+  if(key_in_header(ht, ent->hdr.keylen)) {
+    return ent->hdr.short_key;
+  }
+#endif
   return ent->data + ht->data_size;
 }
 
-pytt_entry_t *pytt_entry_create(pytt_t *ht, const void *key, uint16_t keylen)
+/* PYTT_VARIABLE_DATA entries have the key first, where a data_size of 0
+ * puts it, then their data size, aligned, then their data. */
+static size_t var_size_offset(pytt_t *ht, uint16_t keylen)
 {
-  unsigned int	 mask	= (1<<(ht->bucket_bits))-1;
-  unsigned int	 bucket = hashlittle(key, keylen, ht->hash_initializer) & mask;
-  pytt_entry_t	*ent	= NULL;
-  pytt_entry_t	*before = NULL;
+  size_t tail = key_in_header(ht, keylen) ? 0 : keylen;
 
-  /* Check for possible collision */
-  pytt_entry_t *b = ht->buckets[bucket];
-  while(b) {
+  return (tail + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
 
-    /* If we find an entry already exists for this key, return it. */
-    if(b->hdr.keylen == keylen && !memcmp(b->data + ht->data_size, key, keylen)) {
-      return b;
-    }
+static size_t var_data_offset(pytt_t *ht, uint16_t keylen)
+{
+  return var_size_offset(ht, keylen) + sizeof(uint64_t);
+}
 
-    /* If we're at the end of the collision list, we need look no further. */
-    if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
-      break;
-    }
+static size_t entry_data_size(pytt_t *ht, pytt_entry_t *ent)
+{
+  uint64_t size;
 
-    b = b->hdr.next;
+  if(! (ht->flags & PYTT_VARIABLE_DATA)) {
+    return ht->data_size;
   }
 
-  if(! ent) {
-    uint32_t ent_size = sizeof(pytt_entry_t) + keylen + ht->data_size;
-    ent = ht->alloc(ent_size);
-    memcpy(ent->data + ht->data_size, key, keylen);
-    ent->hdr.keylen = keylen;
-	ent->hdr.prev = NULL;
-	ent->hdr.next = NULL;
-	ent->hdr.flags = 0;
-
-    if(ht->buckets[bucket]) {
-      before = ht->buckets[bucket];
-    } else {
-      before = ht->first;
-      ent->hdr.flags |= PYTT_ENTRY_LAST_IN_BUCKET;
-    }
+  memcpy(&size, ent->data + var_size_offset(ht, ent->hdr.keylen), sizeof(size));
+  return (size_t) size;
+}
 
-    if(before) {
-      ll_insert_before(before, ent);
-    }
+/* Bytes after the header of an entry. */
+static size_t entry_tail_size(pytt_t *ht, uint16_t keylen, size_t data_size)
+{
+  if(ht->flags & PYTT_VARIABLE_DATA) {
+    return var_data_offset(ht, keylen) + data_size;
+  }
+
+  return data_size + (key_in_header(ht, keylen) ? 0 : keylen);
+}
+
+/* Bytes allocated for an entry, including any prefix. */
+static size_t entry_size(pytt_t *ht, uint16_t keylen, size_t data_size)
+{
+  return entry_prefix(ht) + sizeof(pytt_entry_t) + entry_tail_size(ht, keylen, data_size);
+}
+
+static size_t entry_block_size(pytt_t *ht, pytt_entry_t *ent)
+{
+  return entry_size(ht, ent->hdr.keylen, entry_data_size(ht, ent));
+}
+
+static pytt_entry_t *entry_alloc(pytt_t *ht, uint16_t keylen, size_t data_size)
+{
+  size_t prefix = entry_prefix(ht);
+  char *block;
 
-    ht->buckets[bucket] = ent;
+  if(ht->arena) {
+    block = arena_alloc(ht->arena, entry_size(ht, keylen, data_size));
+  } else {
+    block = ht->alloc(entry_size(ht, keylen, data_size));
   }
 
-  if(! ent->hdr.prev) {
-    ht->first = ent;
+  if(prefix) {
+    memset(block, 0, prefix);
   }
 
-  if(ht->create_callback) {
-    ht->create_callback(ent);
+  return (pytt_entry_t *) (block + prefix);
+}
+
+static void entry_free(pytt_t *ht, pytt_entry_t *ent)
+{
+  char *block = (char *) ent - entry_prefix(ht);
+
+  if(ht->arena) {
+    arena_free(ht->arena, block, entry_block_size(ht, ent));
+  } else {
+    ht->dealloc(block);
   }
+}
 
-  return ent;
+static void *header_alloc(pytt_t *ht, size_t size)
+{
+  if(ht->flags & PYTT_MALLOC_TABLE_HEADER) {
+    return malloc(size);
+  }
+
+  return ht->alloc(size);
 }
 
-pytt_entry_t *pytt_entry_get(pytt_t *ht, const void *key, uint16_t keylen)
+static void header_free(pytt_t *ht, void *p)
+{
+  if(ht->flags & PYTT_MALLOC_TABLE_HEADER) {
+    free(p);
+  } else {
+    ht->dealloc(p);
+  }
+}
+
+static void wheel_link(struct pytt_wheel_t *w, pytt_entry_t *ent)
 {
-  unsigned int mask = (1<<(ht->bucket_bits))-1;
-  unsigned int bucket = hashlittle(key, keylen, ht->hash_initializer) & mask;
+  struct pytt_ttl_t *ttl = ENTRY_TTL(ent);
+  uint64_t expires = ttl->expires;
+  pytt_entry_t **slot;
+  int level;
 
-  pytt_entry_t *b = ht->buckets[bucket];
-  while(b) {
-    if(b->hdr.keylen == keylen && !memcmp(b->data + ht->data_size, key, keylen)) {
-      return b;
+  if(expires <= w->tick) {
+    /* Already due. Put it in the slot currently being drained. */
+    slot = &w->slots[0][w->tick & PYTT_WHEEL_MASK];
+  } else {
+    for(level = 0; level != PYTT_WHEEL_LEVELS - 1; ++level) {
+      int shift = level * PYTT_WHEEL_BITS;
+      if((expires >> shift) - (w->tick >> shift) < PYTT_WHEEL_SLOTS) {
+	break;
+      }
     }
 
-    if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
-      return NULL;
+    if(level == PYTT_WHEEL_LEVELS - 1
+       && (expires >> (level * PYTT_WHEEL_BITS)) - (w->tick >> (level * PYTT_WHEEL_BITS))
+          >= PYTT_WHEEL_SLOTS) {
+      /* Too far into the future. Park it in the slot that gets cascaded
+       * last; it will be placed again from there. */
+      expires = w->tick + ((uint64_t) PYTT_WHEEL_MASK << (level * PYTT_WHEEL_BITS));
     }
 
-    b = b->hdr.next;
+    slot = &w->slots[level][(expires >> (level * PYTT_WHEEL_BITS)) & PYTT_WHEEL_MASK];
   }
 
-  return NULL;
+  ttl->wnext = *slot;
+  ttl->wpprev = slot;
+  if(*slot) {
+    ENTRY_TTL(*slot)->wpprev = &ttl->wnext;
+  }
+  *slot = ent;
+  ++w->count;
 }
 
-void pytt_entry_remove(pytt_t *ht, const void *key, uint16_t keylen)
+static void wheel_unlink(struct pytt_wheel_t *w, pytt_entry_t *ent)
 {
-  pytt_entry_t *ent = pytt_entry_get(ht, key, keylen);
+  struct pytt_ttl_t *ttl = ENTRY_TTL(ent);
 
-  if(ent) {
-    pytt_entry_destroy(ht, ent);
+  if(! ttl->wpprev) {
+    return;
+  }
+
+  *ttl->wpprev = ttl->wnext;
+  if(ttl->wnext) {
+    ENTRY_TTL(ttl->wnext)->wpprev = ttl->wpprev;
   }
+
+  ttl->wnext = NULL;
+  ttl->wpprev = NULL;
+  --w->count;
 }
 
-void pytt_entry_destroy(pytt_t *ht, pytt_entry_t *ent)
+/* Re-places every entry in a slot relative to the current tick. */
+static void wheel_cascade(struct pytt_wheel_t *w, int level)
 {
-  if(ht->remove_callback) {
-    ht->remove_callback(ent);
-  }
+  pytt_entry_t **slot = &w->slots[level][(w->tick >> (level * PYTT_WHEEL_BITS)) & PYTT_WHEEL_MASK];
+  pytt_entry_t *ent = *slot;
 
-  if (ent->hdr.prev) {
-    ent->hdr.prev->hdr.next = ent->hdr.next;
+  *slot = NULL;
+  while(ent) {
+    pytt_entry_t *next = ENTRY_TTL(ent)->wnext;
+    --w->count;
+    ENTRY_TTL(ent)->wpprev = NULL;
+    wheel_link(w, ent);
+    ent = next;
+  }
+}
 
-    if (ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
-      // If we're removing the last entry in a bucket, we
-      // must set that flag on the previous item. We do not
-      // need to check that the previous item is in the same
-      // bucket because if it it not, it will be the last entry
-      // in that bucket.
+/* The first tick after the current one at which a slot of some level
+ * is due, to be drained or cascaded, or UINT64_MAX if the wheel is
+ * empty. Level 0 is drained before this is called, so its current slot
+ * counts as a whole turn away. */
+static uint64_t wheel_next(struct pytt_wheel_t *w)
+{
+  uint64_t next = UINT64_MAX, at;
+  int level, shift, delta;
 
-      ent->hdr.prev->hdr.flags |= PYTT_ENTRY_LAST_IN_BUCKET;
+  for(level = 0; level != PYTT_WHEEL_LEVELS; ++level) {
+    shift = level * PYTT_WHEEL_BITS;
+    for(delta = 1; delta <= PYTT_WHEEL_SLOTS; ++delta) {
+      if(w->slots[level][((w->tick >> shift) + delta) & PYTT_WHEEL_MASK]) {
+	at = ((w->tick >> shift) + delta) << shift;
+	if(at < next) {
+	  next = at;
+	}
+	break;
+      }
     }
+  }
 
-  } else {
-    ht->first = ent->hdr.next;
+  return next;
+}
+
+static int entry_expired(pytt_t *ht, pytt_entry_t *ent)
+{
+  uint64_t expires;
+
+  if(! ht->wheel) {
+    return 0;
   }
 
-  if(ent->hdr.next) {
-    ent->hdr.next->hdr.prev = ent->hdr.prev;
+  expires = ENTRY_TTL(ent)->expires;
+  return expires && expires <= ht->wheel->now;
+}
+
+static void ll_insert_before(pytt_entry_t *pos, pytt_entry_t *node)
+{
+  node->hdr.prev = pos->hdr.prev;
+  node->hdr.next = pos;
+	
+  if(node->hdr.prev) {
+    node->hdr.prev->hdr.next = node;
+  }
+
+  if(node->hdr.next) {
+    node->hdr.next->hdr.prev = node;
   }
+}
 
-  ht->dealloc(ent);
+int pytt_header_key_bytes_match(unsigned int header_key_bytes)
+{
+  return header_key_bytes == PYTT_HEADER_KEY_BYTES;
 }
 
+pytt_t *pytt_create(unsigned int bucket_bits, size_t data_size)
+{
+  return pytt_create_custom(bucket_bits,
+			    data_size,
+			    &malloc,
+			    &free, 
+			    PYTT_DEFAULT_HASH_INITIALIZER,
+			    0);
+}
 
-pytt_entry_t *pytt_entry_create_z(pytt_t *ht, const char *key)
+static size_t table_size(unsigned int bucket_bits)
 {
-	return pytt_entry_create(ht, key, (uint16_t) strlen(key)+1);
+  return sizeof(pytt_t) + ((size_t) 1<<(bucket_bits)) * sizeof(pytt_entry_t *);
 }
 
-pytt_entry_t *pytt_entry_get_z(pytt_t *ht, const char *key)
+static size_t tags_size(pytt_t *ht, unsigned int bucket_bits)
 {
-	return pytt_entry_get(ht, key, (uint16_t) strlen(key)+1);
+  size_t size = ((size_t) 1<<(bucket_bits)) * sizeof(struct pytt_tags_t);
+
+  return ht->arena ? paged_size(size, ht->arena->huge) : size;
 }
 
-void pytt_entry_remove_z(pytt_t *ht, const char *key)
+/* Zeroed tags for 2^bucket_bits buckets, from the arena's pages for tables
+ * that have one and from alloc otherwise. alloc promises no alignment, so
+ * the tags start at the next PYTT_TAG_ALIGN boundary, with the pointer to
+ * free kept just before them. NULL if there is no memory, the table then
+ * goes without, see tags_fail. */
+static struct pytt_tags_t *tags_alloc(pytt_t *ht, unsigned int bucket_bits)
 {
-	pytt_entry_remove(ht, key, (uint16_t) strlen(key)+1);
+  size_t size = tags_size(ht, bucket_bits);
+  char *block, *tags;
+
+  if(ht->arena) {
+    return pytt_pages_alloc(size, ht->arena->huge, ht->arena->numa_node);
+  }
+
+  block = header_alloc(ht, size + sizeof(void *) + PYTT_TAG_ALIGN);
+  if(! block) {
+    return NULL;
+  }
+
+  tags = (char *) (((uintptr_t) block + sizeof(void *) + PYTT_TAG_ALIGN - 1)
+		   & ~(uintptr_t) (PYTT_TAG_ALIGN - 1));
+  memcpy(tags - sizeof(void *), &block, sizeof(void *));
+  memset(tags, 0, size);
+  return (struct pytt_tags_t *) tags;
 }
 
+static void tags_free(pytt_t *ht, struct pytt_tags_t *tags, unsigned int bucket_bits)
+{
+  void *block;
 
-void pytt_destroy(pytt_t *ht)
+  if(ht->arena) {
+    pytt_pages_free(tags, tags_size(ht, bucket_bits));
+  } else {
+    memcpy(&block, (char *) tags - sizeof(void *), sizeof(void *));
+    header_free(ht, block);
+  }
+}
+
+/* The tags only speed lookups up, so a table that can't get memory for
+ * them carries on without. */
+static void tags_fail(pytt_t *ht)
 {
-  pytt_entry_t *ent = ht->first;
-	
-  while(ent) {
-    pytt_entry_t *next = ent->hdr.next;
-    if(ht->remove_callback) {
-      ht->remove_callback(ent);
+  ht->tags = NULL;
+  ht->flags &= ~PYTT_BUCKET_TAGS;
+}
+
+static pytt_t *create_table(unsigned int	bucket_bits,
+			    size_t		data_size,
+			    pytt_allocator_f	alloc,
+			    pytt_deallocator_f	dealloc,
+			    uint32_t		hash_initializer,
+			    uint16_t		flags,
+			    int			numa_node)
+{
+  pytt_t *ht;
+  size_t size = table_size(bucket_bits);
+  int huge;
+
+  if(flags & PYTT_CONCURRENT) {
+    flags &= ~(PYTT_TTL | PYTT_BUCKET_TAGS | PYTT_AUTO_SHRINK | PYTT_HUGE_PAGES);
+    numa_node = -1;
+  }
+  huge = (flags & PYTT_HUGE_PAGES) != 0;
+
+  if(! alloc) {
+    flags |= PYTT_MALLOC_TABLE_HEADER;
+  }
+
+  if(huge || numa_node >= 0) {
+    /* Fresh pages are already zeroed, and leaving them untouched means
+     * only the parts of the bucket array that get used take up memory. */
+    ht = pytt_pages_alloc(paged_size(size, huge), huge, numa_node);
+  } else {
+    if((flags & PYTT_MALLOC_TABLE_HEADER) || !alloc) {
+      ht = malloc(size);
+    } else {
+      ht = alloc(size);
     }
 
-    ht->dealloc(ent);
-    ent = next;
+    memset(ht, 0, size);
   }
 
-  if(ht->flags & PYTT_MALLOC_TABLE_HEADER) {
-    free(ht);
+  if(alloc) {
+    ht->alloc = alloc;
+  } else {
+    ht->alloc = malloc;
+  }
+
+  if(dealloc) {
+    ht->dealloc = dealloc;
   } else {
-    ht->dealloc(ht);
+    ht->dealloc = free;
+  }
+
+  /* Keys go first in PYTT_VARIABLE_DATA entries. */
+  ht->data_size	       = (flags & PYTT_VARIABLE_DATA) ? 0 : data_size;
+  ht->bucket_bits      = bucket_bits;
+  ht->max_bucket_bits  = bucket_bits;
+  ht->count	       = 0;
+  ht->flags	       = flags;
+  ht->hash_initializer = hash_initializer;
+  ht->first	       = NULL;
+
+  if(flags & PYTT_TTL) {
+    ht->wheel = header_alloc(ht, sizeof(struct pytt_wheel_t));
+    memset(ht->wheel, 0, sizeof(struct pytt_wheel_t));
+  }
+
+  if(huge || numa_node >= 0) {
+    ht->arena = calloc(1, sizeof(struct pytt_arena_t));
+    ht->arena->huge = huge;
+    ht->arena->numa_node = numa_node;
+    ht->arena->paged_header = 1;
+  }
+
+  if(flags & PYTT_BUCKET_TAGS) {
+    ht->tags = tags_alloc(ht, bucket_bits);
+    if(! ht->tags) {
+      tags_fail(ht);
+    }
+  }
+
+  return ht;
+}
+
+pytt_t *pytt_create_custom(unsigned int		bucket_bits,
+			   size_t		data_size,
+			   pytt_allocator_f	alloc,
+			   pytt_deallocator_f	dealloc,
+			   uint32_t		hash_initializer,
+			   uint16_t		flags)
+{
+  return create_table(bucket_bits, data_size, alloc, dealloc, hash_initializer, flags, -1);
+}
+
+pytt_t *pytt_create_numa(unsigned int bucket_bits, size_t data_size, uint16_t flags, int numa_node)
+{
+  return create_table(bucket_bits, data_size, malloc, free,
+		      PYTT_DEFAULT_HASH_INITIALIZER, flags, numa_node);
+}
+
+size_t pytt_get_bucket_count(pytt_t *ht)
+{
+  return (size_t) 1<<(ht->bucket_bits);
+}
+
+size_t pytt_get_entry_count(pytt_t *ht)
+{
+  return ht->count;
+}
+
+/* The bucket index is the low bucket_bits of the hash, and the tags come
+ * from the top: the entry tag is bits 32-63 and the PYTT_BUCKET_TAGS tag
+ * bits 48-63. Keys in one bucket share their low bucket_bits, so past
+ * 2^32 buckets the low bucket_bits - 32 bits of their entry tags are the
+ * same and the tag tells apart fewer of them (24 bits' worth at 2^40).
+ * No choice of bits can do better, since only 64 - bucket_bits bits of
+ * the hash differ within a bucket. It only costs the odd extra key
+ * compare. The bucket tags hold until 2^48 buckets, more than an array
+ * of bucket pointers could ever take. */
+static size_t hash_bucket(pytt_t *ht, pytt_hash_t hash)
+{
+  return (size_t) (hash & (((pytt_hash_t) 1<<(ht->bucket_bits))-1));
+}
+
+/* Hash of a key as it is stored in the table. For PYTT_INTERNED_KEYS
+ * tables that is the handle, not the bytes it stands for. */
+static pytt_hash_t key_hash(pytt_t *ht, const void *key, uint16_t keylen)
+{
+  if(ht->intern) {
+    pytt_handle_t handle;
+    uint32_t c = ht->hash_initializer, b = 0;
+    memcpy(&handle, key, sizeof(handle));
+    hashword2(&handle, 1, &c, &b);
+    return pytt_inline_finish(c, b);
+  }
+
+  return pytt_hash(ht, key, keylen);
+}
+
+/* The tag only has to tell apart keys that share a bucket, so it comes
+ * from the bits the bucket index doesn't use. 0 marks a free slot. */
+static uint16_t hash_tag(pytt_hash_t hash)
+{
+  uint16_t tag = (uint16_t) (hash >> 48);
+
+  return tag ? tag : 1;
+}
+
+static int tags_slot(struct pytt_tags_t *t, pytt_entry_t *ent)
+{
+  int i;
+
+  for(i = 0; i != PYTT_TAG_WAYS; ++i) {
+    if(t->ents[i] == ent) {
+      break;
+    }
+  }
+
+  return i;
+}
+
+static void tags_add(pytt_t *ht, size_t bucket, uint16_t tag, pytt_entry_t *ent)
+{
+  struct pytt_tags_t *t = &ht->tags[bucket];
+  int i;
+
+  for(i = 0; i != PYTT_TAG_WAYS; ++i) {
+    if(! t->tags[i]) {
+      t->tags[i] = tag;
+      t->ents[i] = ent;
+      return;
+    }
+  }
+
+  ++t->overflow;
+}
+
+/* Frees ent's slot in the tags of its bucket, if it has one. */
+static void tags_unslot(pytt_t *ht, size_t bucket, pytt_entry_t *ent)
+{
+  struct pytt_tags_t *t = &ht->tags[bucket];
+  int i = tags_slot(t, ent);
+
+  if(i == PYTT_TAG_WAYS) {
+    --t->overflow;
+    return;
+  }
+
+  t->tags[i] = 0;
+  t->ents[i] = NULL;
+}
+
+/* If the chain is longer than the tags, entries that didn't fit before
+ * take the free slots. */
+static void tags_refill(pytt_t *ht, size_t bucket)
+{
+  struct pytt_tags_t *t = &ht->tags[bucket];
+  pytt_entry_t *b;
+  int i;
+
+  for(b = ht->buckets[bucket]; b && t->overflow; b = b->hdr.next) {
+    if(tags_slot(t, b) == PYTT_TAG_WAYS) {
+      /* Free slots have no entry. */
+      i = tags_slot(t, NULL);
+      if(i == PYTT_TAG_WAYS) {
+	return;
+      }
+
+      t->tags[i] = hash_tag(key_hash(ht, entry_key(ht, b), b->hdr.keylen));
+      t->ents[i] = b;
+      --t->overflow;
+    }
+
+    if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      break;
+    }
+  }
+}
+
+/* Called once ent is off the chain. */
+static void tags_remove(pytt_t *ht, size_t bucket, pytt_entry_t *ent)
+{
+  tags_unslot(ht, bucket, ent);
+  tags_refill(ht, bucket);
+}
+
+static uint32_t hash_entry_tag(pytt_hash_t hash)
+{
+  return (uint32_t) (hash >> 32);
+}
+
+static int key_equals(pytt_t *ht, pytt_entry_t *ent, uint32_t tag, const void *key, uint16_t keylen)
+{
+  if(ent->hdr.tag != tag) {
+    return 0;
+  }
+
+  if(ht->intern) {
+    pytt_handle_t a, b;
+    memcpy(&a, entry_key(ht, ent), sizeof(a));
+    memcpy(&b, key, sizeof(b));
+    return a == b;
+  }
+
+#if PYTT_HEADER_KEY_BYTES > 0
+  if(keylen <= PYTT_HEADER_KEY_BYTES) {
+    return ent->hdr.keylen == keylen && !memcmp(ent->hdr.short_key, key, keylen);
+  }
+#endif
+
+  return ent->hdr.keylen == keylen && !memcmp(ent->data + ht->data_size, key, keylen);
+}
+
+/* key_equals for a key in count parts of keylen bytes in all. */
+static int key_equalsv(pytt_t *ht, pytt_entry_t *ent, uint32_t tag,
+		       const pytt_keyvec_t *parts, int count, uint16_t keylen)
+{
+  const char *stored = entry_key(ht, ent);
+  int i;
+
+  if(ent->hdr.tag != tag || ent->hdr.keylen != keylen) {
+    return 0;
+  }
+
+  for(i = 0; i < count; ++i) {
+    if(memcmp(stored, parts[i].base, parts[i].len)) {
+      return 0;
+    }
+    stored += parts[i].len;
+  }
+
+  return 1;
+}
+
+/* Whether ent holds the key bucket_search and bucket_add were given. */
+#define KEY_MATCHES(ent)						\
+  (parts ? key_equalsv(ht, (ent), ent_tag, parts, count, keylen)	\
+         : key_equals(ht, (ent), ent_tag, key, keylen))
+
+/* Finds the entry for a key whose hash is known. The key is either key, or
+ * if parts isn't NULL, count parts of keylen bytes in all. */
+static pytt_entry_t *bucket_search(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen,
+				   const pytt_keyvec_t *parts, int count)
+{
+  size_t bucket = hash_bucket(ht, hash);
+  uint32_t ent_tag = hash_entry_tag(hash);
+  pytt_entry_t *b;
+
+  if(ht->tags) {
+    struct pytt_tags_t *t = &ht->tags[bucket];
+    uint16_t tag = hash_tag(hash);
+    int i;
+
+    for(i = 0; i != PYTT_TAG_WAYS; ++i) {
+      if(t->tags[i] == tag && KEY_MATCHES(t->ents[i])) {
+	b = t->ents[i];
+	goto found;
+      }
+    }
+
+    /* Everything in the bucket is in the tags, so no need to look
+     * at the entries at all. */
+    if(! t->overflow) {
+      return NULL;
+    }
+  }
+
+  if(ht->flags & PYTT_CONCURRENT) {
+    b = atomic_load_entry(&ht->buckets[bucket]);
+  } else {
+    b = ht->buckets[bucket];
+  }
+  while(b) {
+    if(KEY_MATCHES(b)) {
+      goto found;
+    }
+
+    /* If we're at the end of the collision list, we need look no further. */
+    if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      return NULL;
+    }
+
+    b = b->hdr.next;
+  }
+
+  return NULL;
+
+ found:
+  if(entry_expired(ht, b)) {
+    pytt_entry_destroy(ht, b);
+    return NULL;
+  }
+
+  return b;
+}
+
+static pytt_entry_t *bucket_find(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen)
+{
+  return bucket_search(ht, hash, key, keylen, NULL, 0);
+}
+
+static struct pytt_snapshot_saved_t *snapshot_slot(struct pytt_snapshot_t *snap, size_t bucket)
+{
+  size_t mask = snap->saved_capacity - 1;
+  size_t i = (size_t) (((uint64_t) bucket * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+
+  while(snap->saved[i].bucket_plus_one && snap->saved[i].bucket_plus_one != bucket + 1) {
+    i = (i + 1) & mask;
+  }
+
+  return &snap->saved[i];
+}
+
+/* The saved copy of a bucket, or NULL if the snapshot has none. */
+static struct pytt_snapshot_saved_t *snapshot_find(struct pytt_snapshot_t *snap, size_t bucket)
+{
+  struct pytt_snapshot_saved_t *slot;
+
+  if(! snap->saved_count) {
+    return NULL;
+  }
+
+  slot = snapshot_slot(snap, bucket);
+
+  return slot->bucket_plus_one ? slot : NULL;
+}
+
+static void snapshot_save(struct pytt_snapshot_t *snap, size_t bucket, pytt_entry_t *chain)
+{
+  struct pytt_snapshot_saved_t *slot;
+
+  /* Keep the map at most half full. */
+  if(2 * (snap->saved_count + 1) > snap->saved_capacity) {
+    struct pytt_snapshot_saved_t *old = snap->saved;
+    size_t old_capacity = snap->saved_capacity, i;
+
+    snap->saved_capacity = old_capacity ? 2 * old_capacity : 16;
+    snap->saved = calloc(snap->saved_capacity, sizeof(struct pytt_snapshot_saved_t));
+
+    for(i = 0; i != old_capacity; ++i) {
+      if(old[i].bucket_plus_one) {
+	*snapshot_slot(snap, old[i].bucket_plus_one - 1) = old[i];
+      }
+    }
+
+    free(old);
+  }
+
+  slot = snapshot_slot(snap, bucket);
+  slot->bucket_plus_one = bucket + 1;
+  slot->chain = chain;
+  ++snap->saved_count;
+}
+
+/* Copies of the entries in a bucket, chained the same way. */
+static pytt_entry_t *chain_copy(pytt_t *ht, size_t bucket)
+{
+  pytt_entry_t *chain = NULL, **tail = &chain, *b;
+
+  for(b = ht->buckets[bucket]; b; b = b->hdr.next) {
+    size_t size = sizeof(pytt_entry_t) + entry_tail_size(ht, b->hdr.keylen, entry_data_size(ht, b));
+    pytt_entry_t *copy = malloc(size);
+
+    memcpy(copy, b, size);
+    copy->hdr.prev = NULL;
+    copy->hdr.next = NULL;
+    *tail = copy;
+    tail = &copy->hdr.next;
+
+    if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      break;
+    }
+  }
+
+  return chain;
+}
+
+static void chain_free(pytt_entry_t *chain)
+{
+  while(chain) {
+    pytt_entry_t *next = chain->hdr.next;
+    free(chain);
+    chain = next;
+  }
+}
+
+/* Called before anything in a bucket changes. */
+static void snapshot_touch(pytt_t *ht, size_t bucket)
+{
+  if(ht->snapshot && ! snapshot_find(ht->snapshot, bucket)) {
+    snapshot_save(ht->snapshot, bucket, chain_copy(ht, bucket));
+  }
+}
+
+/* Puts an entry first in its bucket, which becomes the first bucket in
+ * the list if it was empty. */
+static void bucket_link(pytt_t *ht, pytt_hash_t hash, pytt_entry_t *ent)
+{
+  size_t bucket = hash_bucket(ht, hash);
+  pytt_entry_t *before = NULL;
+
+  ent->hdr.prev = NULL;
+  ent->hdr.next = NULL;
+  ent->hdr.flags &= ~PYTT_ENTRY_LAST_IN_BUCKET;
+
+  if(ht->buckets[bucket]) {
+    before = ht->buckets[bucket];
+  } else {
+    before = ht->first;
+    ent->hdr.flags |= PYTT_ENTRY_LAST_IN_BUCKET;
+  }
+
+  if(before) {
+    ll_insert_before(before, ent);
+  }
+
+  ht->buckets[bucket] = ent;
+
+  if(! ent->hdr.prev) {
+    ht->first = ent;
+  }
+
+  if(ht->tags) {
+    tags_add(ht, bucket, hash_tag(hash), ent);
+  }
+}
+
+/* Spreads the entries over 2^bucket_bits buckets. Buckets past the ones
+ * in use are garbage, so only the new range needs clearing, and when
+ * shrinking, the pages past it can go back to the system. */
+static void table_rebucket(pytt_t *ht, unsigned int bucket_bits)
+{
+  size_t old_buckets = (size_t) 1 << ht->bucket_bits;
+  size_t new_buckets = (size_t) 1 << bucket_bits;
+  pytt_entry_t *ent = ht->first, *next;
+
+  memset(ht->buckets, 0, new_buckets * sizeof(pytt_entry_t *));
+  if(ht->tags && bucket_bits == ht->bucket_bits) {
+    memset(ht->tags, 0, new_buckets * sizeof(struct pytt_tags_t));
+  } else if(ht->tags) {
+    /* The tags are sized for the buckets in use, so they follow them. */
+    tags_free(ht, ht->tags, ht->bucket_bits);
+    ht->tags = tags_alloc(ht, bucket_bits);
+    if(! ht->tags) {
+      tags_fail(ht);
+    }
+  }
+
+  ht->bucket_bits = bucket_bits;
+  ht->first = NULL;
+
+  /* The hashes stay the same, so hdr.tag does too. */
+  while(ent) {
+    next = ent->hdr.next;
+    bucket_link(ht, key_hash(ht, entry_key(ht, ent), ent->hdr.keylen), ent);
+    ent = next;
+  }
+
+  if(new_buckets < old_buckets) {
+    pytt_pages_release(ht->buckets + new_buckets,
+		       (old_buckets - new_buckets) * sizeof(pytt_entry_t *));
+  }
+}
+
+/* PYTT_AUTO_SHRINK tables shrink below a load of 1/PYTT_SHRINK_LOAD and
+ * grow above 1, both times to a load between 1/4 and 1/2, so that a table
+ * going back and forth around a size doesn't rebucket every time. */
+#define PYTT_SHRINK_LOAD                      8
+#define PYTT_SHRINK_MIN_BITS                  4
+
+static void table_auto_resize(pytt_t *ht)
+{
+  size_t buckets = (size_t) 1 << ht->bucket_bits;
+  unsigned int bucket_bits = PYTT_SHRINK_MIN_BITS;
+
+  if(! (ht->flags & PYTT_AUTO_SHRINK) || ht->snapshot) {
+    return;
+  }
+
+  if(ht->count > buckets
+     ? ht->bucket_bits < ht->max_bucket_bits
+     : ht->count < buckets / PYTT_SHRINK_LOAD && ht->bucket_bits > PYTT_SHRINK_MIN_BITS) {
+    while(bucket_bits < ht->max_bucket_bits && ((size_t) 1 << bucket_bits) < 2 * ht->count) {
+      ++bucket_bits;
+    }
+    if(bucket_bits > ht->max_bucket_bits) {
+      bucket_bits = ht->max_bucket_bits;
+    }
+
+    if(bucket_bits != ht->bucket_bits) {
+      table_rebucket(ht, bucket_bits);
+    }
+  }
+}
+
+/* A new entry for a key, not linked anywhere yet. The key is given like
+ * to bucket_search. data_size only matters for PYTT_VARIABLE_DATA
+ * tables. */
+static pytt_entry_t *entry_new(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen,
+			       const pytt_keyvec_t *parts, int count, size_t data_size)
+{
+  pytt_entry_t *ent = entry_alloc(ht, keylen, data_size);
+  char *stored;
+  int i;
+
+  ent->hdr.keylen = keylen;
+  stored = entry_key(ht, ent);
+  if(parts) {
+    for(i = 0; i < count; ++i) {
+      memcpy(stored, parts[i].base, parts[i].len);
+      stored += parts[i].len;
+    }
+  } else {
+    memcpy(stored, key, keylen);
+  }
+  if(ht->flags & PYTT_VARIABLE_DATA) {
+    uint64_t size = data_size;
+    memcpy(ent->data + var_size_offset(ht, keylen), &size, sizeof(size));
+  }
+  ent->hdr.flags = (ht->flags & PYTT_VARIABLE_DATA) ? PYTT_ENTRY_VARIABLE_DATA : 0;
+  ent->hdr.tag = hash_entry_tag(hash);
+
+  return ent;
+}
+
+/* Adds the entry for a key to a PYTT_CONCURRENT bucket unless another
+ * thread gets there first, in which case that entry is the result. */
+static pytt_entry_t *concurrent_add(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen,
+				    const pytt_keyvec_t *parts, int count, size_t data_size)
+{
+  pytt_entry_t **head = &ht->buckets[hash_bucket(ht, hash)];
+  pytt_entry_t *first = atomic_load_entry(head);
+  pytt_entry_t *seen = NULL, *ent = NULL, *b;
+  uint32_t ent_tag = hash_entry_tag(hash);
+
+  for(;;) {
+    /* Entries never leave the chain, so only the ones pushed since the
+     * last look can hold the key. */
+    for(b = first; b != seen; b = b->hdr.next) {
+      if(KEY_MATCHES(b)) {
+	if(ent) {
+	  entry_free(ht, ent);
+	}
+	return b;
+      }
+    }
+
+    if(! ent) {
+      ent = entry_new(ht, hash, key, keylen, parts, count, data_size);
+      if(ht->flags & PYTT_VARIABLE_DATA) {
+	memset(ent->data + var_data_offset(ht, keylen), 0, data_size);
+      } else {
+	memset(ent->data, 0, ht->data_size);
+      }
+    }
+
+    ent->hdr.next = first;
+    seen = first;
+    if(atomic_cas_entry(head, &first, ent)) {
+      break;
+    }
+  }
+
+  atomic_inc_size(&ht->count);
+
+  if(ht->create_callback) {
+    ht->create_callback(ent);
+  }
+
+  return ent;
+}
+
+/* Adds a new entry for a key that is known not to be in the bucket. The
+ * key is given like to bucket_search. data_size only matters for
+ * PYTT_VARIABLE_DATA tables. */
+static pytt_entry_t *bucket_add(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen,
+				const pytt_keyvec_t *parts, int count, size_t data_size)
+{
+  pytt_entry_t *ent;
+
+  /* Another thread may have added it since, so look again. */
+  if(ht->flags & PYTT_CONCURRENT) {
+    return concurrent_add(ht, hash, key, keylen, parts, count, data_size);
+  }
+
+  snapshot_touch(ht, hash_bucket(ht, hash));
+  ent = entry_new(ht, hash, key, keylen, parts, count, data_size);
+
+  bucket_link(ht, hash, ent);
+  ++ht->count;
+
+  if(ht->create_callback) {
+    ht->create_callback(ent);
+  }
+
+  table_auto_resize(ht);
+
+  return ent;
+}
+
+static pytt_entry_t *bucket_insert(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen,
+				   size_t data_size)
+{
+  return bucket_add(ht, hash, key, keylen, NULL, 0, data_size);
+}
+
+/* The entry for a key, created if it isn't there. The caller may change
+ * its data either way, so snapshots need the bucket as it was. */
+static pytt_entry_t *bucket_create(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen,
+				   size_t data_size)
+{
+  pytt_entry_t *ent;
+
+  /* concurrent_add looks the key up as it goes. */
+  if(ht->flags & PYTT_CONCURRENT) {
+    return bucket_insert(ht, hash, key, keylen, data_size);
+  }
+
+  ent = bucket_find(ht, hash, key, keylen);
+
+  if(! ent) {
+    return bucket_insert(ht, hash, key, keylen, data_size);
+  }
+
+  snapshot_touch(ht, hash_bucket(ht, hash));
+
+  return ent;
+}
+
+void *pytt_entry_get_key_ptr(pytt_t *ht, pytt_entry_t *ent)
+{
+  if(ht->intern) {
+    return (void *) pytt_intern_get(ht->intern, pytt_entry_handle(ht, ent), NULL);
+  }
+
+  return entry_key(ht, ent);
+}
+
+pytt_entry_t *pytt_entry_create(pytt_t *ht, const void *key, uint16_t keylen)
+{
+  if(ht->intern) {
+    return pytt_entry_create_handle(ht, pytt_intern(ht->intern, key, keylen));
+  }
+
+  return bucket_create(ht, key_hash(ht, key, keylen), key, keylen, ht->data_size);
+}
+
+pytt_entry_t *pytt_entry_get(pytt_t *ht, const void *key, uint16_t keylen)
+{
+  if(ht->intern) {
+    pytt_handle_t handle = pytt_intern_find(ht->intern, key, keylen);
+    return handle == PYTT_NO_HANDLE ? NULL : pytt_entry_get_handle(ht, handle);
+  }
+
+  return bucket_find(ht, key_hash(ht, key, keylen), key, keylen);
+}
+
+void pytt_entry_remove(pytt_t *ht, const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_entry_get(ht, key, keylen);
+
+  if(ent) {
+    pytt_entry_destroy(ht, ent);
+  }
+}
+
+void pytt_entry_destroy(pytt_t *ht, pytt_entry_t *ent)
+{
+  size_t bucket = hash_bucket(ht, key_hash(ht, entry_key(ht, ent), ent->hdr.keylen));
+
+  snapshot_touch(ht, bucket);
+
+  if(ht->remove_callback) {
+    ht->remove_callback(ent);
+  }
+
+  if(ht->buckets[bucket] == ent) {
+    // The bucket now starts at the next entry, unless
+    // this was the only one in it.
+    if(ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      ht->buckets[bucket] = NULL;
+    } else {
+      ht->buckets[bucket] = ent->hdr.next;
+    }
+  }
+
+  if (ent->hdr.prev) {
+    ent->hdr.prev->hdr.next = ent->hdr.next;
+
+    if (ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      // If we're removing the last entry in a bucket, we
+      // must set that flag on the previous item. We do not
+      // need to check that the previous item is in the same
+      // bucket because if it it not, it will be the last entry
+      // in that bucket.
+
+      ent->hdr.prev->hdr.flags |= PYTT_ENTRY_LAST_IN_BUCKET;
+    }
+
+  } else {
+    ht->first = ent->hdr.next;
+  }
+
+  if(ent->hdr.next) {
+    ent->hdr.next->hdr.prev = ent->hdr.prev;
+  }
+
+  if(ht->tags) {
+    tags_remove(ht, bucket, ent);
+  }
+
+  if(ht->wheel) {
+    wheel_unlink(ht->wheel, ent);
+  }
+
+  entry_free(ht, ent);
+  --ht->count;
+
+  table_auto_resize(ht);
+}
+
+size_t pytt_remove_if(pytt_t *ht, pytt_pred_f pred, void *arg)
+{
+  pytt_entry_t *ent = ht->first, *next, *tail = NULL, *head;
+  size_t removed = 0, bucket;
+  int touched, last;
+
+  /* The list is the buckets one after another, so take it a bucket at a
+   * time. Kept entries are linked up as they go by, and the bucket head
+   * and last flag are only fixed once the bucket is done. */
+  while(ent) {
+    head = NULL;
+    touched = 0;
+    bucket = 0;
+
+    do {
+      next = ent->hdr.next;
+      last = ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET;
+
+      if(pred(ent, arg)) {
+	if(! touched) {
+	  bucket = hash_bucket(ht, key_hash(ht, entry_key(ht, ent), ent->hdr.keylen));
+	  snapshot_touch(ht, bucket);
+	  touched = 1;
+	}
+
+	if(ht->remove_callback) {
+	  ht->remove_callback(ent);
+	}
+	if(ht->tags) {
+	  tags_unslot(ht, bucket, ent);
+	}
+	if(ht->wheel) {
+	  wheel_unlink(ht->wheel, ent);
+	}
+
+	/* Nothing reads the entry again, next and last are saved. */
+	entry_free(ht, ent);
+	++removed;
+
+      } else {
+	if(! head) {
+	  head = ent;
+	}
+
+	if(tail) {
+	  if(tail->hdr.next != ent) {
+	    tail->hdr.next = ent;
+	  }
+	} else {
+	  ht->first = ent;
+	}
+	if(ent->hdr.prev != tail) {
+	  ent->hdr.prev = tail;
+	}
+	tail = ent;
+      }
+
+      ent = next;
+    } while(! last);
+
+    if(touched) {
+      ht->buckets[bucket] = head;
+      if(head) {
+	tail->hdr.flags |= PYTT_ENTRY_LAST_IN_BUCKET;
+	if(ht->tags && ht->tags[bucket].overflow) {
+	  tags_refill(ht, bucket);
+	}
+      }
+    }
+  }
+
+  if(tail) {
+    tail->hdr.next = NULL;
+  } else {
+    ht->first = NULL;
+  }
+
+  ht->count -= removed;
+  table_auto_resize(ht);
+
+  return removed;
+}
+
+int pytt_resize(pytt_t *ht, unsigned int bucket_bits)
+{
+  if(bucket_bits > ht->max_bucket_bits || ht->snapshot || (ht->flags & PYTT_CONCURRENT)) {
+    return -1;
+  }
+
+  if(bucket_bits != ht->bucket_bits) {
+    table_rebucket(ht, bucket_bits);
+  }
+
+  return 0;
+}
+
+/* Points whatever pointed to a moved entry in the timer wheel at its
+ * copy, keeping its place. */
+static void wheel_move(pytt_entry_t *copy)
+{
+  struct pytt_ttl_t *ttl = ENTRY_TTL(copy);
+
+  if(! ttl->wpprev) {
+    return;
+  }
+
+  *ttl->wpprev = copy;
+  if(ttl->wnext) {
+    ENTRY_TTL(ttl->wnext)->wpprev = &ttl->wnext;
+  }
+}
+
+/* Points everything that pointed to an entry at its copy, which has
+ * the same header. bucket is the entry's bucket. */
+static void entry_relink(pytt_t *ht, size_t bucket, pytt_entry_t *from, pytt_entry_t *to)
+{
+  if(to->hdr.prev) {
+    to->hdr.prev->hdr.next = to;
+  } else {
+    ht->first = to;
+  }
+  if(to->hdr.next) {
+    to->hdr.next->hdr.prev = to;
+  }
+
+  if(ht->buckets[bucket] == from) {
+    ht->buckets[bucket] = to;
+  }
+
+  if(ht->tags) {
+    int i = tags_slot(&ht->tags[bucket], from);
+    if(i != PYTT_TAG_WAYS) {
+      ht->tags[bucket].ents[i] = to;
+    }
+  }
+
+  if(ht->wheel) {
+    wheel_move(to);
+  }
+}
+
+int pytt_compact(pytt_t *ht)
+{
+  struct pytt_arena_t *old_arena = ht->arena;
+  pytt_entry_t *old_first = ht->first, *ent, *next, *copy;
+  size_t prefix = entry_prefix(ht), bucket = 0;
+  int first_in_bucket = 1;
+
+  if(ht->snapshot || (ht->flags & PYTT_CONCURRENT)) {
+    return -1;
+  }
+
+  /* Copies go to a fresh arena, so they are laid out in order and the old
+   * chunks can all go at once. */
+  if(old_arena) {
+    ht->arena = calloc(1, sizeof(struct pytt_arena_t));
+    ht->arena->huge = old_arena->huge;
+    ht->arena->numa_node = old_arena->numa_node;
+    ht->arena->paged_header = old_arena->paged_header;
+  }
+
+  /* All the copies are made before anything is freed, so that none of
+   * them lands in a hole the old entries leave. Relinking only changes
+   * the neighbours' prev and the copies' next, so the old entries still
+   * link up for the second pass. The bucket only needs working out at
+   * the start of each one. */
+  for(ent = old_first; ent; ent = ent->hdr.next) {
+    copy = entry_alloc(ht, ent->hdr.keylen, entry_data_size(ht, ent));
+    memcpy((char *) copy - prefix, (char *) ent - prefix, entry_block_size(ht, ent));
+
+    if(first_in_bucket) {
+      bucket = hash_bucket(ht, key_hash(ht, entry_key(ht, ent), ent->hdr.keylen));
+    }
+    first_in_bucket = (ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) != 0;
+
+    entry_relink(ht, bucket, ent, copy);
+  }
+
+  for(ent = old_first; ent; ent = next) {
+    next = ent->hdr.next;
+
+    if(! old_arena) {
+      entry_free(ht, ent);
+    } else if(arena_is_large(entry_block_size(ht, ent))) {
+      arena_free(old_arena, (char *) ent - prefix, entry_block_size(ht, ent));
+    }
+  }
+
+  if(old_arena) {
+    arena_release(old_arena);
+    free(old_arena);
+  }
+
+  return 0;
+}
+
+pytt_entry_t *pytt_entry_create_sized(pytt_t *ht, const void *key, uint16_t keylen, size_t data_size)
+{
+  pytt_handle_t handle;
+  pytt_entry_t *ent;
+
+  if(! (ht->flags & PYTT_VARIABLE_DATA)) {
+    return pytt_entry_create(ht, key, keylen);
+  }
+
+  if(ht->intern) {
+    handle = pytt_intern(ht->intern, key, keylen);
+    key = &handle;
+    keylen = sizeof(handle);
+  }
+
+  ent = bucket_create(ht, key_hash(ht, key, keylen), key, keylen, data_size);
+
+  return pytt_entry_set_data_size(ht, ent, data_size);
+}
+
+pytt_entry_t *pytt_entry_set_data_size(pytt_t *ht, pytt_entry_t *ent, size_t data_size)
+{
+  size_t old_size = entry_data_size(ht, ent), prefix = entry_prefix(ht), bucket;
+  uint16_t keylen = ent->hdr.keylen;
+  uint64_t size = data_size;
+  pytt_entry_t *copy;
+
+  if(! (ht->flags & PYTT_VARIABLE_DATA) || (ht->flags & PYTT_CONCURRENT) || data_size == old_size) {
+    return ent;
+  }
+
+  bucket = hash_bucket(ht, key_hash(ht, entry_key(ht, ent), keylen));
+  snapshot_touch(ht, bucket);
+
+  copy = entry_alloc(ht, keylen, data_size);
+  memcpy((char *) copy - prefix, (char *) ent - prefix,
+	 entry_size(ht, keylen, data_size < old_size ? data_size : old_size));
+  memcpy(copy->data + var_size_offset(ht, keylen), &size, sizeof(size));
+
+  entry_relink(ht, bucket, ent, copy);
+  entry_free(ht, ent);
+
+  return copy;
+}
+
+void *pytt_entry_data(pytt_t *ht, pytt_entry_t *ent)
+{
+  if(ht->flags & PYTT_VARIABLE_DATA) {
+    return ent->data + var_data_offset(ht, ent->hdr.keylen);
+  }
+
+  return ent->data;
+}
+
+size_t pytt_entry_data_size(pytt_t *ht, pytt_entry_t *ent)
+{
+  return entry_data_size(ht, ent);
+}
+
+pytt_hash_t pytt_hash_seeded(uint32_t hash_initializer, const void *key, uint16_t keylen)
+{
+  uint32_t c = hash_initializer, b = 0;
+
+  hashlittle2(key, keylen, &c, &b);
+
+  return pytt_inline_finish(c, b);
+}
+
+pytt_hash_t pytt_hash(pytt_t *ht, const void *key, uint16_t keylen)
+{
+  return pytt_hash_seeded(ht->hash_initializer, key, keylen);
+}
+
+pytt_entry_t *pytt_entry_create_hashed(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen)
+{
+  if(ht->intern) {
+    return pytt_entry_create(ht, key, keylen);
+  }
+
+  return bucket_create(ht, hash, key, keylen, ht->data_size);
+}
+
+pytt_entry_t *pytt_entry_get_hashed(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen)
+{
+  if(ht->intern) {
+    return pytt_entry_get(ht, key, keylen);
+  }
+
+  return bucket_find(ht, hash, key, keylen);
+}
+
+void pytt_entry_remove_hashed(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_entry_get_hashed(ht, hash, key, keylen);
+
+  if(ent) {
+    pytt_entry_destroy(ht, ent);
+  }
+}
+
+pytt_entry_t *pytt_entry_insert_hashed(pytt_t *ht, pytt_hash_t hash, const void *key, uint16_t keylen)
+{
+  /* An expired entry for the key may still be in the bucket, and interned
+   * keys need translating, so those take the long way. */
+  if(ht->wheel || ht->intern) {
+    return pytt_entry_create_hashed(ht, hash, key, keylen);
+  }
+
+  return bucket_insert(ht, hash, key, keylen, ht->data_size);
+}
+
+/* Interleaved lookups for pytt_entry_get_batch. Each lookup is a small
+ * state machine that prefetches what its next step reads and hands over
+ * to the next lookup, so by the time it comes round again the bucket or
+ * entry is (hopefully) in cache. */
+#define PYTT_BATCH_WAYS                       8
+#define PYTT_BATCH_HASHES                     64
+
+#ifdef __GNUC__
+#define PYTT_PREFETCH(p)  __builtin_prefetch(p)
+#else
+#define PYTT_PREFETCH(p)  ((void) (p))
+#endif
+
+enum { BATCH_IDLE, BATCH_BUCKET, BATCH_CHAIN };
+
+typedef struct batch_lookup_t
+{
+  int            state;
+  size_t         i;
+  pytt_hash_t    hash;
+  pytt_entry_t  *ent;           /* Next entry to compare in BATCH_CHAIN */
+} batch_lookup_t;
+
+/* One step of a lookup. Returns 1 when it is done, with the result in
+ * *result. */
+static int batch_step(pytt_t *ht, batch_lookup_t *l, const void *key, uint16_t keylen,
+		      pytt_entry_t **result)
+{
+  uint32_t ent_tag = hash_entry_tag(l->hash);
+  size_t bucket = hash_bucket(ht, l->hash);
+  pytt_entry_t *b;
+
+  if(l->state == BATCH_BUCKET) {
+    if(ht->tags) {
+      struct pytt_tags_t *t = &ht->tags[bucket];
+      uint16_t tag = hash_tag(l->hash);
+      int i;
+
+      for(i = 0; i != PYTT_TAG_WAYS; ++i) {
+	if(t->tags[i] == tag && key_equals(ht, t->ents[i], ent_tag, key, keylen)) {
+	  *result = t->ents[i];
+	  return 1;
+	}
+      }
+
+      if(! t->overflow) {
+	*result = NULL;
+	return 1;
+      }
+    }
+
+    l->ent = ht->buckets[bucket];
+    l->state = BATCH_CHAIN;
+  } else {
+    b = l->ent;
+    if(key_equals(ht, b, ent_tag, key, keylen)) {
+      *result = b;
+      return 1;
+    }
+
+    l->ent = b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET ? NULL : b->hdr.next;
+  }
+
+  if(! l->ent) {
+    *result = NULL;
+    return 1;
+  }
+
+  PYTT_PREFETCH(l->ent);
+  return 0;
+}
+
+void pytt_entry_get_batch(pytt_t *ht, size_t count, const void *const *keys,
+			  const uint16_t *keylens, pytt_batch_f done, void *arg)
+{
+  batch_lookup_t ways[PYTT_BATCH_WAYS];
+  pytt_hash_t hashes[PYTT_BATCH_HASHES];
+  size_t next = 0, hashed = 0, active = 0, n, bucket;
+  pytt_entry_t *ent;
+  int w;
+
+  /* Expired entries get destroyed on lookup, which other lookups in
+   * flight may be about to read, interned keys need translating first,
+   * and concurrent bucket heads need atomic loads. Those tables look
+   * keys up one at a time. */
+  if(ht->wheel || ht->intern || (ht->flags & PYTT_CONCURRENT)) {
+    for(n = 0; n != count; ++n) {
+      done(n, pytt_entry_get(ht, keys[n], keylens[n]), arg);
+    }
+    return;
+  }
+
+  for(w = 0; w != PYTT_BATCH_WAYS; ++w) {
+    ways[w].state = BATCH_IDLE;
+  }
+
+  while(next != count || active) {
+    for(w = 0; w != PYTT_BATCH_WAYS; ++w) {
+      batch_lookup_t *l = &ways[w];
+
+      if(l->state != BATCH_IDLE) {
+	if(batch_step(ht, l, keys[l->i], keylens[l->i], &ent)) {
+	  l->state = BATCH_IDLE;
+	  --active;
+	  done(l->i, ent, arg);
+	}
+	continue;
+      }
+
+      if(next == count) {
+	continue;
+      }
+
+      if(next == hashed) {
+	n = count - next < PYTT_BATCH_HASHES ? count - next : PYTT_BATCH_HASHES;
+	pytt_hash_batch(ht, n, keys + next, keylens + next, hashes);
+	hashed += n;
+      }
+
+      l->i = next;
+      l->hash = hashes[next % PYTT_BATCH_HASHES];
+      l->state = BATCH_BUCKET;
+      ++next;
+      ++active;
+
+      bucket = hash_bucket(ht, l->hash);
+      if(ht->tags) {
+	PYTT_PREFETCH(&ht->tags[bucket]);
+      } else {
+	PYTT_PREFETCH(&ht->buckets[bucket]);
+      }
+    }
+  }
+}
+
+pytt_snapshot_t *pytt_snapshot(pytt_t *ht)
+{
+  pytt_snapshot_t *snap = calloc(1, sizeof(pytt_snapshot_t));
+
+  snap->ht = ht;
+  snap->older = ht->snapshot;
+  if(snap->older) {
+    snap->older->newer = snap;
+  }
+  ht->snapshot = snap;
+
+  return snap;
+}
+
+void pytt_snapshot_destroy(pytt_snapshot_t *snap)
+{
+  size_t i;
+
+  /* The next older snapshot may be relying on our copies of buckets it
+   * didn't save itself, so it inherits those. */
+  for(i = 0; i != snap->saved_capacity; ++i) {
+    struct pytt_snapshot_saved_t *slot = &snap->saved[i];
+
+    if(! slot->bucket_plus_one) {
+      continue;
+    }
+
+    if(snap->older && ! snapshot_find(snap->older, slot->bucket_plus_one - 1)) {
+      snapshot_save(snap->older, slot->bucket_plus_one - 1, slot->chain);
+    } else {
+      chain_free(slot->chain);
+    }
+  }
+
+  if(snap->newer) {
+    snap->newer->older = snap->older;
+  } else {
+    snap->ht->snapshot = snap->older;
+  }
+  if(snap->older) {
+    snap->older->newer = snap->newer;
+  }
+
+  free(snap->saved);
+  free(snap);
+}
+
+/* A bucket as the snapshot sees it. */
+static pytt_entry_t *snapshot_bucket(pytt_snapshot_t *snap, size_t bucket)
+{
+  struct pytt_snapshot_saved_t *slot;
+  pytt_t *ht = snap->ht;
+
+  for(; snap; snap = snap->newer) {
+    if((slot = snapshot_find(snap, bucket))) {
+      return slot->chain;
+    }
+  }
+
+  /* Unchanged since the snapshot was taken. */
+  return ht->buckets[bucket];
+}
+
+pytt_entry_t *pytt_snapshot_get(pytt_snapshot_t *snap, const void *key, uint16_t keylen)
+{
+  pytt_t *ht = snap->ht;
+  pytt_handle_t handle;
+  pytt_hash_t hash;
+  pytt_entry_t *b;
+  size_t bucket;
+  uint32_t tag;
+
+  if(ht->intern) {
+    handle = pytt_intern_find(ht->intern, key, keylen);
+    if(handle == PYTT_NO_HANDLE) {
+      return NULL;
+    }
+    key = &handle;
+    keylen = sizeof(handle);
+  }
+
+  hash = key_hash(ht, key, keylen);
+  tag = hash_entry_tag(hash);
+  bucket = hash_bucket(ht, hash);
+
+  for(b = snapshot_bucket(snap, bucket); b; b = b->hdr.next) {
+    if(key_equals(ht, b, tag, key, keylen)) {
+      return b;
+    }
+    if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+void pytt_snapshot_foreach(pytt_snapshot_t *snap, pytt_snapshot_f fn, void *arg)
+{
+  size_t bucket, count = (size_t) 1 << snap->ht->bucket_bits;
+  pytt_entry_t *b;
+
+  for(bucket = 0; bucket != count; ++bucket) {
+    for(b = snapshot_bucket(snap, bucket); b; b = b->hdr.next) {
+      fn(b, arg);
+      if(b->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+	break;
+      }
+    }
+  }
+}
+
+pytt_entry_t *pytt_entry_create_z(pytt_t *ht, const char *key)
+{
+	return pytt_entry_create(ht, key, (uint16_t) strlen(key)+1);
+}
+
+pytt_entry_t *pytt_entry_get_z(pytt_t *ht, const char *key)
+{
+	return pytt_entry_get(ht, key, (uint16_t) strlen(key)+1);
+}
+
+void pytt_entry_remove_z(pytt_t *ht, const char *key)
+{
+	pytt_entry_remove(ht, key, (uint16_t) strlen(key)+1);
+}
+
+
+void pytt_destroy(pytt_t *ht)
+{
+  pytt_entry_t *ent;
+  struct pytt_arena_t *arena = ht->arena;
+
+  if(ht->flags & PYTT_CONCURRENT) {
+    pytt_concurrent_end(ht);
+  }
+  ent = ht->first;
+	
+  while(ht->snapshot) {
+    pytt_snapshot_destroy(ht->snapshot);
+  }
+
+  while(ent) {
+    pytt_entry_t *next = ent->hdr.next;
+    if(ht->remove_callback) {
+      ht->remove_callback(ent);
+    }
+
+    /* Arena chunks go all at once below; only the big blocks
+     * that have pages of their own need freeing one by one. */
+    if(! arena || arena_is_large(entry_block_size(ht, ent))) {
+      entry_free(ht, ent);
+    }
+    ent = next;
+  }
+
+  if(ht->wheel) {
+    header_free(ht, ht->wheel);
+  }
+
+  if(ht->tags) {
+    tags_free(ht, ht->tags, ht->bucket_bits);
+  }
+
+  if(arena) {
+    arena_release(arena);
+    if(arena->paged_header) {
+      pytt_pages_free(ht, paged_size(table_size(ht->max_bucket_bits), arena->huge));
+    } else {
+      header_free(ht, ht);
+    }
+    free(arena);
+  } else {
+    header_free(ht, ht);
+  }
+}
+
+pytt_entry_t *pytt_entry_create_ttl(pytt_t *ht, const void *key, uint16_t keylen, uint64_t ttl)
+{
+  pytt_entry_t *ent = pytt_entry_create(ht, key, keylen);
+
+  pytt_entry_set_ttl(ht, ent, ttl);
+
+  return ent;
+}
+
+void pytt_entry_set_ttl(pytt_t *ht, pytt_entry_t *ent, uint64_t ttl)
+{
+  struct pytt_wheel_t *w = ht->wheel;
+  struct pytt_ttl_t *t;
+
+  if(! w) {
+    return;
+  }
+
+  t = ENTRY_TTL(ent);
+  wheel_unlink(w, ent);
+
+  if(ttl) {
+    t->expires = w->now + ttl;
+    wheel_link(w, ent);
+  } else {
+    t->expires = 0;
+  }
+}
+
+uint64_t pytt_entry_get_expiry(pytt_t *ht, pytt_entry_t *ent)
+{
+  if(! ht->wheel) {
+    return 0;
+  }
+
+  return ENTRY_TTL(ent)->expires;
+}
+
+void pytt_set_time(pytt_t *ht, uint64_t now)
+{
+  if(ht->wheel && now > ht->wheel->now) {
+    ht->wheel->now = now;
+  }
+}
+
+/* Wheel steps, each draining or cascading a slot, that one call to
+ * pytt_expire may take however far the clock moved. */
+#define PYTT_EXPIRE_STEPS                     1024
+
+size_t pytt_expire(pytt_t *ht, uint64_t now, size_t budget)
+{
+  struct pytt_wheel_t *w = ht->wheel;
+  size_t reaped = 0;
+  uint64_t next;
+  int level, steps = 0;
+
+  if(! w) {
+    return 0;
+  }
+
+  pytt_set_time(ht, now);
+
+  for(;;) {
+    /* Everything in the current level 0 slot is due. This is also where a
+     * previous call that ran out of budget left off. */
+    pytt_entry_t **slot = &w->slots[0][w->tick & PYTT_WHEEL_MASK];
+
+    while(*slot) {
+      if(budget && reaped == budget) {
+	return reaped;
+      }
+
+      pytt_entry_destroy(ht, *slot);
+      ++reaped;
+    }
+
+    if(w->tick >= w->now) {
+      break;
+    }
+
+    if(! w->count) {
+      /* Nothing left to wait for, so there's no point in ticking along. */
+      w->tick = w->now;
+      break;
+    }
+
+    if(++steps > PYTT_EXPIRE_STEPS) {
+      break;
+    }
+
+    /* Slots in between are empty, so go straight to the next one that
+     * isn't, or to now if that comes first. */
+    next = wheel_next(w);
+    if(next > w->now) {
+      w->tick = w->now;
+      break;
+    }
+    w->tick = next;
+
+    /* Pull down the entries of every level that just wrapped around,
+     * highest first so they can trickle all the way down. */
+    for(level = PYTT_WHEEL_LEVELS - 1; level > 0; --level) {
+      if(! (w->tick & (((uint64_t) 1 << (level * PYTT_WHEEL_BITS)) - 1))) {
+	wheel_cascade(w, level);
+      }
+    }
+  }
+
+  return reaped;
+}
+
+/*
+   Key interning. A pool is an ordinary table keyed on the string bytes,
+   whose entries hold their own handle, plus an array that maps handles
+   back to entries. Entries never move and are never removed, so handles
+   and the key pointers handed out stay valid for the life of the pool.
+*/
+
+struct pytt_intern_t
+{
+  pytt_t        *strings;
+  pytt_entry_t **entries;
+  uint32_t       count;
+  uint32_t       capacity;
+};
+
+pytt_intern_t *pytt_intern_create(unsigned int bucket_bits)
+{
+  pytt_intern_t *pool = malloc(sizeof(pytt_intern_t));
+
+  pool->strings  = pytt_create(bucket_bits, sizeof(pytt_handle_t));
+  pool->entries  = NULL;
+  pool->count    = 0;
+  pool->capacity = 0;
+
+  return pool;
+}
+
+void pytt_intern_destroy(pytt_intern_t *pool)
+{
+  pytt_destroy(pool->strings);
+  free(pool->entries);
+  free(pool);
+}
+
+/* The handle for a key given like to bucket_search, added to the pool
+ * if add is set, else PYTT_NO_HANDLE if it isn't there. */
+static pytt_handle_t intern_lookup(pytt_intern_t *pool, const void *key, uint16_t keylen,
+				   const pytt_keyvec_t *parts, int count, int add)
+{
+  pytt_t *ht = pool->strings;
+  pytt_hash_t hash = parts ? pytt_hashv(ht, parts, count) : key_hash(ht, key, keylen);
+  pytt_entry_t *ent = bucket_search(ht, hash, key, keylen, parts, count);
+  pytt_handle_t handle;
+
+  if(ent) {
+    memcpy(&handle, ent->data, sizeof(handle));
+    return handle;
+  }
+
+  if(! add) {
+    return PYTT_NO_HANDLE;
+  }
+
+  if(pool->count == pool->capacity) {
+    pool->capacity = pool->capacity ? pool->capacity * 2 : 256;
+    pool->entries = realloc(pool->entries, pool->capacity * sizeof(pytt_entry_t *));
+  }
+
+  handle = pool->count++;
+  ent = bucket_add(ht, hash, key, keylen, parts, count, ht->data_size);
+  memcpy(ent->data, &handle, sizeof(handle));
+  pool->entries[handle] = ent;
+
+  return handle;
+}
+
+pytt_handle_t pytt_intern(pytt_intern_t *pool, const void *key, uint16_t keylen)
+{
+  return intern_lookup(pool, key, keylen, NULL, 0, 1);
+}
+
+pytt_handle_t pytt_intern_find(pytt_intern_t *pool, const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_entry_get(pool->strings, key, keylen);
+  pytt_handle_t handle;
+
+  if(! ent) {
+    return PYTT_NO_HANDLE;
+  }
+
+  memcpy(&handle, ent->data, sizeof(handle));
+  return handle;
+}
+
+const void *pytt_intern_get(pytt_intern_t *pool, pytt_handle_t handle, uint16_t *keylen)
+{
+  pytt_entry_t *ent;
+
+  if(handle >= pool->count) {
+    return NULL;
+  }
+
+  ent = pool->entries[handle];
+  if(keylen) {
+    *keylen = ent->hdr.keylen;
+  }
+
+  return ent->data + sizeof(pytt_handle_t);
+}
+
+uint32_t pytt_intern_count(pytt_intern_t *pool)
+{
+  return pool->count;
+}
+
+pytt_t *pytt_create_interned(unsigned int bucket_bits, size_t data_size, pytt_intern_t *pool)
+{
+  pytt_t *ht = pytt_create(bucket_bits, data_size);
+
+  ht->flags |= PYTT_INTERNED_KEYS;
+  ht->intern = pool;
+
+  return ht;
+}
+
+pytt_entry_t *pytt_entry_create_handle(pytt_t *ht, pytt_handle_t handle)
+{
+  return bucket_create(ht, key_hash(ht, &handle, sizeof(handle)), &handle, sizeof(handle),
+		       ht->data_size);
+}
+
+pytt_entry_t *pytt_entry_get_handle(pytt_t *ht, pytt_handle_t handle)
+{
+  return bucket_find(ht, key_hash(ht, &handle, sizeof(handle)), &handle, sizeof(handle));
+}
+
+void pytt_entry_remove_handle(pytt_t *ht, pytt_handle_t handle)
+{
+  pytt_entry_t *ent = pytt_entry_get_handle(ht, handle);
+
+  if(ent) {
+    pytt_entry_destroy(ht, ent);
+  }
+}
+
+pytt_handle_t pytt_entry_handle(pytt_t *ht, pytt_entry_t *ent)
+{
+  pytt_handle_t handle;
+
+  memcpy(&handle, entry_key(ht, ent), sizeof(handle));
+  return handle;
+}
+
+/* Concurrent inserts. */
+
+int pytt_concurrent_begin(pytt_t *ht)
+{
+  pytt_entry_t *ent, *next;
+
+  if(ht->wheel || ht->tags || ht->intern || ht->arena || ht->snapshot
+     || (ht->flags & PYTT_AUTO_SHRINK)) {
+    return -1;
+  }
+
+  /* Cut the list into one NULL-terminated chain per bucket. */
+  for(ent = ht->first; ent; ent = next) {
+    next = ent->hdr.next;
+    if(ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {
+      ent->hdr.next = NULL;
+    }
+  }
+
+  ht->first = NULL;
+  ht->flags |= PYTT_CONCURRENT;
+
+  return 0;
+}
+
+void pytt_concurrent_end(pytt_t *ht)
+{
+  size_t buckets = (size_t) 1 << ht->bucket_bits, bucket;
+  pytt_entry_t *ent, *tail = NULL;
+
+  if(! (ht->flags & PYTT_CONCURRENT)) {
+    return;
+  }
+
+  /* The chains are already linked forward; give them back links and
+   * join them end to end. */
+  for(bucket = 0; bucket != buckets; ++bucket) {
+    for(ent = ht->buckets[bucket]; ent; ent = ent->hdr.next) {
+      ent->hdr.flags &= ~PYTT_ENTRY_LAST_IN_BUCKET;
+      ent->hdr.prev = tail;
+      if(tail) {
+	tail->hdr.next = ent;
+      } else {
+	ht->first = ent;
+      }
+      tail = ent;
+    }
+
+    if(tail) {
+      tail->hdr.flags |= PYTT_ENTRY_LAST_IN_BUCKET;
+    }
+  }
+
+  ht->flags &= ~PYTT_CONCURRENT;
+}
+
+
+/* Keys in several parts. */
+
+static size_t keyvec_length(const pytt_keyvec_t *parts, int count)
+{
+  size_t length = 0;
+  int i;
+
+  for(i = 0; i < count; ++i) {
+    length += parts[i].len;
+  }
+
+  return length;
+}
+
+pytt_hash_t pytt_hashv(pytt_t *ht, const pytt_keyvec_t *parts, int count)
+{
+  return pytt_hash_seededv(ht->hash_initializer, parts, count);
+}
+
+pytt_entry_t *pytt_entry_createv(pytt_t *ht, const pytt_keyvec_t *parts, int count)
+{
+  size_t keylen = keyvec_length(parts, count);
+  pytt_entry_t *ent;
+  pytt_hash_t hash;
+
+  if(keylen > 0xffff) {
+    return NULL;
+  }
+
+  if(ht->intern) {
+    return pytt_entry_create_handle(ht, intern_lookup(ht->intern, NULL, (uint16_t) keylen,
+						      parts, count, 1));
+  }
+
+  hash = pytt_hashv(ht, parts, count);
+  ent = bucket_search(ht, hash, NULL, (uint16_t) keylen, parts, count);
+  if(! ent) {
+    return bucket_add(ht, hash, NULL, (uint16_t) keylen, parts, count, ht->data_size);
+  }
+
+  snapshot_touch(ht, hash_bucket(ht, hash));
+
+  return ent;
+}
+
+pytt_entry_t *pytt_entry_getv(pytt_t *ht, const pytt_keyvec_t *parts, int count)
+{
+  size_t keylen = keyvec_length(parts, count);
+  pytt_handle_t handle;
+
+  if(keylen > 0xffff) {
+    return NULL;
+  }
+
+  if(ht->intern) {
+    handle = intern_lookup(ht->intern, NULL, (uint16_t) keylen, parts, count, 0);
+    return handle == PYTT_NO_HANDLE ? NULL : pytt_entry_get_handle(ht, handle);
+  }
+
+  return bucket_search(ht, pytt_hashv(ht, parts, count), NULL, (uint16_t) keylen, parts, count);
+}
+
+void pytt_entry_removev(pytt_t *ht, const pytt_keyvec_t *parts, int count)
+{
+  pytt_entry_t *ent = pytt_entry_getv(ht, parts, count);
+
+  if(ent) {
+    pytt_entry_destroy(ht, ent);
   }
 }
@@ -61,6 +61,8 @@
 #ifndef PYTT_H
 #define PYTT_H
 
+#include <stddef.h>
+
 #ifndef PYTT_NO_STDINT
 #include <stdint.h>
 #else
@@ -68,11 +70,30 @@
 typedef unsigned int   uint32_t;
 typedef unsigned short uint16_t;
 typedef unsigned char  uint8_t;
+typedef unsigned long long uint64_t;
 #endif
 
 #define PYTT_ENTRY_LAST_IN_BUCKET   1
+/* The entry is laid out for PYTT_VARIABLE_DATA: key first, then data. */
+#define PYTT_ENTRY_VARIABLE_DATA    2
+
+/* Keys of up to PYTT_HEADER_KEY_BYTES bytes are kept in the entry header
+   instead of after the data, so that comparing them only reads the header
+   and the entry is no bigger for it. pytt_entry_get_key_ptr knows where
+   to look. Interned tables still keep the handle after the data. 0 keeps
+   the header at its smallest.
+   The library and everything using it must be built with the same value,
+   which the create functions check, see pytt_header_key_bytes_match. */
+#ifndef PYTT_HEADER_KEY_BYTES
+#define PYTT_HEADER_KEY_BYTES       0
+#endif
 
 struct pytt_entry_t;
+struct pytt_wheel_t;
+struct pytt_tags_t;
+struct pytt_intern_t;
+struct pytt_arena_t;
+struct pytt_snapshot_t;
 
 /*
    Each entry is a linked list node, so that collisions can be handled.
@@ -87,6 +108,12 @@ struct pytt_entry_hdr_t
 
   uint16_t              keylen;
   uint16_t              flags;
+  /** 32 bits of the key's hash, so that chain walks can skip entries
+   *  without reading their keys. Fills what would be padding. */
+  uint32_t              tag;
+#if PYTT_HEADER_KEY_BYTES > 0
+  char                  short_key[PYTT_HEADER_KEY_BYTES];
+#endif
 };
 
 #define PYTT_HDR        struct pytt_entry_hdr_t  hdr
@@ -99,6 +126,46 @@ typedef struct pytt_entry_t
 
 #define PYTT_MALLOC_TABLE_HEADER    1  /**< Use malloc to allocate table and bucket pointers
 					*   even if alloc / dealloc is set. */
+#define PYTT_TTL                    2  /**< Entries carry an expiry time and are tracked by a
+					*   timer wheel. See pytt_entry_create_ttl and pytt_expire. */
+#define PYTT_INTERNED_KEYS          4  /**< Entries store a pytt_handle_t from a shared
+					*   pytt_intern_t instead of the key bytes. Set by
+					*   pytt_create_interned. */
+#define PYTT_HUGE_PAGES             8  /**< Map the bucket array and entry storage with huge
+					*   pages where the system allows it. Entries are then
+					*   carved out of page-sized chunks instead of coming
+					*   from alloc / dealloc. */
+#define PYTT_BUCKET_TAGS           16  /**< Keep a cache line of hash tags and entry pointers
+					*   per bucket, so lookups touch only the entry they
+					*   return, and misses no entry at all. Worth it when
+					*   entries are large or chains long. The tags come
+					*   from alloc and are sized for the buckets in use;
+					*   without memory for them the flag is dropped. */
+#define PYTT_AUTO_SHRINK           32  /**< Use fewer buckets when the table is mostly empty
+					*   and more again, up to bucket_bits, as it fills
+					*   up. See pytt_resize. */
+#define PYTT_VARIABLE_DATA         64  /**< Every entry has its own data size, set with
+					*   pytt_entry_create_sized, instead of data_size.
+					*   The key comes first and the data after it, so
+					*   use pytt_entry_data rather than ent->data. */
+#define PYTT_CONCURRENT           128  /**< Start out concurrent, as after
+					*   pytt_concurrent_begin. Drops PYTT_TTL,
+					*   PYTT_BUCKET_TAGS, PYTT_AUTO_SHRINK and
+					*   PYTT_HUGE_PAGES, and NUMA binding, none of which
+					*   can take entries from several threads. */
+
+/** Seed used by pytt_create. Pass it to pytt_create_custom to make a
+ *  table that can share precomputed hashes with those tables. */
+#define PYTT_DEFAULT_HASH_INITIALIZER 0x20071023
+
+/** A key hash as computed by pytt_hash. 64 bits wide so that tables
+ *  with more than 2^32 buckets still get every bucket used. */
+typedef uint64_t pytt_hash_t;
+
+/** Small, stable stand-in for an interned key. */
+typedef uint32_t pytt_handle_t;
+
+#define PYTT_NO_HANDLE              ((pytt_handle_t) -1)
 				        
 typedef void *(*pytt_allocator_f)(size_t bytes);
 typedef void (*pytt_deallocator_f)(void *pointer);
@@ -112,6 +179,11 @@ typedef struct prefix##_t							\
   uint32_t       hash_initializer;						\
   size_t         data_size;							\
 										\
+  /** Number of entries in the table. */					\
+  size_t         count;								\
+  /** bucket_bits as created, which is how far pytt_resize can grow. */		\
+  uint16_t       max_bucket_bits;						\
+										\
   /** These get called to initialize and free data in entries. */		\
   void         (*create_callback)(entry_type *ent);				\
   void         (*remove_callback)(entry_type *ent);				\
@@ -122,6 +194,17 @@ typedef struct prefix##_t							\
   pytt_allocator_f alloc;							\
   pytt_deallocator_f dealloc;							\
 										\
+  /** Timer wheel for PYTT_TTL tables, NULL otherwise. */			\
+  struct pytt_wheel_t *wheel;							\
+  /** Key pool for PYTT_INTERNED_KEYS tables, NULL otherwise. */		\
+  struct pytt_intern_t *intern;							\
+  /** Entry storage for PYTT_HUGE_PAGES and NUMA bound tables, else NULL. */	\
+  struct pytt_arena_t *arena;							\
+  /** Per-bucket tags for PYTT_BUCKET_TAGS tables, NULL otherwise. */		\
+  struct pytt_tags_t *tags;							\
+  /** The newest snapshot still alive, NULL if there is none. */		\
+  struct pytt_snapshot_t *snapshot;						\
+										\
   /** The first entry in the linked list. */					\
   entry_type  *first;								\
   /** Storage of the buckets that make up the hash table. */			\
@@ -142,11 +225,88 @@ extern pytt_t       *pytt_create_custom(unsigned int	   bucket_bits,
 					uint32_t	   hash_initializer,
 					uint16_t	   flags);
 
+/** Create a new hash table whose bucket array and entries live on one NUMA
+ *  node. flags may include PYTT_HUGE_PAGES. A negative numa_node doesn't
+ *  bind anything. */
+extern pytt_t       *pytt_create_numa(unsigned int bucket_bits,
+				      size_t	   data_size,
+				      uint16_t	   flags,
+				      int	   numa_node);
+
+/** Returns 1 if the library was built with PYTT_HEADER_KEY_BYTES set to
+ *  header_key_bytes, otherwise 0. The value changes the size of the entry
+ *  header, so code built with another one would misplace every field
+ *  after PYTT_HDR. The create functions check it against the caller's
+ *  value and return NULL on a mismatch. */
+extern int           pytt_header_key_bytes_match(unsigned int header_key_bytes);
+
+#ifndef PYTT_BUILDING_LIBRARY
+#define PYTT_CHECKED_CREATE(create)						\
+  (pytt_header_key_bytes_match(PYTT_HEADER_KEY_BYTES) ? (create) : NULL)
+#define pytt_create(bucket_bits, data_size)					\
+  PYTT_CHECKED_CREATE(pytt_create(bucket_bits, data_size))
+#define pytt_create_custom(bucket_bits, data_size, alloc, dealloc, hash_initializer, flags) \
+  PYTT_CHECKED_CREATE(pytt_create_custom(bucket_bits, data_size, alloc, dealloc,	\
+					 hash_initializer, flags))
+#define pytt_create_numa(bucket_bits, data_size, flags, numa_node)		\
+  PYTT_CHECKED_CREATE(pytt_create_numa(bucket_bits, data_size, flags, numa_node))
+#endif
+
 /** Destroy a previously created hash table. */
 extern void          pytt_destroy(pytt_t *ht);
 
 /** Get the total number of buckets in a hash table. */
-extern uint32_t      pytt_get_bucket_count(pytt_t *ht);
+extern size_t        pytt_get_bucket_count(pytt_t *ht);
+/** Get the number of entries in a hash table. */
+extern size_t        pytt_get_entry_count(pytt_t *ht);
+
+/** Spread the entries over 2^bucket_bits buckets, no more than the table
+ *  was created with. Shrinking gives the pages of the unused buckets back
+ *  to the system. Entries stay where they are, but the order pytt_first
+ *  and pytt_entry_next walk them in changes. Returns -1 without doing
+ *  anything if bucket_bits is too large or a snapshot is alive.
+ *
+ *  PYTT_AUTO_SHRINK tables do this by themselves, halving the buckets to
+ *  a load of about 1/2 when it drops below 1/8 and growing back when it
+ *  goes over 1, so there the order can change on any create or destroy. */
+extern int           pytt_resize(pytt_t *ht, unsigned int bucket_bits);
+
+/** Move every entry to new memory, one after the other in the order
+ *  pytt_first and pytt_entry_next walk them, and free the old blocks, so
+ *  that scans read memory sequentially. Tables with an arena
+ *  (PYTT_HUGE_PAGES or NUMA bound) get a fresh one and give all of the
+ *  old one back to the system; other tables take what alloc hands out.
+ *  Pointers to entries are stale afterwards, and the callbacks aren't
+ *  called. Returns -1 without doing anything if a snapshot is alive. */
+extern int           pytt_compact(pytt_t *ht);
+
+/**
+   Concurrent inserts. Between pytt_concurrent_begin and
+   pytt_concurrent_end, any number of threads may create and look up
+   entries at the same time, without locks: pytt_entry_create,
+   pytt_entry_get and their _hashed, _sized, _z and v variants, and
+   pytt_entry_get_batch. New entries are pushed onto their bucket with a
+   compare-and-swap, so two threads creating the same key both get the
+   one entry that made it in.
+
+   Entries are only chained within their buckets meanwhile, so nothing
+   may iterate, remove, resize, compact, snapshot or freeze the table,
+   and sizes in PYTT_VARIABLE_DATA tables stay as created. New entries
+   start with their data zeroed, which is visible to other threads as
+   soon as the entry is; updating it is up to the caller, with atomics
+   if several threads do. The create callback runs on the creating
+   thread, maybe after others have found the entry.
+*/
+
+/** Let several threads create entries at once. Returns -1 without doing
+ *  anything for tables with PYTT_TTL, PYTT_BUCKET_TAGS, PYTT_AUTO_SHRINK,
+ *  interned keys, an arena or a live snapshot. */
+extern int           pytt_concurrent_begin(pytt_t *ht);
+/** Link the entries up again for iteration, in bucket order, making the
+ *  table an ordinary one. Must not race with anything, so call it once
+ *  every thread using the table is done (joined). pytt_destroy calls it
+ *  if need be. */
+extern void          pytt_concurrent_end(pytt_t *ht);
 
 /** Create an entry for the key, or return the one that already exists. */
 extern pytt_entry_t *pytt_entry_create(pytt_t *ht, const void *key, uint16_t keylen);
@@ -161,9 +321,262 @@ extern void          pytt_entry_destroy(pytt_t *ht, pytt_entry_t *ent);
 /** Return the next entry in order */
 extern pytt_entry_t *pytt_entry_next(pytt_entry_t *ent);
 
+/** Create an entry for the key with data_size bytes of data, or return
+ *  the one that already exists, moved if it has to change size. Data up
+ *  to the smaller of the two sizes is kept. For PYTT_VARIABLE_DATA tables;
+ *  others ignore data_size. */
+extern pytt_entry_t *pytt_entry_create_sized(pytt_t *ht, const void *key, uint16_t keylen,
+					     size_t data_size);
+/** Change the size of an entry's data in a PYTT_VARIABLE_DATA table, keeping
+ *  what fits. Returns the entry, which has moved unless the size was the
+ *  same. */
+extern pytt_entry_t *pytt_entry_set_data_size(pytt_t *ht, pytt_entry_t *ent, size_t data_size);
+/** Get a pointer to the data of an entry. That's ent->data, except in
+ *  PYTT_VARIABLE_DATA tables. */
+extern void         *pytt_entry_data(pytt_t *ht, pytt_entry_t *ent);
+/** Get the size of the data of an entry. */
+extern size_t        pytt_entry_data_size(pytt_t *ht, pytt_entry_t *ent);
+
 /** Get a pointer to the key for an entry. */
 extern void         *pytt_entry_get_key_ptr(pytt_t *ht, pytt_entry_t *ent);
 
+/*
+   Precomputed hashes. pytt_hash depends only on the key and the table's
+   hash_initializer, so a hash computed once can be used with every table
+   created with the same initializer (all tables made by pytt_create
+   share PYTT_DEFAULT_HASH_INITIALIZER). Passing a hash that was not made
+   by pytt_hash for that key and seed makes lookups miss.
+
+   PYTT_INTERNED_KEYS tables ignore the hash; use the handle functions
+   to avoid rehashing there.
+*/
+
+/** Hash a key the way ht does. */
+extern pytt_hash_t   pytt_hash(pytt_t *ht, const void *key, uint16_t keylen);
+/** Hash a key the way any table created with hash_initializer does. */
+extern pytt_hash_t   pytt_hash_seeded(uint32_t hash_initializer, const void *key, uint16_t keylen);
+/** One part of a key given in several, like struct iovec. The key is the
+ *  parts one after the other, and is stored that way. */
+typedef struct pytt_keyvec_t
+{
+  const void    *base;
+  size_t         len;
+} pytt_keyvec_t;
+
+/** pytt_hash_seeded of the key made of count parts, without putting it
+ *  together first. */
+extern pytt_hash_t   pytt_hash_seededv(uint32_t hash_initializer, const pytt_keyvec_t *parts,
+				       int count);
+/** pytt_hash of the key made of count parts. */
+extern pytt_hash_t   pytt_hashv(pytt_t *ht, const pytt_keyvec_t *parts, int count);
+/** pytt_entry_create, pytt_entry_get and pytt_entry_remove for the key made
+ *  of count parts. The parts are hashed and compared where they are, with
+ *  no copy, except into a new entry. Keys longer than 65535 bytes in all
+ *  are never there and can't be created. */
+extern pytt_entry_t *pytt_entry_createv(pytt_t *ht, const pytt_keyvec_t *parts, int count);
+extern pytt_entry_t *pytt_entry_getv(pytt_t *ht, const pytt_keyvec_t *parts, int count);
+extern void          pytt_entry_removev(pytt_t *ht, const pytt_keyvec_t *parts, int count);
+
+/** pytt_hash for count keys at once, several per instruction where the
+ *  CPU allows. Gives the same hashes as calling pytt_hash for each. */
+extern void          pytt_hash_batch(pytt_t *ht, size_t count, const void *const *keys,
+				     const uint16_t *keylens, pytt_hash_t *hashes);
+/** pytt_hash_seeded for count keys at once. */
+extern void          pytt_hash_seeded_batch(uint32_t hash_initializer, size_t count,
+					    const void *const *keys, const uint16_t *keylens,
+					    pytt_hash_t *hashes);
+/** Same as pytt_entry_create, with the hash computed by pytt_hash. */
+extern pytt_entry_t *pytt_entry_create_hashed(pytt_t *ht, pytt_hash_t hash,
+					      const void *key, uint16_t keylen);
+/** Same as pytt_entry_get, with the hash computed by pytt_hash. */
+extern pytt_entry_t *pytt_entry_get_hashed(pytt_t *ht, pytt_hash_t hash,
+					   const void *key, uint16_t keylen);
+/** Same as pytt_entry_remove, with the hash computed by pytt_hash. */
+extern void          pytt_entry_remove_hashed(pytt_t *ht, pytt_hash_t hash,
+					      const void *key, uint16_t keylen);
+/** Add an entry for a key the caller has just looked up and not found,
+ *  skipping the lookup pytt_entry_create_hashed would do. */
+extern pytt_entry_t *pytt_entry_insert_hashed(pytt_t *ht, pytt_hash_t hash,
+					      const void *key, uint16_t keylen);
+
+/** Called by pytt_remove_if for every entry. Returns non-zero to have the
+ *  entry destroyed. */
+typedef int (*pytt_pred_f)(pytt_entry_t *ent, void *arg);
+
+/** Destroy every entry pred returns non-zero for, in one pass over the
+ *  table, and return how many were destroyed. Works like calling
+ *  pytt_entry_destroy on each, remove callback included, but fixes up
+ *  each bucket once instead of once per entry. pred must not change the
+ *  table. */
+extern size_t        pytt_remove_if(pytt_t *ht, pytt_pred_f pred, void *arg);
+
+/** Called by pytt_entry_get_batch with the index of a key and its entry,
+ *  or NULL if it isn't in the table. */
+typedef void (*pytt_batch_f)(size_t i, pytt_entry_t *ent, void *arg);
+
+/** Look up count keys, calling done for each as its lookup finishes, in
+ *  no particular order. Several lookups are in flight at once and the
+ *  table moves on to another one whenever the next step would wait for
+ *  memory, so chain walks that miss the cache overlap instead of
+ *  queueing. done must not change the table. */
+extern void          pytt_entry_get_batch(pytt_t *ht, size_t count, const void *const *keys,
+					  const uint16_t *keylens, pytt_batch_f done, void *arg);
+
+/*
+   Copy-on-write snapshots. pytt_snapshot takes a read-only view of the
+   table as it is, in O(1): nothing is copied up front. Afterwards, the
+   first change to a bucket (creating an entry in it, destroying one, or
+   getting an existing entry from pytt_entry_create) first copies that
+   bucket's entries for the snapshot, so it keeps seeing them as they
+   were. Buckets that don't change are read straight from the table.
+
+   Entries from pytt_entry_get are shared with any snapshot, so their
+   data must not be changed while one is alive. Use pytt_entry_create to
+   get an entry to change. Snapshots see PYTT_TTL entries until they are
+   removed, whether or not they have expired. The table isn't thread safe,
+   and snapshots aren't either: a reader on another thread needs the same
+   lock as the writers, but only for as long as each lookup takes.
+*/
+
+typedef struct pytt_snapshot_t pytt_snapshot_t;
+
+/** Called by pytt_snapshot_foreach for every entry in a snapshot. */
+typedef void (*pytt_snapshot_f)(pytt_entry_t *ent, void *arg);
+
+/** Take a snapshot of the table. */
+extern pytt_snapshot_t    *pytt_snapshot(pytt_t *ht);
+/** Free a snapshot. pytt_destroy frees any that are left. */
+extern void                pytt_snapshot_destroy(pytt_snapshot_t *snap);
+/** Get the entry for a key as it was when the snapshot was taken, or NULL.
+ *  The entry is read-only. pytt_entry_get_key_ptr works on it as on any
+ *  entry of the table. */
+extern pytt_entry_t       *pytt_snapshot_get(pytt_snapshot_t *snap, const void *key,
+					     uint16_t keylen);
+/** Call fn for every entry in the snapshot, bucket by bucket. */
+extern void                pytt_snapshot_foreach(pytt_snapshot_t *snap, pytt_snapshot_f fn,
+						 void *arg);
+
+/*
+   Expiring entries. Only available on tables created with the PYTT_TTL
+   flag. Time is an abstract, monotonically increasing tick count chosen
+   by the caller (seconds, milliseconds, ...); the table's notion of "now"
+   is whatever was last passed to pytt_set_time or pytt_expire.
+
+   Expired entries are removed lazily when pytt_entry_get or
+   pytt_entry_create runs into them, and in bounded batches by
+   pytt_expire, which walks a hierarchical timer wheel instead of the
+   whole table.
+*/
+
+/** Same as pytt_entry_create, but the entry expires ttl ticks from now. */
+extern pytt_entry_t *pytt_entry_create_ttl(pytt_t *ht, const void *key, uint16_t keylen,
+					   uint64_t ttl);
+/** Set the time to live of an entry. A ttl of 0 makes the entry permanent. */
+extern void          pytt_entry_set_ttl(pytt_t *ht, pytt_entry_t *ent, uint64_t ttl);
+/** Get the absolute expiry time of an entry, or 0 if it never expires. */
+extern uint64_t      pytt_entry_get_expiry(pytt_t *ht, pytt_entry_t *ent);
+/** Advance the table clock without reaping anything. */
+extern void          pytt_set_time(pytt_t *ht, uint64_t now);
+/** Advance the table clock to now and destroy at most budget expired entries
+ *  (0 means no limit). Returns the number of entries destroyed. Call again to
+ *  continue where a previous call ran out of budget. The wheel skips empty
+ *  slots, and one call does a bounded amount of work however far the clock
+ *  jumps, so after a large jump it may take a few calls to catch up. Lookups
+ *  never return expired entries meanwhile. */
+extern size_t        pytt_expire(pytt_t *ht, uint64_t now, size_t budget);
+
+/*
+   Key interning. A pytt_intern_t hands out one small handle per distinct
+   key and keeps a single copy of the key bytes. Tables created with
+   pytt_create_interned store only the handle in their entries, so any
+   number of tables can share one copy of each key, and key comparisons
+   in them are integer compares.
+
+   The regular byte-key functions keep working on interned tables; they
+   translate the key through the pool first. pytt_entry_get_key_ptr
+   returns the pooled bytes, while hdr.keylen and the key area at the end
+   of the entry hold the handle. The handle functions skip the translation.
+   Handles are never reused: the pool only grows until it is destroyed,
+   which must happen after all tables using it are gone.
+*/
+
+typedef struct pytt_intern_t pytt_intern_t;
+
+/** Create an empty key pool. */
+extern pytt_intern_t *pytt_intern_create(unsigned int bucket_bits);
+/** Destroy a key pool. */
+extern void           pytt_intern_destroy(pytt_intern_t *pool);
+/** Get the handle for a key, adding it to the pool if needed. */
+extern pytt_handle_t  pytt_intern(pytt_intern_t *pool, const void *key, uint16_t keylen);
+/** Get the handle for a key, or PYTT_NO_HANDLE if it isn't in the pool. */
+extern pytt_handle_t  pytt_intern_find(pytt_intern_t *pool, const void *key, uint16_t keylen);
+/** Get the key bytes (and optionally their length) for a handle. */
+extern const void    *pytt_intern_get(pytt_intern_t *pool, pytt_handle_t handle, uint16_t *keylen);
+/** Get the number of keys in a pool. */
+extern uint32_t       pytt_intern_count(pytt_intern_t *pool);
+
+/** Create a hash table whose keys are handles from pool. */
+extern pytt_t        *pytt_create_interned(unsigned int bucket_bits,
+					   size_t	data_size,
+					   pytt_intern_t *pool);
+#ifndef PYTT_BUILDING_LIBRARY
+#define pytt_create_interned(bucket_bits, data_size, pool)			\
+  PYTT_CHECKED_CREATE(pytt_create_interned(bucket_bits, data_size, pool))
+#endif
+/** Create an entry for a handle, or return the one that already exists. */
+extern pytt_entry_t  *pytt_entry_create_handle(pytt_t *ht, pytt_handle_t handle);
+/** Get the entry for a handle or NULL if it doesn't exist. */
+extern pytt_entry_t  *pytt_entry_get_handle(pytt_t *ht, pytt_handle_t handle);
+/** Destroy the entry for a handle. */
+extern void           pytt_entry_remove_handle(pytt_t *ht, pytt_handle_t handle);
+/** Get the handle an entry in an interned table is keyed on. */
+extern pytt_handle_t  pytt_entry_handle(pytt_t *ht, pytt_entry_t *ent);
+
+/*
+   Bulk loading of line oriented text files (POSIX only, see pytt_load.c).
+   The file is memory mapped and parsed and hashed by several threads, then
+   inserted in file order, so later lines win over earlier ones with the
+   same key.
+
+   The parse callback gets one line without its line terminator, and
+   should point *key into the line, set *keylen and fill in data, which is
+   data_size zeroed bytes that get copied to the start of the entry's data.
+   It returns 0 to skip the line.
+*/
+
+typedef int (*pytt_parse_f)(const char *line, size_t len,
+			    const char **key, uint16_t *keylen,
+			    void *data, void *arg);
+
+typedef struct pytt_load_stats_t
+{
+  size_t         bytes;         /**< Size of the file. */
+  size_t         lines;         /**< Lines seen. */
+  size_t         records;       /**< Lines the parser accepted. */
+  int            threads;       /**< Parser threads used. */
+  double         seconds;       /**< Wall clock time for the whole load. */
+  double         mb_per_sec;    /**< bytes / seconds, in 10^6 bytes per second. */
+} pytt_load_stats_t;
+
+/** Parser for "<int> <key>" lines like the ones in data.txt. Stores the int
+ *  in the first bytes of data, so data_size must be at least sizeof(int).
+ *  Skips lines whose number doesn't fit in an int. */
+extern int           pytt_parse_int_word(const char *line, size_t len,
+					 const char **key, uint16_t *keylen,
+					 void *data, void *arg);
+
+/** Load a text file into a new table. bucket_bits of 0 sizes the table to
+ *  the number of lines in the file. A NULL parse means pytt_parse_int_word,
+ *  and threads of 0 means one per online CPU. stats may be NULL. Returns
+ *  NULL if the file can't be opened or mapped. */
+extern pytt_t       *pytt_load_text(const char	    *path,
+				    unsigned int     bucket_bits,
+				    size_t	     data_size,
+				    pytt_parse_f     parse,
+				    void	    *arg,
+				    int		     threads,
+				    pytt_load_stats_t *stats);
+
 #define PYTT_DECLARE_TYPED_WITH_OPTIONS(entry_type, prefix, ...)                \
   PYTT_DECLARE_TYPED_TABLE(entry_type, prefix)					\
   extern prefix ## _t *prefix ## _create(int bucket_bits);			\
@@ -171,6 +584,10 @@ extern void         *pytt_entry_get_key_ptr(pytt_t *ht, pytt_entry_t *ent);
   extern entry_type *prefix ## _entry_create(prefix ## _t *ht, __VA_ARGS__);	\
   extern entry_type *prefix ## _entry_get(prefix ## _t *ht, __VA_ARGS__);	\
   extern void prefix ## _entry_remove(prefix ## _t *ht, __VA_ARGS__);		\
+  extern pytt_hash_t prefix ## _hash(prefix ## _t *ht, __VA_ARGS__);		\
+  extern entry_type *prefix ## _entry_create_hashed(prefix ## _t *ht, pytt_hash_t hash, __VA_ARGS__); \
+  extern entry_type *prefix ## _entry_get_hashed(prefix ## _t *ht, pytt_hash_t hash, __VA_ARGS__); \
+  extern void prefix ## _entry_remove_hashed(prefix ## _t *ht, pytt_hash_t hash, __VA_ARGS__); \
   extern void prefix ## _entry_destroy(prefix ## _t *ht, entry_type *ent);	\
   extern entry_type *prefix ## _entry_prev(entry_type *ent);			\
   extern entry_type *prefix ## _entry_next(entry_type *ent); 
@@ -212,6 +629,18 @@ extern void         *pytt_entry_get_key_ptr(pytt_t *ht, pytt_entry_t *ent);
   void prefix ## _entry_remove(prefix ## _t *ht, __VA_ARGS__)					\
   { pytt_entry_remove((pytt_t *) ht, keyptr, keylen); }						\
 												\
+  pytt_hash_t prefix ## _hash(prefix ## _t *ht, __VA_ARGS__)					\
+  { return pytt_hash((pytt_t *) ht, keyptr, keylen); }						\
+												\
+  entry_type *prefix ## _entry_create_hashed(prefix ## _t *ht, pytt_hash_t hash, __VA_ARGS__)	\
+  { return (entry_type *) pytt_entry_create_hashed((pytt_t *) ht, hash, keyptr, keylen); }	\
+												\
+  entry_type *prefix ## _entry_get_hashed(prefix ## _t *ht, pytt_hash_t hash, __VA_ARGS__)	\
+  { return (entry_type *) pytt_entry_get_hashed((pytt_t *) ht, hash, keyptr, keylen); }	\
+												\
+  void prefix ## _entry_remove_hashed(prefix ## _t *ht, pytt_hash_t hash, __VA_ARGS__)	\
+  { pytt_entry_remove_hashed((pytt_t *) ht, hash, keyptr, keylen); }				\
+												\
   void prefix ## _entry_destroy(prefix ## _t *ht, entry_type *ent)				\
   { pytt_entry_destroy((pytt_t *) ht, (pytt_entry_t *) ent); }					\
 												\
@@ -0,0 +1,323 @@
+/* The cuckoo create functions are defined here, so no macros for them. */
+#define PYTT_BUILDING_LIBRARY
+
+#include <stdlib.h>
+#include <string.h>
+#include "pytt_cuckoo.h"
+#include "pytt_mem.h"
+
+/* Give up on displacing residents after this many moves and grow. */
+#define PYTT_CUCKOO_MAX_KICKS       500
+
+/* Grow before the table gets full enough for inserts to get slow. */
+#define PYTT_CUCKOO_MAX_LOAD(slots) ((slots) - (slots) / 16)
+
+static size_t bucket_count(unsigned int bucket_bits)
+{
+  return (size_t) 1 << bucket_bits;
+}
+
+/* The two candidate buckets come from the two halves of the 64-bit hash,
+ * and the tag from all of it, so it says something the bucket index
+ * doesn't. A tag is never 0, which marks an empty slot. */
+static void hash_split(unsigned int bucket_bits, pytt_hash_t hash,
+		       size_t *b1, size_t *b2, uint16_t *tag)
+{
+  size_t mask = bucket_count(bucket_bits) - 1;
+
+  *b1 = (size_t) (hash & mask);
+  *b2 = (size_t) ((hash >> 32) & mask);
+  *tag = (uint16_t) ((hash * 0x9e3779b97f4a7c15ULL) >> 48);
+
+  if(! *tag) {
+    *tag = 1;
+  }
+}
+
+static pytt_hash_t entry_hash(pytt_cuckoo_t *ht, pytt_entry_t *ent)
+{
+  return pytt_hash_seeded(ht->hash_initializer, ent->data + ht->data_size, ent->hdr.keylen);
+}
+
+static int bucket_put(pytt_cuckoo_bucket_t *b, pytt_entry_t *ent, uint16_t tag)
+{
+  int i;
+
+  for(i = 0; i != PYTT_CUCKOO_WAYS; ++i) {
+    if(! b->tags[i]) {
+      b->tags[i] = tag;
+      b->slots[i] = ent;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static uint32_t next_kick(pytt_cuckoo_t *ht)
+{
+  /* xorshift32 */
+  uint32_t x = ht->kick_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  ht->kick_state = x;
+  return x;
+}
+
+/* Places ent in buckets, moving other entries around if needed. Returns 0 if
+ * it gave up, in which case some entry (not necessarily ent) is homeless. */
+static int place(pytt_cuckoo_t *ht, pytt_cuckoo_bucket_t *buckets, unsigned int bucket_bits,
+		 pytt_entry_t *ent, pytt_hash_t hash)
+{
+  size_t b1, b2, b;
+  uint16_t tag;
+  int kicks;
+
+  hash_split(bucket_bits, hash, &b1, &b2, &tag);
+
+  if(bucket_put(&buckets[b1], ent, tag) || bucket_put(&buckets[b2], ent, tag)) {
+    return 1;
+  }
+
+  b = (next_kick(ht) & 1) ? b1 : b2;
+
+  for(kicks = 0; kicks != PYTT_CUCKOO_MAX_KICKS; ++kicks) {
+    int i = next_kick(ht) % PYTT_CUCKOO_WAYS;
+    pytt_entry_t *victim = buckets[b].slots[i];
+    uint16_t victim_tag = buckets[b].tags[i];
+
+    buckets[b].slots[i] = ent;
+    buckets[b].tags[i] = tag;
+
+    /* Now find the victim a home in its other bucket. */
+    ent = victim;
+    hash_split(bucket_bits, entry_hash(ht, ent), &b1, &b2, &tag);
+    tag = victim_tag;
+    b = (b == b1) ? b2 : b1;
+
+    if(bucket_put(&buckets[b], ent, tag)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Rebuilds the bucket array at twice the size (or more, if that's
+ * what it takes) from the list of all entries. */
+static void grow(pytt_cuckoo_t *ht)
+{
+  unsigned int bucket_bits = ht->bucket_bits;
+
+  for(;;) {
+    size_t size;
+    pytt_cuckoo_bucket_t *buckets;
+    pytt_entry_t *ent;
+
+    ++bucket_bits;
+    size = bucket_count(bucket_bits) * sizeof(pytt_cuckoo_bucket_t);
+    buckets = pytt_pages_alloc(size, 0, -1);
+
+    for(ent = ht->first; ent; ent = ent->hdr.next) {
+      if(! place(ht, buckets, bucket_bits, ent, entry_hash(ht, ent))) {
+	break;
+      }
+    }
+
+    if(! ent) {
+      pytt_pages_free(ht->buckets, bucket_count(ht->bucket_bits) * sizeof(pytt_cuckoo_bucket_t));
+      ht->buckets = buckets;
+      ht->bucket_bits = bucket_bits;
+      return;
+    }
+
+    pytt_pages_free(buckets, size);
+  }
+}
+
+pytt_cuckoo_t *pytt_cuckoo_create(unsigned int bucket_bits, size_t data_size)
+{
+  return pytt_cuckoo_create_custom(bucket_bits, data_size, &malloc, &free,
+				   PYTT_DEFAULT_HASH_INITIALIZER);
+}
+
+pytt_cuckoo_t *pytt_cuckoo_create_custom(unsigned int	    bucket_bits,
+					 size_t		    data_size,
+					 pytt_allocator_f   alloc,
+					 pytt_deallocator_f dealloc,
+					 uint32_t	    hash_initializer)
+{
+  pytt_cuckoo_t *ht = malloc(sizeof(pytt_cuckoo_t));
+
+  memset(ht, 0, sizeof(pytt_cuckoo_t));
+
+  ht->alloc            = alloc ? alloc : malloc;
+  ht->dealloc          = dealloc ? dealloc : free;
+  ht->data_size        = data_size;
+  ht->bucket_bits      = bucket_bits;
+  ht->hash_initializer = hash_initializer;
+  ht->kick_state       = 0x2545f491;
+  ht->first            = NULL;
+  ht->buckets          = pytt_pages_alloc(bucket_count(bucket_bits) * sizeof(pytt_cuckoo_bucket_t),
+					  0, -1);
+
+  return ht;
+}
+
+void pytt_cuckoo_destroy(pytt_cuckoo_t *ht)
+{
+  pytt_entry_t *ent = ht->first;
+
+  while(ent) {
+    pytt_entry_t *next = ent->hdr.next;
+    if(ht->remove_callback) {
+      ht->remove_callback(ent);
+    }
+
+    ht->dealloc(ent);
+    ent = next;
+  }
+
+  pytt_pages_free(ht->buckets, bucket_count(ht->bucket_bits) * sizeof(pytt_cuckoo_bucket_t));
+  free(ht);
+}
+
+void *pytt_cuckoo_entry_get_key_ptr(pytt_cuckoo_t *ht, pytt_entry_t *ent)
+{
+  return ent->data + ht->data_size;
+}
+
+static pytt_entry_t *bucket_find(pytt_cuckoo_t *ht, pytt_cuckoo_bucket_t *b, uint16_t tag,
+				 const void *key, uint16_t keylen)
+{
+  int i;
+
+  for(i = 0; i != PYTT_CUCKOO_WAYS; ++i) {
+    pytt_entry_t *ent = b->slots[i];
+    if(b->tags[i] == tag && ent->hdr.keylen == keylen
+       && !memcmp(ent->data + ht->data_size, key, keylen)) {
+      return ent;
+    }
+  }
+
+  return NULL;
+}
+
+pytt_entry_t *pytt_cuckoo_entry_get_hashed(pytt_cuckoo_t *ht, pytt_hash_t hash,
+					   const void *key, uint16_t keylen)
+{
+  size_t b1, b2;
+  uint16_t tag;
+  pytt_entry_t *ent;
+
+  hash_split(ht->bucket_bits, hash, &b1, &b2, &tag);
+
+#ifdef __GNUC__
+  __builtin_prefetch(&ht->buckets[b2]);
+#endif
+
+  ent = bucket_find(ht, &ht->buckets[b1], tag, key, keylen);
+  if(! ent) {
+    ent = bucket_find(ht, &ht->buckets[b2], tag, key, keylen);
+  }
+
+  return ent;
+}
+
+pytt_entry_t *pytt_cuckoo_entry_get(pytt_cuckoo_t *ht, const void *key, uint16_t keylen)
+{
+  return pytt_cuckoo_entry_get_hashed(ht, pytt_hash_seeded(ht->hash_initializer, key, keylen),
+				      key, keylen);
+}
+
+pytt_entry_t *pytt_cuckoo_entry_create_hashed(pytt_cuckoo_t *ht, pytt_hash_t hash,
+					      const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_cuckoo_entry_get_hashed(ht, hash, key, keylen);
+
+  if(ent) {
+    return ent;
+  }
+
+  if(ht->count >= PYTT_CUCKOO_MAX_LOAD(bucket_count(ht->bucket_bits) * PYTT_CUCKOO_WAYS)) {
+    grow(ht);
+  }
+
+  ent = ht->alloc(sizeof(pytt_entry_t) + ht->data_size + keylen);
+  memcpy(ent->data + ht->data_size, key, keylen);
+  ent->hdr.keylen = keylen;
+  ent->hdr.flags = 0;
+  ent->hdr.prev = NULL;
+  ent->hdr.next = ht->first;
+  if(ht->first) {
+    ht->first->hdr.prev = ent;
+  }
+  ht->first = ent;
+  ++ht->count;
+
+  /* Everything is on the list, so growing takes care of whichever
+   * entry was left without a bucket. */
+  if(! place(ht, ht->buckets, ht->bucket_bits, ent, hash)) {
+    grow(ht);
+  }
+
+  if(ht->create_callback) {
+    ht->create_callback(ent);
+  }
+
+  return ent;
+}
+
+pytt_entry_t *pytt_cuckoo_entry_create(pytt_cuckoo_t *ht, const void *key, uint16_t keylen)
+{
+  return pytt_cuckoo_entry_create_hashed(ht, pytt_hash_seeded(ht->hash_initializer, key, keylen),
+					 key, keylen);
+}
+
+void pytt_cuckoo_entry_remove(pytt_cuckoo_t *ht, const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_cuckoo_entry_get(ht, key, keylen);
+
+  if(ent) {
+    pytt_cuckoo_entry_destroy(ht, ent);
+  }
+}
+
+void pytt_cuckoo_entry_destroy(pytt_cuckoo_t *ht, pytt_entry_t *ent)
+{
+  size_t b[2];
+  uint16_t tag;
+  int i, j;
+
+  hash_split(ht->bucket_bits, entry_hash(ht, ent), &b[0], &b[1], &tag);
+
+  for(j = 0; j != 2; ++j) {
+    pytt_cuckoo_bucket_t *bucket = &ht->buckets[b[j]];
+    for(i = 0; i != PYTT_CUCKOO_WAYS; ++i) {
+      if(bucket->slots[i] == ent) {
+	bucket->slots[i] = NULL;
+	bucket->tags[i] = 0;
+	goto found;
+      }
+    }
+  }
+
+ found:
+  if(ht->remove_callback) {
+    ht->remove_callback(ent);
+  }
+
+  if(ent->hdr.prev) {
+    ent->hdr.prev->hdr.next = ent->hdr.next;
+  } else {
+    ht->first = ent->hdr.next;
+  }
+
+  if(ent->hdr.next) {
+    ent->hdr.next->hdr.prev = ent->hdr.prev;
+  }
+
+  --ht->count;
+  ht->dealloc(ent);
+}
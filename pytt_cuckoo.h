@@ -0,0 +1,96 @@
+/* Pytt - A simple hash table in C.
+ *
+ * Bucketized cuckoo hashing backend.
+ *
+ * Every key can live in one of two buckets of PYTT_CUCKOO_WAYS slots
+ * each, so a lookup inspects at most two buckets no matter how full the
+ * table is or how unlucky the keys are. Each bucket fits in one cache
+ * line and holds a 16-bit tag per slot, so slots that can't match are
+ * skipped without touching their entries. Inserting into two full
+ * buckets moves residents to their other bucket, and doubles the table
+ * if that takes too long.
+ *
+ * Entries are laid out exactly like pytt_entry_t ones, with the key at
+ * the end of the data, so PYTT_HDR structs work unchanged. hdr.prev and
+ * hdr.next link all entries for iteration starting at ->first, and hdr.flags
+ * is unused. Hashes are the ones from pytt_hash_seeded, so a hash can be
+ * shared with pytt tables created with the same initializer.
+ */
+
+#ifndef PYTT_CUCKOO_H
+#define PYTT_CUCKOO_H
+
+#include "pytt.h"
+
+#define PYTT_CUCKOO_WAYS            4
+
+typedef struct pytt_cuckoo_bucket_t
+{
+  uint16_t       tags[PYTT_CUCKOO_WAYS];
+  pytt_entry_t  *slots[PYTT_CUCKOO_WAYS];
+  /* Pad to a full cache line so that buckets never straddle two. */
+  char           pad[64 - PYTT_CUCKOO_WAYS * (sizeof(uint16_t) + sizeof(pytt_entry_t *))];
+} pytt_cuckoo_bucket_t;
+
+typedef struct pytt_cuckoo_t
+{
+  uint16_t       bucket_bits;
+  uint16_t       flags;
+  uint32_t       hash_initializer;
+  size_t         data_size;
+  size_t         count;
+
+  /** These get called to initialize and free data in entries. */
+  void         (*create_callback)(pytt_entry_t *ent);
+  void         (*remove_callback)(pytt_entry_t *ent);
+
+  /** Memory management functions used when allocating entries. */
+  pytt_allocator_f alloc;
+  pytt_deallocator_f dealloc;
+
+  /** State for picking which resident to displace. */
+  uint32_t       kick_state;
+
+  /** The first entry in the linked list. */
+  pytt_entry_t  *first;
+  /** 1 << bucket_bits buckets, cache line aligned. */
+  pytt_cuckoo_bucket_t *buckets;
+} pytt_cuckoo_t;
+
+/** Create a new cuckoo table. Uses malloc and free for entries. */
+extern pytt_cuckoo_t *pytt_cuckoo_create(unsigned int bucket_bits, size_t data_size);
+/** Create a new cuckoo table using custom parameters. */
+extern pytt_cuckoo_t *pytt_cuckoo_create_custom(unsigned int	   bucket_bits,
+						size_t		   data_size,
+						pytt_allocator_f   alloc,
+						pytt_deallocator_f dealloc,
+						uint32_t	   hash_initializer);
+#ifndef PYTT_BUILDING_LIBRARY
+#define pytt_cuckoo_create(bucket_bits, data_size)				\
+  PYTT_CHECKED_CREATE(pytt_cuckoo_create(bucket_bits, data_size))
+#define pytt_cuckoo_create_custom(bucket_bits, data_size, alloc, dealloc, hash_initializer) \
+  PYTT_CHECKED_CREATE(pytt_cuckoo_create_custom(bucket_bits, data_size, alloc, dealloc, \
+						hash_initializer))
+#endif
+/** Destroy a cuckoo table and all its entries. */
+extern void           pytt_cuckoo_destroy(pytt_cuckoo_t *ht);
+
+/** Create an entry for the key, or return the one that already exists. */
+extern pytt_entry_t  *pytt_cuckoo_entry_create(pytt_cuckoo_t *ht, const void *key, uint16_t keylen);
+/** Get the entry for the key or NULL if it doesn't exist. */
+extern pytt_entry_t  *pytt_cuckoo_entry_get(pytt_cuckoo_t *ht, const void *key, uint16_t keylen);
+/** Destroy the entry for a key. */
+extern void           pytt_cuckoo_entry_remove(pytt_cuckoo_t *ht, const void *key, uint16_t keylen);
+/** Destroy an entry. */
+extern void           pytt_cuckoo_entry_destroy(pytt_cuckoo_t *ht, pytt_entry_t *ent);
+
+/** Same as the above, with the hash computed by pytt_hash_seeded. */
+extern pytt_entry_t  *pytt_cuckoo_entry_create_hashed(pytt_cuckoo_t *ht, pytt_hash_t hash,
+						      const void *key, uint16_t keylen);
+extern pytt_entry_t  *pytt_cuckoo_entry_get_hashed(pytt_cuckoo_t *ht, pytt_hash_t hash,
+						   const void *key, uint16_t keylen);
+
+/** Get a pointer to the key for an entry. */
+extern void          *pytt_cuckoo_entry_get_key_ptr(pytt_cuckoo_t *ht, pytt_entry_t *ent);
+
+#endif /* PYTT_CUCKOO_H */
@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pytt_frozen.h"
+
+/* Average number of keys per pilot. Fewer means more pilots to store,
+ * more means longer searches for them. */
+#define PYTT_FROZEN_GROUP_SIZE  4
+
+/* Spare slots, in percent of the keys. The last groups placed would
+ * otherwise have to find the very last free slots by trial and error. */
+#define PYTT_FROZEN_SPARE       1
+
+/* Seeds to try before giving up, for when two keys share a 64-bit hash. */
+#define PYTT_FROZEN_SEEDS       16
+
+/* Keys up to this long get records of one size, room for the longest key
+ * included, so that the slot gives the record without an offset to load.
+ * Longer keys of different lengths would waste too much of that room. */
+#define PYTT_FROZEN_SHORT_KEY   32
+
+typedef struct frozen_record_t
+{
+  uint16_t       keylen;
+  uint16_t       pad[3];
+  /* Data then key, like in pytt_entry_t. */
+  char           data[];
+} frozen_record_t;
+
+typedef struct frozen_key_t
+{
+  const void    *key;
+  pytt_entry_t  *ent;
+  pytt_hash_t    hash;
+  size_t         slot;
+  uint16_t       keylen;
+} frozen_key_t;
+
+static size_t record_size(size_t data_size, uint16_t keylen)
+{
+  return (sizeof(frozen_record_t) + data_size + keylen + 7) & ~(size_t) 7;
+}
+
+/* Maps 32 random bits onto 0..n-1 without a division. */
+static size_t reduce(uint32_t x, size_t n)
+{
+  return (size_t) (((uint64_t) x * n) >> 32);
+}
+
+static size_t group_for(pytt_hash_t hash, size_t groups)
+{
+  return reduce((uint32_t) (hash >> 32), groups);
+}
+
+static size_t slot_for(pytt_hash_t hash, uint16_t pilot, size_t slots)
+{
+  uint64_t x = hash ^ (((uint64_t) pilot + 1) * 0x9e3779b97f4a7c15ULL);
+
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+
+  return reduce((uint32_t) (x >> 32), slots);
+}
+
+/* Finds a pilot for every group, filling in keys[].slot. Returns 0 if
+ * some group has no pilot that works. */
+static int find_pilots(pytt_frozen_t *fz, frozen_key_t *keys)
+{
+  size_t n = fz->count, g, i, k;
+  size_t *sizes = calloc(fz->group_count + 1, sizeof(size_t));
+  size_t *starts = calloc(fz->group_count + 1, sizeof(size_t));
+  size_t *members = malloc(n * sizeof(size_t));
+  size_t *order = malloc(fz->group_count * sizeof(size_t));
+  size_t *by_size;
+  size_t *slots;
+  unsigned char *taken = calloc(fz->slot_count, 1);
+  size_t largest = 0;
+  int ok = 1;
+
+  /* Bucket the keys by group... */
+  for(i = 0; i != n; ++i) {
+    ++sizes[group_for(keys[i].hash, fz->group_count)];
+  }
+  for(g = 0; g != fz->group_count; ++g) {
+    starts[g + 1] = starts[g] + sizes[g];
+    if(sizes[g] > largest) {
+      largest = sizes[g];
+    }
+  }
+  for(i = 0; i != n; ++i) {
+    g = group_for(keys[i].hash, fz->group_count);
+    members[starts[g]++] = i;
+  }
+  for(g = 0; g != fz->group_count; ++g) {
+    starts[g] -= sizes[g];
+  }
+
+  /* ...and place the biggest groups first, while there is room. */
+  by_size = calloc(largest + 2, sizeof(size_t));
+  for(g = 0; g != fz->group_count; ++g) {
+    ++by_size[largest - sizes[g] + 1];
+  }
+  for(k = 1; k <= largest + 1; ++k) {
+    by_size[k] += by_size[k - 1];
+  }
+  for(g = 0; g != fz->group_count; ++g) {
+    order[by_size[largest - sizes[g]]++] = g;
+  }
+
+  slots = malloc((largest + 1) * sizeof(size_t));
+
+  for(k = 0; k != fz->group_count && ok; ++k) {
+    size_t size, *member;
+    uint32_t pilot;
+
+    g = order[k];
+    size = sizes[g];
+    member = members + starts[g];
+
+    if(! size) {
+      break;
+    }
+
+    for(pilot = 0; pilot <= 0xffff; ++pilot) {
+      for(i = 0; i != size; ++i) {
+	slots[i] = slot_for(keys[member[i]].hash, (uint16_t) pilot, fz->slot_count);
+	if(taken[slots[i]]) {
+	  break;
+	}
+	taken[slots[i]] = 1;
+      }
+
+      if(i == size) {
+	break;
+      }
+
+      /* Undo the partial placement and try the next pilot. */
+      while(i--) {
+	taken[slots[i]] = 0;
+      }
+    }
+
+    if(pilot > 0xffff) {
+      ok = 0;
+      break;
+    }
+
+    fz->pilots[g] = (uint16_t) pilot;
+    for(i = 0; i != size; ++i) {
+      keys[member[i]].slot = slots[i];
+    }
+  }
+
+  if(ok) {
+    /* Hand out the free slots below count to the used ones above it. */
+    size_t free_slot = 0;
+
+    for(i = n; i != fz->slot_count; ++i) {
+      if(taken[i]) {
+	while(taken[free_slot]) {
+	  ++free_slot;
+	}
+	fz->remap[i - n] = (uint32_t) free_slot++;
+      }
+    }
+
+    for(i = 0; i != n; ++i) {
+      if(keys[i].slot >= n) {
+	keys[i].slot = fz->remap[keys[i].slot - n];
+      }
+    }
+  }
+
+  free(sizes);
+  free(starts);
+  free(members);
+  free(order);
+  free(by_size);
+  free(slots);
+  free(taken);
+
+  return ok;
+}
+
+pytt_frozen_t *pytt_freeze(pytt_t *ht)
+{
+  pytt_frozen_t *fz;
+  frozen_key_t *keys;
+  pytt_entry_t *ent;
+  size_t *by_slot;
+  size_t n = 0, i, offset;
+  uint16_t min_keylen = 0xffff, max_keylen = 0;
+  int attempt;
+
+  /* Records have one data size for all. */
+  if(ht->flags & PYTT_VARIABLE_DATA) {
+    return NULL;
+  }
+
+  for(ent = ht->first; ent; ent = ent->hdr.next) {
+    ++n;
+  }
+
+  if(n >= 0xffffffffUL) {
+    return NULL;
+  }
+
+  fz = malloc(sizeof(pytt_frozen_t));
+  memset(fz, 0, sizeof(pytt_frozen_t));
+  fz->count = n;
+  fz->data_size = ht->data_size;
+  fz->group_count = n / PYTT_FROZEN_GROUP_SIZE + 1;
+  fz->slot_count = n + n * PYTT_FROZEN_SPARE / 100 + 1;
+  if(fz->slot_count > 0xffffffffUL) {
+    fz->slot_count = 0xffffffffUL;
+  }
+
+  keys = malloc((n + 1) * sizeof(frozen_key_t));
+  for(i = 0, ent = ht->first; ent; ent = ent->hdr.next, ++i) {
+    keys[i].ent = ent;
+    if(ht->intern) {
+      keys[i].key = pytt_intern_get(ht->intern, pytt_entry_handle(ht, ent), &keys[i].keylen);
+    } else {
+      keys[i].key = pytt_entry_get_key_ptr(ht, ent);
+      keys[i].keylen = ent->hdr.keylen;
+    }
+    fz->blob_size += record_size(fz->data_size, keys[i].keylen);
+    if(keys[i].keylen < min_keylen) {
+      min_keylen = keys[i].keylen;
+    }
+    if(keys[i].keylen > max_keylen) {
+      max_keylen = keys[i].keylen;
+    }
+  }
+
+  if(min_keylen == max_keylen || max_keylen <= PYTT_FROZEN_SHORT_KEY) {
+    fz->stride = record_size(fz->data_size, max_keylen);
+    fz->blob_size = n * fz->stride;
+  } else if(fz->blob_size / 8 > 0xffffffffUL) {
+    free(keys);
+    free(fz);
+    return NULL;
+  }
+
+  fz->pilots = calloc(fz->group_count, sizeof(uint16_t));
+  fz->remap = calloc(fz->slot_count - n, sizeof(uint32_t));
+
+  for(attempt = 0; ; ++attempt) {
+    fz->seed = ht->hash_initializer + attempt;
+    for(i = 0; i != n; ++i) {
+      keys[i].hash = pytt_hash_seeded(fz->seed, keys[i].key, keys[i].keylen);
+    }
+
+    if(find_pilots(fz, keys)) {
+      break;
+    }
+
+    if(attempt == PYTT_FROZEN_SEEDS) {
+      free(keys);
+      pytt_frozen_destroy(fz);
+      return NULL;
+    }
+
+    memset(fz->pilots, 0, fz->group_count * sizeof(uint16_t));
+    memset(fz->remap, 0, (fz->slot_count - n) * sizeof(uint32_t));
+  }
+
+  /* Lay the records out in slot order, so iterating walks memory. */
+  by_slot = malloc((n + 1) * sizeof(size_t));
+  for(i = 0; i != n; ++i) {
+    by_slot[keys[i].slot] = i;
+  }
+
+  if(! fz->stride) {
+    fz->offsets = malloc((n + 1) * sizeof(uint32_t));
+  }
+  fz->blob = malloc(fz->blob_size ? fz->blob_size : 1);
+
+  for(i = 0, offset = 0; i != n; ++i) {
+    frozen_key_t *k = &keys[by_slot[i]];
+    frozen_record_t *rec = (frozen_record_t *) (fz->blob + offset);
+
+    memset(rec, 0, fz->stride ? fz->stride : sizeof(frozen_record_t));
+    rec->keylen = k->keylen;
+    memcpy(rec->data, k->ent->data, fz->data_size);
+    memcpy(rec->data + fz->data_size, k->key, k->keylen);
+
+    if(fz->stride) {
+      offset += fz->stride;
+    } else {
+      fz->offsets[i] = (uint32_t) (offset / 8);
+      offset += record_size(fz->data_size, k->keylen);
+    }
+  }
+
+  free(by_slot);
+  free(keys);
+
+  return fz;
+}
+
+void pytt_frozen_destroy(pytt_frozen_t *fz)
+{
+  free(fz->pilots);
+  free(fz->remap);
+  free(fz->offsets);
+  free(fz->blob);
+  free(fz);
+}
+
+static frozen_record_t *record_at(pytt_frozen_t *fz, size_t slot)
+{
+  if(fz->stride) {
+    return (frozen_record_t *) (fz->blob + slot * fz->stride);
+  }
+
+  return (frozen_record_t *) (fz->blob + (size_t) fz->offsets[slot] * 8);
+}
+
+void *pytt_frozen_at(pytt_frozen_t *fz, size_t i, const void **key, uint16_t *keylen)
+{
+  frozen_record_t *rec = record_at(fz, i);
+
+  if(key) {
+    *key = rec->data + fz->data_size;
+  }
+  if(keylen) {
+    *keylen = rec->keylen;
+  }
+
+  return rec->data;
+}
+
+void *pytt_frozen_get(pytt_frozen_t *fz, const void *key, uint16_t keylen)
+{
+  pytt_hash_t hash;
+  frozen_record_t *rec;
+  size_t slot;
+
+  if(! fz->count) {
+    return NULL;
+  }
+
+  hash = pytt_hash_seeded(fz->seed, key, keylen);
+  slot = slot_for(hash, fz->pilots[group_for(hash, fz->group_count)], fz->slot_count);
+  if(slot >= fz->count) {
+    slot = fz->remap[slot - fz->count];
+  }
+
+  rec = record_at(fz, slot);
+  if(rec->keylen == keylen && !memcmp(rec->data + fz->data_size, key, keylen)) {
+    return rec->data;
+  }
+
+  return NULL;
+}
+
+size_t pytt_frozen_memory(pytt_frozen_t *fz)
+{
+  return sizeof(pytt_frozen_t)
+    + fz->group_count * sizeof(uint16_t)
+    + (fz->slot_count - fz->count) * sizeof(uint32_t)
+    + (fz->offsets ? fz->count * sizeof(uint32_t) : 0)
+    + fz->blob_size;
+}
@@ -0,0 +1,61 @@
+/* Pytt - A simple hash table in C.
+ *
+ * Read-only tables indexed by a minimal perfect hash.
+ *
+ * pytt_freeze takes a table that is done changing and builds a hash
+ * function that maps each of its n keys to a distinct slot in 0..n-1
+ * (PTHash style: keys are split into small groups, and each group gets a
+ * pilot value that sends all its keys to free slots). The entries are
+ * copied into one contiguous block in slot order, so a lookup is one hash,
+ * one pilot, and one record to compare the key with, and the only
+ * per-entry overhead is an 8 byte record header instead of an allocation
+ * with list pointers. Records take the same room when the keys are all
+ * the same length or short, so the slot number gives the record. Only
+ * longer keys of different lengths get a 4 byte offset per slot.
+ */
+
+#ifndef PYTT_FROZEN_H
+#define PYTT_FROZEN_H
+
+#include "pytt.h"
+
+typedef struct pytt_frozen_t
+{
+  size_t         count;
+  size_t         data_size;
+  uint32_t       seed;
+
+  /** Pilot for each group of keys. */
+  size_t         group_count;
+  uint16_t      *pilots;
+  /** The pilots hash into slot_count >= count slots. The slots past
+   *  count each stand for one of the free ones below it. */
+  size_t         slot_count;
+  uint32_t      *remap;
+  /** Bytes per record when they all take the same room, else 0. */
+  size_t         stride;
+  /** Offset of the record for each slot in blob, in 8 byte units, when
+   *  stride is 0, else NULL. */
+  uint32_t      *offsets;
+  char          *blob;
+  size_t         blob_size;
+} pytt_frozen_t;
+
+/** Build a read-only copy of ht. ht is left as it was. Returns NULL if the
+ *  table has 2^32 or more entries, or more than 32 GB of them with offsets
+ *  to keep, or is a PYTT_VARIABLE_DATA table. Call pytt_expire first to leave out expired
+ *  entries of PYTT_TTL tables. */
+extern pytt_frozen_t *pytt_freeze(pytt_t *ht);
+/** Free a frozen table. */
+extern void           pytt_frozen_destroy(pytt_frozen_t *fz);
+
+/** Get the data for a key, or NULL if it isn't in the table. */
+extern void          *pytt_frozen_get(pytt_frozen_t *fz, const void *key, uint16_t keylen);
+/** Get the data and key of the entry in slot i, for i below fz->count. */
+extern void          *pytt_frozen_at(pytt_frozen_t *fz, size_t i,
+				     const void **key, uint16_t *keylen);
+
+/** Bytes used by the frozen table, all included. */
+extern size_t         pytt_frozen_memory(pytt_frozen_t *fz);
+
+#endif /* PYTT_FROZEN_H */
@@ -0,0 +1,236 @@
+/* Hashing many keys at once, and keys in several parts.
+ *
+ * lookup3 mixes three 32-bit words with adds, subtracts, xors and
+ * rotates, so the state of several independent hashes fits in three
+ * vector registers and one instruction advances all of them. Keys are
+ * handled in groups of 4 or 8. Each round loads the next 12 bytes of
+ * every key in the group that has more than 12 bytes left, mixes all
+ * lanes and keeps the result only for those lanes. The last block and
+ * lookup3's final mix work the same way, and the 64-bit finalizer runs
+ * per key. The result is identical to pytt_hash_seeded for every key.
+ *
+ * The kernels use GCC vector extensions. The 4 lane one needs nothing
+ * beyond SSE2 (or whatever the target has), and the 8 lane one is built
+ * for AVX2 and used when the CPU has it.
+ *
+ * A key in parts streams through lookup3 12 bytes at a time, straight
+ * from the parts where a block lies within one, and through a 12 byte
+ * block where one straddles two.
+ */
+
+#include <string.h>
+#include "pytt.h"
+#include "pytt_inline.h"
+
+/* Little endian loads of 4 and 8 bytes from anywhere. */
+static inline uint32_t load32(const unsigned char *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+#else
+  return pytt_inline_word(p, 4);
+#endif
+}
+
+static inline uint64_t load64(const unsigned char *p)
+{
+  return load32(p) | (uint64_t) load32(p + 4) << 32;
+}
+
+/* Up to 12 bytes of a key as lookup3's three words, zero padded. Partial
+ * blocks are put together from loads that overlap inside the key rather
+ * than byte by byte, so they never read past it. */
+static inline void load_block(const unsigned char *p, size_t n, uint32_t w[3])
+{
+  uint64_t lo = 0;
+  uint32_t hi = 0;
+
+  if(n >= 8) {
+    lo = load64(p);
+    if(n > 8) {
+      hi = load32(p + n - 4) >> (8 * (12 - n));
+    }
+  } else if(n >= 4) {
+    lo = load32(p) | (uint64_t) load32(p + n - 4) << (8 * (n - 4));
+  } else if(n) {
+    lo = p[0] | (uint32_t) p[n / 2] << (8 * (n / 2)) | (uint32_t) p[n - 1] << (8 * (n - 1));
+  }
+
+  w[0] = (uint32_t) lo;
+  w[1] = (uint32_t) (lo >> 32);
+  w[2] = hi;
+}
+
+#if defined(__GNUC__)
+
+/* The kernels are written once for every lane count. Everything per lane
+ * is spelled out with constant lane numbers, so the compiler keeps it in
+ * registers and builds the vectors from them directly. */
+#define PYTT_HASH_EACH4(f) f(0) f(1) f(2) f(3)
+#define PYTT_HASH_EACH8(f) f(0) f(1) f(2) f(3) f(4) f(5) f(6) f(7)
+
+#define PYTT_HASH_LANE_INIT(i)						\
+  p[i] = keys[i];							\
+  blocks[i] = keylens[i] ? (keylens[i] - 1) / 12 : 0;			\
+  if(blocks[i] > rounds) {						\
+    rounds = blocks[i];							\
+  }
+
+#define PYTT_HASH_LANE_BLOCK(i)						\
+  if(r < blocks[i]) {							\
+    load_block(p[i], 12, w[i]);						\
+    p[i] += 12;								\
+  }
+
+#define PYTT_HASH_LANE_TAIL(i) load_block(p[i], keylens[i] - 12 * blocks[i], w[i]);
+
+#define PYTT_HASH_LEN(i)    keylens[i],
+#define PYTT_HASH_BLOCKS(i) blocks[i],
+#define PYTT_HASH_A(i)      w[i][0],
+#define PYTT_HASH_B(i)      w[i][1],
+#define PYTT_HASH_C(i)      w[i][2],
+
+#define PYTT_HASH_KERNEL(name, lanes, each, attributes)			\
+  attributes static void name(uint32_t seed, const void *const *keys,	\
+			      const uint16_t *keylens, pytt_hash_t *hashes)	\
+  {									\
+    typedef uint32_t vec_t __attribute__((vector_size((lanes) * 4)));	\
+    const unsigned char *p[lanes];					\
+    uint32_t blocks[lanes], w[lanes][3] = { { 0 } };			\
+    uint32_t r, rounds = 0;						\
+    vec_t a, b, c, na, nb, nc, m;					\
+    int i;								\
+									\
+    each(PYTT_HASH_LANE_INIT)						\
+									\
+    a = (vec_t) { each(PYTT_HASH_LEN) } + (0xdeadbeef + seed);		\
+    b = c = a;								\
+									\
+    /* Whole blocks, for the lanes that have one left. */		\
+    for(r = 0; r < rounds; ++r) {					\
+      each(PYTT_HASH_LANE_BLOCK)					\
+      m = (vec_t) ((vec_t) { each(PYTT_HASH_BLOCKS) } > r);		\
+      na = a + (vec_t) { each(PYTT_HASH_A) };				\
+      nb = b + (vec_t) { each(PYTT_HASH_B) };				\
+      nc = c + (vec_t) { each(PYTT_HASH_C) };				\
+      PYTT_INLINE_MIX(na, nb, nc);					\
+      a = (na & m) | (a & ~m);						\
+      b = (nb & m) | (b & ~m);						\
+      c = (nc & m) | (c & ~m);						\
+    }									\
+									\
+    /* The last 1 to 12 bytes. Empty keys skip the final mix. */	\
+    each(PYTT_HASH_LANE_TAIL)						\
+    m = (vec_t) ((vec_t) { each(PYTT_HASH_LEN) } != 0);			\
+    na = a + (vec_t) { each(PYTT_HASH_A) };				\
+    nb = b + (vec_t) { each(PYTT_HASH_B) };				\
+    nc = c + (vec_t) { each(PYTT_HASH_C) };				\
+    PYTT_INLINE_FINAL(na, nb, nc);					\
+    b = (nb & m) | (b & ~m);						\
+    c = (nc & m) | (c & ~m);						\
+									\
+    for(i = 0; i != (lanes); ++i) {					\
+      hashes[i] = pytt_inline_finish(c[i], b[i]);					\
+    }									\
+  }
+
+PYTT_HASH_KERNEL(hash4, 4, PYTT_HASH_EACH4, )
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PYTT_HASH_AVX2
+PYTT_HASH_KERNEL(hash8_avx2, 8, PYTT_HASH_EACH8, __attribute__((target("avx2"))))
+#endif
+
+#endif /* __GNUC__ */
+
+void pytt_hash_seeded_batch(uint32_t hash_initializer, size_t count, const void *const *keys,
+			    const uint16_t *keylens, pytt_hash_t *hashes)
+{
+#ifdef PYTT_HASH_AVX2
+  if(count >= 8 && __builtin_cpu_supports("avx2")) {
+    for(; count >= 8; count -= 8, keys += 8, keylens += 8, hashes += 8) {
+      hash8_avx2(hash_initializer, keys, keylens, hashes);
+    }
+  }
+#endif
+
+#ifdef __GNUC__
+  for(; count >= 4; count -= 4, keys += 4, keylens += 4, hashes += 4) {
+    hash4(hash_initializer, keys, keylens, hashes);
+  }
+#endif
+
+  for(; count; --count, ++keys, ++keylens, ++hashes) {
+    *hashes = pytt_hash_seeded(hash_initializer, *keys, *keylens);
+  }
+}
+
+void pytt_hash_batch(pytt_t *ht, size_t count, const void *const *keys,
+		     const uint16_t *keylens, pytt_hash_t *hashes)
+{
+  pytt_hash_seeded_batch(ht->hash_initializer, count, keys, keylens, hashes);
+}
+
+pytt_hash_t pytt_hash_seededv(uint32_t hash_initializer, const pytt_keyvec_t *parts, int count)
+{
+  unsigned char block[12];
+  const unsigned char *p;
+  size_t length = 0, left, fill = 0, n, take;
+  uint32_t a, b, c, w[3];
+  int i;
+
+  for(i = 0; i < count; ++i) {
+    length += parts[i].len;
+  }
+
+  a = b = c = 0xdeadbeef + (uint32_t) length + hash_initializer;
+
+  /* Bytes not mixed in yet, including those in block. lookup3 keeps the
+   * last 1 to 12 of them for the final mix. */
+  left = length;
+
+  for(i = 0; i < count; ++i) {
+    p = parts[i].base;
+    n = parts[i].len;
+
+    while(n) {
+      if(! fill && n >= 12 && left > 12) {
+	a += load32(p);
+	b += load32(p + 4);
+	c += load32(p + 8);
+	PYTT_INLINE_MIX(a, b, c);
+	p += 12;
+	n -= 12;
+	left -= 12;
+	continue;
+      }
+
+      take = n < 12 - fill ? n : 12 - fill;
+      memcpy(block + fill, p, take);
+      fill += take;
+      p += take;
+      n -= take;
+
+      if(fill == 12 && left > 12) {
+	a += load32(block);
+	b += load32(block + 4);
+	c += load32(block + 8);
+	PYTT_INLINE_MIX(a, b, c);
+	fill = 0;
+	left -= 12;
+      }
+    }
+  }
+
+  if(length) {
+    load_block(block, fill, w);
+    a += w[0];
+    b += w[1];
+    c += w[2];
+    PYTT_INLINE_FINAL(a, b, c);
+  }
+
+  return pytt_inline_finish(c, b);
+}
@@ -0,0 +1,235 @@
+/* Pytt - A simple hash table in C.
+ *
+ * Header-only typed tables for fixed-size keys.
+ *
+ * PYTT_INLINE_TYPED generates the same functions as PYTT_TYPED, but as
+ * static inline code specialized for one entry type and one key type.
+ * The key size and its offset in the entry are compile-time constants,
+ * so the hash unrolls for that size, the key comparison becomes a few
+ * loads, and lookups inline into the caller. Only allocating a new entry
+ * and destroying one go through the library.
+ *
+ * The tables are ordinary pytt tables and hash keys exactly like
+ * pytt_hash, so inline and generic calls can be mixed on the same table.
+ * PYTT_TTL, PYTT_BUCKET_TAGS, PYTT_CONCURRENT, PYTT_VARIABLE_DATA and
+ * interned tables are handed to the generic functions, and so is
+ * entry_create while a snapshot is alive. The inline lookups use plain
+ * loads, which other threads inserting into a concurrent table would
+ * race with, and assume the key sits after data_size bytes of data,
+ * which PYTT_VARIABLE_DATA entries put first. Their data is found with
+ * pytt_entry_data rather than through entry_type, and entry_create gives
+ * new ones no data, like pytt_entry_create does.
+ *
+ *   typedef struct { PYTT_HDR; double value; } point_entry_t;
+ *   PYTT_INLINE_TYPED(point_entry_t, point_table, uint64_t)
+ *
+ *   point_table_entry_create(ht, 42)->value = 1.0;
+ */
+
+#ifndef PYTT_INLINE_H
+#define PYTT_INLINE_H
+
+#include <string.h>
+#include "pytt.h"
+
+/* MSVC only knows inline in C as __inline before Visual Studio 2015. */
+#if defined(_MSC_VER) && _MSC_VER < 1900 && !defined(__cplusplus) && !defined(inline)
+#define inline __inline
+#endif
+
+/* lookup3's mixing, from lookup3.c. */
+#define PYTT_INLINE_ROT(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+
+#define PYTT_INLINE_MIX(a, b, c)					\
+  {									\
+    a -= c;  a ^= PYTT_INLINE_ROT(c, 4);  c += b;			\
+    b -= a;  b ^= PYTT_INLINE_ROT(a, 6);  a += c;			\
+    c -= b;  c ^= PYTT_INLINE_ROT(b, 8);  b += a;			\
+    a -= c;  a ^= PYTT_INLINE_ROT(c, 16); c += b;			\
+    b -= a;  b ^= PYTT_INLINE_ROT(a, 19); a += c;			\
+    c -= b;  c ^= PYTT_INLINE_ROT(b, 4);  b += a;			\
+  }
+
+#define PYTT_INLINE_FINAL(a, b, c)					\
+  {									\
+    c ^= b; c -= PYTT_INLINE_ROT(b, 14);				\
+    a ^= c; a -= PYTT_INLINE_ROT(c, 11);				\
+    b ^= a; b -= PYTT_INLINE_ROT(a, 25);				\
+    c ^= b; c -= PYTT_INLINE_ROT(b, 16);				\
+    a ^= c; a -= PYTT_INLINE_ROT(c, 4);					\
+    b ^= a; b -= PYTT_INLINE_ROT(a, 14);				\
+    c ^= b; c -= PYTT_INLINE_ROT(b, 24);				\
+  }
+
+/** Up to 4 bytes as a little endian word, zero padded. Compilers turn
+ *  this into a single load where they can. */
+static inline uint32_t pytt_inline_word(const unsigned char *p, size_t n)
+{
+  uint32_t w = 0;
+
+  switch(n) {
+  default: w |= (uint32_t) p[3] << 24; /* fall through */
+  case 3:  w |= (uint32_t) p[2] << 16; /* fall through */
+  case 2:  w |= (uint32_t) p[1] << 8;  /* fall through */
+  case 1:  w |= p[0];                  /* fall through */
+  case 0:  break;
+  }
+
+  return w;
+}
+
+/** The finalizer every pytt hash ends with, over lookup3's two result
+ *  words. lookup3 leaves visible correlations between the low and high
+ *  bits of its outputs for sequential keys, which shows up as clustering
+ *  once the bucket index spans most of them. A 64-bit finalizer (the one
+ *  from MurmurHash3) spreads all 64 bits over each other. */
+static inline pytt_hash_t pytt_inline_finish(uint32_t c, uint32_t b)
+{
+  pytt_hash_t h = ((pytt_hash_t) b << 32) | c;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+/** pytt_hash_seeded for keys whose length is known at compile time.
+ *  Gives the same result, but folds away when inlined. */
+static inline pytt_hash_t pytt_inline_hash(uint32_t seed, const void *key, size_t length)
+{
+  const unsigned char *k = (const unsigned char *) key;
+  uint32_t a, b, c;
+
+  a = b = c = 0xdeadbeef + (uint32_t) length + seed;
+
+  if(length) {
+    while(length > 12) {
+      a += pytt_inline_word(k, 4);
+      b += pytt_inline_word(k + 4, 4);
+      c += pytt_inline_word(k + 8, 4);
+      PYTT_INLINE_MIX(a, b, c);
+      length -= 12;
+      k += 12;
+    }
+
+    a += pytt_inline_word(k, length);
+    b += length > 4 ? pytt_inline_word(k + 4, length - 4) : 0;
+    c += length > 8 ? pytt_inline_word(k + 8, length - 8) : 0;
+    PYTT_INLINE_FINAL(a, b, c);
+  }
+
+  return pytt_inline_finish(c, b);
+}
+
+/* Where the key of the given size is kept, see PYTT_HEADER_KEY_BYTES. */
+#if PYTT_HEADER_KEY_BYTES > 0
+#define PYTT_INLINE_KEY(ent, tail, size)					\
+  ((size) <= PYTT_HEADER_KEY_BYTES ? (const void *) (ent)->hdr.short_key : (const void *) (tail))
+#else
+#define PYTT_INLINE_KEY(ent, tail, size) ((const void *) (tail))
+#endif
+
+/** entry_type is the datatype of an entry, with a PYTT_HDR first.
+ *  prefix is the prefix to put on all functions.
+ *  key_type is the type of the keys, which are passed by value. Keys are
+ *  hashed and compared as bytes, so it must not have padding. */
+#define PYTT_INLINE_TYPED(entry_type, prefix, key_type)				\
+  PYTT_DECLARE_TYPED_TABLE(entry_type, prefix)					\
+										\
+  enum { prefix ## _data_size = sizeof(entry_type) - sizeof(pytt_entry_t) };	\
+										\
+  static inline prefix ## _t *prefix ## _create(int bucket_bits)		\
+  { return (prefix ## _t *) pytt_create(bucket_bits, prefix ## _data_size); }	\
+										\
+  static inline void prefix ## _destroy(prefix ## _t *ht)			\
+  { pytt_destroy((pytt_t *) ht); }						\
+										\
+  /* PYTT_VARIABLE_DATA entries have their key first. */			\
+  static inline const key_type *prefix ## _entry_key(const entry_type *ent)	\
+  {										\
+    const pytt_entry_t *e = (const pytt_entry_t *) ent;			\
+    return (const key_type *) PYTT_INLINE_KEY(e, e->hdr.flags & PYTT_ENTRY_VARIABLE_DATA \
+					      ? e->data : e->data + prefix ## _data_size, \
+					      sizeof(key_type));		\
+  }										\
+										\
+  static inline pytt_hash_t prefix ## _hash(prefix ## _t *ht, key_type key)	\
+  { return pytt_inline_hash(ht->hash_initializer, &key, sizeof(key_type)); }	\
+										\
+  static inline entry_type *prefix ## _entry_get_hashed(prefix ## _t *ht, pytt_hash_t hash, \
+							 key_type key)		\
+  {										\
+    entry_type *ent;								\
+										\
+    if(ht->wheel || ht->intern || ht->tags						\
+       || (ht->flags & (PYTT_CONCURRENT | PYTT_VARIABLE_DATA))) {			\
+      return (entry_type *) pytt_entry_get_hashed((pytt_t *) ht, hash, &key, sizeof(key_type)); \
+    }										\
+										\
+    ent = ht->buckets[hash & (((pytt_hash_t) 1 << ht->bucket_bits) - 1)];	\
+    while(ent) {								\
+      if(ent->hdr.tag == (uint32_t) (hash >> 32)				\
+	 && ent->hdr.keylen == sizeof(key_type)					\
+	 && !memcmp(prefix ## _entry_key(ent), &key, sizeof(key_type))) {	\
+	return ent;								\
+      }										\
+      if(ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) {				\
+	return NULL;								\
+      }										\
+      ent = (entry_type *) ent->hdr.next;					\
+    }										\
+										\
+    return NULL;								\
+  }										\
+										\
+  static inline entry_type *prefix ## _entry_get(prefix ## _t *ht, key_type key) \
+  { return prefix ## _entry_get_hashed(ht, prefix ## _hash(ht, key), key); }	\
+										\
+  static inline entry_type *prefix ## _entry_create_hashed(prefix ## _t *ht, pytt_hash_t hash, \
+							    key_type key)	\
+  {										\
+    entry_type *ent;								\
+										\
+    /* A snapshot needs to know about entries that may be changed,		\
+     * concurrent inserts look the key up as they go and variable-data	\
+     * entries are laid out differently. */					\
+    if(ht->snapshot || (ht->flags & (PYTT_CONCURRENT | PYTT_VARIABLE_DATA))) {	\
+      return (entry_type *) pytt_entry_create_hashed((pytt_t *) ht, hash, &key, sizeof(key_type)); \
+    }										\
+										\
+    ent = prefix ## _entry_get_hashed(ht, hash, key);				\
+    if(! ent) {									\
+      ent = (entry_type *) pytt_entry_insert_hashed((pytt_t *) ht, hash, &key, sizeof(key_type)); \
+    }										\
+										\
+    return ent;									\
+  }										\
+										\
+  static inline entry_type *prefix ## _entry_create(prefix ## _t *ht, key_type key) \
+  { return prefix ## _entry_create_hashed(ht, prefix ## _hash(ht, key), key); } \
+										\
+  static inline void prefix ## _entry_destroy(prefix ## _t *ht, entry_type *ent) \
+  { pytt_entry_destroy((pytt_t *) ht, (pytt_entry_t *) ent); }		\
+										\
+  static inline void prefix ## _entry_remove_hashed(prefix ## _t *ht, pytt_hash_t hash, \
+						     key_type key)		\
+  {										\
+    entry_type *ent = prefix ## _entry_get_hashed(ht, hash, key);		\
+    if(ent) {									\
+      prefix ## _entry_destroy(ht, ent);					\
+    }										\
+  }										\
+										\
+  static inline void prefix ## _entry_remove(prefix ## _t *ht, key_type key)	\
+  { prefix ## _entry_remove_hashed(ht, prefix ## _hash(ht, key), key); }	\
+										\
+  static inline entry_type *prefix ## _entry_prev(entry_type *ent)		\
+  { return (entry_type *) ent->hdr.prev; }					\
+										\
+  static inline entry_type *prefix ## _entry_next(entry_type *ent)		\
+  { return (entry_type *) ent->hdr.next; }
+
+#endif /* PYTT_INLINE_H */
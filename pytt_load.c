@@ -0,0 +1,337 @@
+/* Bulk loading of text files into a pytt table.
+ *
+ * The file is mapped rather than read, split into one chunk per thread on
+ * line boundaries, and each thread parses and hashes its chunk into an
+ * array of records pointing straight into the mapping. The table is then
+ * filled from those arrays in file order, so the result is the same as
+ * inserting line by line, but the parsing and hashing run in parallel and
+ * the single-threaded part is a tight loop of prehashed inserts.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pytt.h"
+
+/* Keys per call to pytt_hash_batch. */
+#define PYTT_LOAD_HASH_BATCH  64
+
+/* How far ahead of the insert loop to prefetch bucket heads. */
+#define PYTT_LOAD_PREFETCH    8
+
+typedef struct load_record_t
+{
+  const char   *key;
+  pytt_hash_t   hash;
+  uint16_t      keylen;
+} load_record_t;
+
+typedef struct load_chunk_t
+{
+  /* Input */
+  pytt_t       *ht;
+  const char   *begin;
+  const char   *end;
+  pytt_parse_f  parse;
+  void         *arg;
+
+  /* Output */
+  int            threaded;
+  load_record_t *records;
+  char          *data;
+  size_t         count;
+  size_t         lines;
+} load_chunk_t;
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t count_lines(const char *p, const char *end)
+{
+  size_t lines = 0;
+
+  /* memchr is vectorized in any libc worth using. */
+  while(p < end && (p = memchr(p, '\n', end - p))) {
+    ++lines;
+    ++p;
+  }
+
+  return lines;
+}
+
+static void hash_records(pytt_t *ht, load_record_t *records, size_t count)
+{
+  const void *keys[PYTT_LOAD_HASH_BATCH];
+  uint16_t keylens[PYTT_LOAD_HASH_BATCH];
+  pytt_hash_t hashes[PYTT_LOAD_HASH_BATCH];
+  size_t i, j, n;
+
+  for(i = 0; i < count; i += n) {
+    n = count - i < PYTT_LOAD_HASH_BATCH ? count - i : PYTT_LOAD_HASH_BATCH;
+    for(j = 0; j != n; ++j) {
+      keys[j] = records[i + j].key;
+      keylens[j] = records[i + j].keylen;
+    }
+    pytt_hash_batch(ht, n, keys, keylens, hashes);
+    for(j = 0; j != n; ++j) {
+      records[i + j].hash = hashes[j];
+    }
+  }
+}
+
+static void *parse_chunk(void *arg)
+{
+  load_chunk_t *chunk = arg;
+  size_t data_size = chunk->ht->data_size;
+  size_t capacity = count_lines(chunk->begin, chunk->end) + 1;
+  const char *line = chunk->begin;
+
+  chunk->records = malloc(capacity * sizeof(load_record_t));
+  chunk->data = calloc(capacity, data_size ? data_size : 1);
+  chunk->count = 0;
+  chunk->lines = 0;
+
+  while(line < chunk->end) {
+    const char *eol = memchr(line, '\n', chunk->end - line);
+    load_record_t *rec = &chunk->records[chunk->count];
+    size_t len;
+
+    if(! eol) {
+      eol = chunk->end;
+    }
+
+    len = eol - line;
+    if(len && line[len - 1] == '\r') {
+      --len;
+    }
+
+    ++chunk->lines;
+    if(chunk->parse(line, len, &rec->key, &rec->keylen,
+		    chunk->data + chunk->count * data_size, chunk->arg)) {
+      ++chunk->count;
+    } else {
+      memset(chunk->data + chunk->count * data_size, 0, data_size);
+    }
+
+    line = eol + 1;
+  }
+
+  hash_records(chunk->ht, chunk->records, chunk->count);
+
+  return NULL;
+}
+
+int pytt_parse_int_word(const char *line, size_t len, const char **key, uint16_t *keylen,
+			void *data, void *arg)
+{
+  const char *end = line + len;
+  const char *space = memchr(line, ' ', len);
+  const char *p = line;
+  int negative = 0;
+  unsigned int magnitude = 0;
+  int value;
+
+  if(! space) {
+    return 0;
+  }
+
+  if(p < space && *p == '-') {
+    negative = 1;
+    ++p;
+  }
+
+  /* Lines with a number that doesn't fit in an int are rejected, INT_MIN
+   * being the one whose magnitude is INT_MAX + 1. */
+  while(p < space && *p >= '0' && *p <= '9') {
+    unsigned int digit = (unsigned int) (*p++ - '0');
+
+    if(magnitude > ((unsigned int) INT_MAX + negative - digit) / 10) {
+      return 0;
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+
+  if(negative) {
+    value = magnitude ? -(int) (magnitude - 1) - 1 : 0;
+  } else {
+    value = (int) magnitude;
+  }
+
+  ++space;
+  while(end > space && end[-1] >= 0 && end[-1] <= 32) {
+    --end;
+  }
+
+  if(end - space > 0xffff) {
+    return 0;
+  }
+
+  *key = space;
+  *keylen = (uint16_t) (end - space);
+  memcpy(data, &value, sizeof(value));
+
+  return 1;
+}
+
+pytt_t *pytt_load_text(const char	*path,
+		       unsigned int	 bucket_bits,
+		       size_t		 data_size,
+		       pytt_parse_f	 parse,
+		       void		*arg,
+		       int		 threads,
+		       pytt_load_stats_t *stats)
+{
+  double start = now_seconds();
+  struct stat st;
+  load_chunk_t *chunks;
+  pthread_t *tids;
+  const char *map;
+  pytt_t *ht;
+  size_t entries = 0;
+  size_t lines = 0;
+  int fd, t;
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    return NULL;
+  }
+
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  if(! parse) {
+    parse = pytt_parse_int_word;
+  }
+
+  if(threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (int) cpus : 1;
+  }
+
+  if(! st.st_size) {
+    close(fd);
+    ht = pytt_create(bucket_bits ? bucket_bits : 4, data_size);
+    if(stats) {
+      memset(stats, 0, sizeof(*stats));
+    }
+    return ht;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) {
+    return NULL;
+  }
+
+  posix_madvise((void *) map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+  if(! bucket_bits) {
+    /* One bucket per line, rounded up to a power of two. */
+    size_t n = count_lines(map, map + st.st_size) + 1;
+    bucket_bits = 4;
+    while(((size_t) 1 << bucket_bits) < n) {
+      ++bucket_bits;
+    }
+  }
+
+  ht = pytt_create(bucket_bits, data_size);
+
+  /* Don't bother with threads for tiny files. */
+  if((size_t) st.st_size < (size_t) threads * 65536) {
+    threads = 1;
+  }
+
+  chunks = calloc(threads, sizeof(load_chunk_t));
+  tids = calloc(threads, sizeof(pthread_t));
+
+  for(t = 0; t != threads; ++t) {
+    const char *begin = t ? chunks[t - 1].end : map;
+    const char *end = map + (st.st_size * (t + 1)) / threads;
+
+    if(end < begin) {
+      end = begin;
+    }
+
+    /* Move the split to just after the next newline. */
+    if(t != threads - 1 && end < map + st.st_size) {
+      const char *eol = memchr(end, '\n', map + st.st_size - end);
+      end = eol ? eol + 1 : map + st.st_size;
+    }
+
+    chunks[t].ht    = ht;
+    chunks[t].begin = begin;
+    chunks[t].end   = end;
+    chunks[t].parse = parse;
+    chunks[t].arg   = arg;
+  }
+
+  for(t = 1; t < threads; ++t) {
+    /* If we can't have the thread, the chunk is parsed in this one. */
+    chunks[t].threaded = ! pthread_create(&tids[t], NULL, parse_chunk, &chunks[t]);
+  }
+
+  parse_chunk(&chunks[0]);
+
+  for(t = 0; t != threads; ++t) {
+    load_chunk_t *chunk = &chunks[t];
+    size_t mask = pytt_get_bucket_count(ht) - 1;
+    size_t i;
+
+    if(chunk->threaded) {
+      pthread_join(tids[t], NULL);
+    } else if(t) {
+      parse_chunk(chunk);
+    }
+
+    for(i = 0; i != chunk->count; ++i) {
+      load_record_t *rec = &chunk->records[i];
+      pytt_entry_t *ent;
+
+#ifdef __GNUC__
+      if(i + PYTT_LOAD_PREFETCH < chunk->count) {
+	__builtin_prefetch(&ht->buckets[chunk->records[i + PYTT_LOAD_PREFETCH].hash & mask]);
+      }
+#else
+      (void) mask;
+#endif
+
+      ent = pytt_entry_create_hashed(ht, rec->hash, rec->key, rec->keylen);
+      memcpy(ent->data, chunk->data + i * data_size, data_size);
+    }
+
+    entries += chunk->count;
+    lines += chunk->lines;
+    free(chunk->records);
+    free(chunk->data);
+  }
+
+  munmap((void *) map, st.st_size);
+  free(chunks);
+  free(tids);
+
+  if(stats) {
+    stats->bytes      = st.st_size;
+    stats->lines      = lines;
+    stats->records    = entries;
+    stats->threads    = threads;
+    stats->seconds    = now_seconds() - start;
+    stats->mb_per_sec = stats->seconds > 0 ? st.st_size / stats->seconds / 1e6 : 0;
+  }
+
+  return ht;
+}
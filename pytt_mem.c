@@ -0,0 +1,112 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include "pytt_mem.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define PYTT_HAVE_MMAP
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#ifdef PYTT_HAVE_MMAP
+
+static void bind_node(void *p, size_t size, int numa_node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  /* Straight to the system call, so that we don't need libnuma. */
+  unsigned long mask[4] = { 0, 0, 0, 0 };
+  const int mpol_bind = 2;
+
+  if(numa_node < 0 || numa_node >= (int) (sizeof(mask) * 8)) {
+    return;
+  }
+
+  mask[numa_node / (sizeof(unsigned long) * 8)] |= 1UL << (numa_node % (sizeof(unsigned long) * 8));
+  syscall(SYS_mbind, p, size, mpol_bind, mask, sizeof(mask) * 8 + 1, 0);
+#else
+  (void) p;
+  (void) size;
+  (void) numa_node;
+#endif
+}
+
+void *pytt_pages_alloc(size_t size, int huge, int numa_node)
+{
+  void *p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  /* Explicit huge pages only exist if the administrator reserved some. */
+  if(huge && !(size & (PYTT_HUGE_PAGE_SIZE - 1))) {
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+#endif
+
+  if(p == MAP_FAILED) {
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) {
+      return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if(huge) {
+      madvise(p, size, MADV_HUGEPAGE);
+    }
+#endif
+  }
+
+  /* Nothing has touched the pages yet, so they all land on the node. */
+  bind_node(p, size, numa_node);
+
+  return p;
+}
+
+void pytt_pages_free(void *p, size_t size)
+{
+  if(p) {
+    munmap(p, size);
+  }
+}
+
+void pytt_pages_release(void *p, size_t size)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  size_t mask = page > 0 ? (size_t) page - 1 : 4095;
+  size_t start = ((size_t) p + mask) & ~mask;
+  size_t end = ((size_t) p + size) & ~mask;
+
+  /* Fails harmlessly on explicit huge pages unless they line up. */
+  if(end > start) {
+    madvise((void *) start, end - start, MADV_DONTNEED);
+  }
+}
+
+#else
+
+void *pytt_pages_alloc(size_t size, int huge, int numa_node)
+{
+  (void) huge;
+  (void) numa_node;
+  return calloc(1, size);
+}
+
+void pytt_pages_free(void *p, size_t size)
+{
+  (void) size;
+  free(p);
+}
+
+void pytt_pages_release(void *p, size_t size)
+{
+  (void) p;
+  (void) size;
+}
+
+#endif
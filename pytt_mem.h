@@ -0,0 +1,22 @@
+#ifndef PYTT_MEM_H
+#define PYTT_MEM_H
+
+/* Page level memory for tables created with PYTT_HUGE_PAGES or bound to
+ * a NUMA node. Not part of the public interface. */
+
+#include <stddef.h>
+
+#define PYTT_HUGE_PAGE_SIZE   ((size_t) 2 << 20)
+
+/** Map size bytes of zeroed memory, backed by huge pages if huge is set and
+ *  bound to numa_node if it is not negative. Falls back to transparent huge
+ *  pages, then to normal pages, then to calloc where mmap isn't available. */
+extern void *pytt_pages_alloc(size_t size, int huge, int numa_node);
+/** Release memory from pytt_pages_alloc. size must be the same. */
+extern void  pytt_pages_free(void *p, size_t size);
+/** Give the whole pages inside size bytes at p back to the system. They
+ *  stay mapped but their contents are lost. Works on any writable memory,
+ *  not just memory from pytt_pages_alloc. */
+extern void  pytt_pages_release(void *p, size_t size);
+
+#endif /* PYTT_MEM_H */
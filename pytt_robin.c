@@ -0,0 +1,272 @@
+/* pytt_robin_create is defined here, not wrapped. */
+#define PYTT_BUILDING_LIBRARY
+
+#include <stdlib.h>
+#include <string.h>
+#include "pytt_robin.h"
+#include "pytt_mem.h"
+
+#define PYTT_ROBIN_DEFAULT_LOAD  90
+
+static size_t slot_count(unsigned int slot_bits)
+{
+  return (size_t) 1 << slot_bits;
+}
+
+static pytt_hash_t entry_hash(pytt_robin_t *ht, pytt_entry_t *ent)
+{
+  return pytt_hash_seeded(ht->hash_initializer, ent->data + ht->data_size, ent->hdr.keylen);
+}
+
+/* Puts ent in slots, which must have a free one, displacing entries that
+ * are closer to home than the one being carried. */
+static void place(pytt_robin_slot_t *slots, unsigned int slot_bits,
+		  pytt_entry_t *ent, pytt_hash_t hash)
+{
+  size_t mask = slot_count(slot_bits) - 1;
+  size_t i = (size_t) hash & mask;
+  pytt_robin_slot_t carry;
+
+  carry.ent = ent;
+  carry.tag = (uint32_t) (hash >> 32);
+  carry.dist = 1;
+
+  for(;;) {
+    pytt_robin_slot_t *s = &slots[i];
+
+    if(! s->dist) {
+      *s = carry;
+      return;
+    }
+
+    if(s->dist < carry.dist) {
+      pytt_robin_slot_t tmp = *s;
+      *s = carry;
+      carry = tmp;
+    }
+
+    ++carry.dist;
+    i = (i + 1) & mask;
+  }
+}
+
+/* Rebuilds the slot array at twice the size from the list of all entries. */
+static void grow(pytt_robin_t *ht)
+{
+  unsigned int slot_bits = ht->slot_bits + 1;
+  size_t size = slot_count(slot_bits) * sizeof(pytt_robin_slot_t);
+  pytt_robin_slot_t *slots = pytt_pages_alloc(size, 0, -1);
+  pytt_entry_t *ent;
+
+  for(ent = ht->first; ent; ent = ent->hdr.next) {
+    place(slots, slot_bits, ent, entry_hash(ht, ent));
+  }
+
+  pytt_pages_free(ht->slots, slot_count(ht->slot_bits) * sizeof(pytt_robin_slot_t));
+  ht->slots = slots;
+  ht->slot_bits = slot_bits;
+}
+
+pytt_robin_t *pytt_robin_create(unsigned int slot_bits, size_t data_size)
+{
+  return pytt_robin_create_custom(slot_bits, data_size, &malloc, &free,
+				  PYTT_DEFAULT_HASH_INITIALIZER, 0);
+}
+
+pytt_robin_t *pytt_robin_create_custom(unsigned int	  slot_bits,
+				       size_t		  data_size,
+				       pytt_allocator_f	  alloc,
+				       pytt_deallocator_f dealloc,
+				       uint32_t		  hash_initializer,
+				       unsigned int	  max_load)
+{
+  pytt_robin_t *ht = malloc(sizeof(pytt_robin_t));
+
+  memset(ht, 0, sizeof(pytt_robin_t));
+
+  if(! max_load || max_load > 99) {
+    max_load = PYTT_ROBIN_DEFAULT_LOAD;
+  }
+
+  ht->alloc            = alloc ? alloc : malloc;
+  ht->dealloc          = dealloc ? dealloc : free;
+  ht->data_size        = data_size;
+  ht->slot_bits        = slot_bits;
+  ht->hash_initializer = hash_initializer;
+  ht->max_load         = max_load;
+  ht->first            = NULL;
+  ht->slots            = pytt_pages_alloc(slot_count(slot_bits) * sizeof(pytt_robin_slot_t), 0, -1);
+
+  return ht;
+}
+
+void pytt_robin_destroy(pytt_robin_t *ht)
+{
+  pytt_entry_t *ent = ht->first;
+
+  while(ent) {
+    pytt_entry_t *next = ent->hdr.next;
+    if(ht->remove_callback) {
+      ht->remove_callback(ent);
+    }
+
+    ht->dealloc(ent);
+    ent = next;
+  }
+
+  pytt_pages_free(ht->slots, slot_count(ht->slot_bits) * sizeof(pytt_robin_slot_t));
+  free(ht);
+}
+
+void *pytt_robin_entry_get_key_ptr(pytt_robin_t *ht, pytt_entry_t *ent)
+{
+  return ent->data + ht->data_size;
+}
+
+/* Returns the slot holding the key, or NULL. Probing stops at the first
+ * slot whose entry is closer to home than the key would be by then, since
+ * an insert would have put the key there. */
+static pytt_robin_slot_t *slot_find(pytt_robin_t *ht, pytt_hash_t hash,
+				    const void *key, uint16_t keylen)
+{
+  size_t mask = slot_count(ht->slot_bits) - 1;
+  size_t i = (size_t) hash & mask;
+  uint32_t tag = (uint32_t) (hash >> 32);
+  uint32_t dist;
+
+  for(dist = 1; ; ++dist) {
+    pytt_robin_slot_t *s = &ht->slots[i];
+
+    if(s->dist < dist) {
+      return NULL;
+    }
+
+    if(s->tag == tag && s->ent->hdr.keylen == keylen
+       && !memcmp(s->ent->data + ht->data_size, key, keylen)) {
+      return s;
+    }
+
+    i = (i + 1) & mask;
+  }
+}
+
+pytt_entry_t *pytt_robin_entry_get_hashed(pytt_robin_t *ht, pytt_hash_t hash,
+					  const void *key, uint16_t keylen)
+{
+  pytt_robin_slot_t *s = slot_find(ht, hash, key, keylen);
+
+  return s ? s->ent : NULL;
+}
+
+pytt_entry_t *pytt_robin_entry_get(pytt_robin_t *ht, const void *key, uint16_t keylen)
+{
+  return pytt_robin_entry_get_hashed(ht, pytt_hash_seeded(ht->hash_initializer, key, keylen),
+				     key, keylen);
+}
+
+pytt_entry_t *pytt_robin_entry_create_hashed(pytt_robin_t *ht, pytt_hash_t hash,
+					     const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_robin_entry_get_hashed(ht, hash, key, keylen);
+
+  if(ent) {
+    return ent;
+  }
+
+  /* Always keeps at least one slot free, which ends every probe. */
+  if((ht->count + 1) * 100 > slot_count(ht->slot_bits) * ht->max_load
+     || ht->count + 1 >= slot_count(ht->slot_bits)) {
+    grow(ht);
+  }
+
+  ent = ht->alloc(sizeof(pytt_entry_t) + ht->data_size + keylen);
+  memcpy(ent->data + ht->data_size, key, keylen);
+  ent->hdr.keylen = keylen;
+  ent->hdr.flags = 0;
+  ent->hdr.prev = NULL;
+  ent->hdr.next = ht->first;
+  if(ht->first) {
+    ht->first->hdr.prev = ent;
+  }
+  ht->first = ent;
+  ++ht->count;
+
+  place(ht->slots, ht->slot_bits, ent, hash);
+
+  if(ht->create_callback) {
+    ht->create_callback(ent);
+  }
+
+  return ent;
+}
+
+pytt_entry_t *pytt_robin_entry_create(pytt_robin_t *ht, const void *key, uint16_t keylen)
+{
+  return pytt_robin_entry_create_hashed(ht, pytt_hash_seeded(ht->hash_initializer, key, keylen),
+					key, keylen);
+}
+
+void pytt_robin_entry_remove(pytt_robin_t *ht, const void *key, uint16_t keylen)
+{
+  pytt_entry_t *ent = pytt_robin_entry_get(ht, key, keylen);
+
+  if(ent) {
+    pytt_robin_entry_destroy(ht, ent);
+  }
+}
+
+void pytt_robin_entry_destroy(pytt_robin_t *ht, pytt_entry_t *ent)
+{
+  size_t mask = slot_count(ht->slot_bits) - 1;
+  size_t i = (size_t) entry_hash(ht, ent) & mask;
+  size_t next;
+
+  while(ht->slots[i].ent != ent) {
+    i = (i + 1) & mask;
+  }
+
+  /* Backward shift: pull every following entry that isn't already at
+   * home one slot closer to it, so no tombstone is needed. */
+  for(next = (i + 1) & mask; ht->slots[next].dist > 1; next = (next + 1) & mask) {
+    ht->slots[i] = ht->slots[next];
+    --ht->slots[i].dist;
+    i = next;
+  }
+
+  memset(&ht->slots[i], 0, sizeof(pytt_robin_slot_t));
+
+  if(ht->remove_callback) {
+    ht->remove_callback(ent);
+  }
+
+  if(ent->hdr.prev) {
+    ent->hdr.prev->hdr.next = ent->hdr.next;
+  } else {
+    ht->first = ent->hdr.next;
+  }
+
+  if(ent->hdr.next) {
+    ent->hdr.next->hdr.prev = ent->hdr.prev;
+  }
+
+  --ht->count;
+  ht->dealloc(ent);
+}
+
+void pytt_robin_probe_stats(pytt_robin_t *ht, unsigned int *longest, double *mean)
+{
+  size_t n = slot_count(ht->slot_bits);
+  uint64_t total = 0;
+  size_t i;
+
+  *longest = 0;
+  for(i = 0; i != n; ++i) {
+    uint32_t dist = ht->slots[i].dist;
+    if(dist > *longest) {
+      *longest = dist;
+    }
+    total += dist;
+  }
+
+  *mean = ht->count ? (double) total / (double) ht->count : 0;
+}
@@ -0,0 +1,98 @@
+/* Pytt - A simple hash table in C.
+ *
+ * Robin Hood open addressing backend.
+ *
+ * Entries live in a flat array of slots and are found by linear probing
+ * from their home slot. On insert, an entry that has probed further than
+ * the resident of a slot takes that slot and the resident moves on, which
+ * keeps probe lengths short and even at load factors of 0.9 and above.
+ * Removal shifts the following entries back one slot instead of leaving
+ * a tombstone, so tables that see many removals stay as fast as fresh ones.
+ *
+ * Entries are laid out exactly like pytt_entry_t ones, with the key at
+ * the end of the data, so PYTT_HDR structs work unchanged. hdr.prev and
+ * hdr.next link all entries for iteration starting at ->first, and hdr.flags
+ * is unused. Hashes are the ones from pytt_hash_seeded, so a hash can be
+ * shared with pytt tables created with the same initializer.
+ */
+
+#ifndef PYTT_ROBIN_H
+#define PYTT_ROBIN_H
+
+#include "pytt.h"
+
+typedef struct pytt_robin_slot_t
+{
+  pytt_entry_t  *ent;
+  /** The high half of the hash, to skip most key comparisons. */
+  uint32_t       tag;
+  /** 1 + distance from the home slot, or 0 if the slot is empty. */
+  uint32_t       dist;
+} pytt_robin_slot_t;
+
+typedef struct pytt_robin_t
+{
+  uint16_t       slot_bits;
+  uint16_t       flags;
+  uint32_t       hash_initializer;
+  size_t         data_size;
+  size_t         count;
+  /** Grow when count would exceed this many percent of the slots. */
+  unsigned int   max_load;
+
+  /** These get called to initialize and free data in entries. */
+  void         (*create_callback)(pytt_entry_t *ent);
+  void         (*remove_callback)(pytt_entry_t *ent);
+
+  /** Memory management functions used when allocating entries. */
+  pytt_allocator_f alloc;
+  pytt_deallocator_f dealloc;
+
+  /** The first entry in the linked list. */
+  pytt_entry_t  *first;
+  /** 1 << slot_bits slots. */
+  pytt_robin_slot_t *slots;
+} pytt_robin_t;
+
+/** Create a new Robin Hood table. Uses malloc and free for entries. */
+extern pytt_robin_t  *pytt_robin_create(unsigned int slot_bits, size_t data_size);
+/** Create a new Robin Hood table using custom parameters. max_load is a
+ * percentage, 0 for the default of 90. */
+extern pytt_robin_t  *pytt_robin_create_custom(unsigned int	  slot_bits,
+					       size_t		  data_size,
+					       pytt_allocator_f	  alloc,
+					       pytt_deallocator_f dealloc,
+					       uint32_t		  hash_initializer,
+					       unsigned int	  max_load);
+#ifndef PYTT_BUILDING_LIBRARY
+#define pytt_robin_create(slot_bits, data_size)					\
+  PYTT_CHECKED_CREATE(pytt_robin_create(slot_bits, data_size))
+#define pytt_robin_create_custom(slot_bits, data_size, alloc, dealloc, hash_initializer, max_load) \
+  PYTT_CHECKED_CREATE(pytt_robin_create_custom(slot_bits, data_size, alloc, dealloc,	\
+					       hash_initializer, max_load))
+#endif
+/** Destroy a Robin Hood table and all its entries. */
+extern void           pytt_robin_destroy(pytt_robin_t *ht);
+
+/** Create an entry for the key, or return the one that already exists. */
+extern pytt_entry_t  *pytt_robin_entry_create(pytt_robin_t *ht, const void *key, uint16_t keylen);
+/** Get the entry for the key or NULL if it doesn't exist. */
+extern pytt_entry_t  *pytt_robin_entry_get(pytt_robin_t *ht, const void *key, uint16_t keylen);
+/** Destroy the entry for a key. */
+extern void           pytt_robin_entry_remove(pytt_robin_t *ht, const void *key, uint16_t keylen);
+/** Destroy an entry. */
+extern void           pytt_robin_entry_destroy(pytt_robin_t *ht, pytt_entry_t *ent);
+
+/** Same as the above, with the hash computed by pytt_hash_seeded. */
+extern pytt_entry_t  *pytt_robin_entry_create_hashed(pytt_robin_t *ht, pytt_hash_t hash,
+						     const void *key, uint16_t keylen);
+extern pytt_entry_t  *pytt_robin_entry_get_hashed(pytt_robin_t *ht, pytt_hash_t hash,
+						  const void *key, uint16_t keylen);
+
+/** Get a pointer to the key for an entry. */
+extern void          *pytt_robin_entry_get_key_ptr(pytt_robin_t *ht, pytt_entry_t *ent);
+
+/** The longest probe in the table and the mean over all entries. */
+extern void           pytt_robin_probe_stats(pytt_robin_t *ht, unsigned int *longest, double *mean);
+
+#endif /* PYTT_ROBIN_H */
@@ -0,0 +1,486 @@
+#define _POSIX_C_SOURCE 200809L
+#if defined(__linux__)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pytt_shm.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define PYTT_SHM_MAGIC      0x7079747473686d32ULL   /* "pyttshm2" */
+
+/* Blocks are handed out in steps of PYTT_SHM_ALIGN, and freed ones are
+ * kept on one list per size. Larger ones share the last list. */
+#define PYTT_SHM_ALIGN      16
+#define PYTT_SHM_CLASSES    256
+
+/* How long a reader spins on an odd seq before it checks whether the
+ * writer is still alive. */
+#define PYTT_SHM_SPINS      4096
+
+/* Offsets from the start of the mapping; 0 is the region header, so it
+ * also means "none". */
+typedef uint64_t shm_offset_t;
+
+struct pytt_shm_region_t
+{
+  uint64_t       magic;
+  uint64_t       size;
+  uint64_t       data_size;
+  uint64_t       count;
+  uint64_t       used;          /* End of the entries carved out so far */
+  shm_offset_t   free[PYTT_SHM_CLASSES];
+  uint32_t       bucket_bits;
+  /* Odd while a writer is changing the table. */
+  uint32_t       seq;
+  /* Set once a writer died holding the lock. */
+  uint32_t       torn;
+  pthread_mutex_t lock;
+  shm_offset_t   buckets[];
+};
+
+typedef struct shm_entry_t
+{
+  shm_offset_t   next;
+  uint32_t       tag;           /* The top half of the hash */
+  uint16_t       keylen;
+  uint16_t       pad;
+  /* Data then key, like in pytt_entry_t. */
+  char           data[];
+} shm_entry_t;
+
+/* A block on a free list. */
+typedef struct shm_free_t
+{
+  shm_offset_t   next;
+  uint64_t       size;
+} shm_free_t;
+
+#define SHM_AT(r, off)      ((void *) ((char *) (r) + (off)))
+
+static size_t region_header_size(unsigned int bucket_bits)
+{
+  size_t size = sizeof(struct pytt_shm_region_t) + ((size_t) 1 << bucket_bits) * sizeof(shm_offset_t);
+
+  return (size + PYTT_SHM_ALIGN - 1) & ~(size_t) (PYTT_SHM_ALIGN - 1);
+}
+
+static size_t block_size(size_t data_size, uint16_t keylen)
+{
+  return (sizeof(shm_entry_t) + data_size + keylen + PYTT_SHM_ALIGN - 1)
+    & ~(size_t) (PYTT_SHM_ALIGN - 1);
+}
+
+static size_t block_class(size_t size)
+{
+  size_t cls = size / PYTT_SHM_ALIGN;
+
+  return cls < PYTT_SHM_CLASSES ? cls : PYTT_SHM_CLASSES - 1;
+}
+
+static shm_offset_t block_alloc(struct pytt_shm_region_t *r, size_t size)
+{
+  shm_offset_t *link = &r->free[block_class(size)];
+  shm_offset_t off;
+
+  /* Only the last list mixes sizes, and it takes an exact fit. */
+  while(*link) {
+    shm_free_t *f = SHM_AT(r, *link);
+
+    if(f->size == size) {
+      off = *link;
+      *link = f->next;
+      return off;
+    }
+    link = &f->next;
+  }
+
+  if(r->size - r->used < size) {
+    return 0;
+  }
+
+  off = r->used;
+  r->used += size;
+
+  return off;
+}
+
+static void block_free(struct pytt_shm_region_t *r, shm_offset_t off, size_t size)
+{
+  shm_free_t *f = SHM_AT(r, off);
+  size_t cls = block_class(size);
+
+  f->size = size;
+  f->next = r->free[cls];
+  r->free[cls] = off;
+}
+
+/* The lock was held by a process that died, maybe halfway through a
+ * change. Changes only ever link or unlink an entry with one store, so
+ * the chains are whole, but a block may have leaked, count may be off by
+ * one and the data of the entry being written may be half old, half new.
+ * Counts the entries again, marks the table torn and makes seq even so
+ * readers go on. Called with the lock held. */
+static void recover(struct pytt_shm_region_t *r)
+{
+  size_t entry_size = sizeof(shm_entry_t) + r->data_size;
+  size_t limit = r->size > entry_size ? r->size - entry_size : 0;
+  size_t steps = 0, max_steps = r->size / PYTT_SHM_ALIGN;
+  uint64_t bucket, count = 0;
+  shm_offset_t off;
+
+  for(bucket = 0; bucket != (uint64_t) 1 << r->bucket_bits; ++bucket) {
+    for(off = r->buckets[bucket]; off && off <= limit && steps < max_steps; ++steps) {
+      ++count;
+      off = ((shm_entry_t *) SHM_AT(r, off))->next;
+    }
+  }
+
+  r->count = count;
+  r->torn = 1;
+  if(r->seq & 1) {
+    __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+  }
+
+  pthread_mutex_consistent(&r->lock);
+}
+
+/* Takes the lock, putting the table right first if its last holder died.
+ * Returns 0, or -1 if the lock is gone for good. */
+static int write_lock(struct pytt_shm_region_t *r)
+{
+  int rc = pthread_mutex_lock(&r->lock);
+
+  if(rc == EOWNERDEAD) {
+    recover(r);
+    rc = 0;
+  }
+
+  return rc ? -1 : 0;
+}
+
+/* Writers bump seq to odd before they change anything and back to even
+ * after. A reader that sees the same even value before and after its
+ * lookup knows no writer got in its way. */
+static int write_begin(struct pytt_shm_region_t *r)
+{
+  if(write_lock(r)) {
+    return -1;
+  }
+  __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  return 0;
+}
+
+static void write_end(struct pytt_shm_region_t *r)
+{
+  __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&r->lock);
+}
+
+/* Waits for an even seq and stores it in *seq. A writer that stays odd
+ * for long may have died, so after a while the reader tries the lock:
+ * if it gets it from a dead writer it puts the table right itself, and
+ * if a live writer has it, it yields. Returns -1 if the lock is gone for
+ * good, otherwise 0. */
+static int read_begin(struct pytt_shm_region_t *r, uint32_t *seq)
+{
+  int spins = 0, rc;
+
+  while((*seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE)) & 1) {
+    if(++spins < PYTT_SHM_SPINS) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      __builtin_ia32_pause();
+#endif
+      continue;
+    }
+
+    rc = pthread_mutex_trylock(&r->lock);
+    if(rc == EOWNERDEAD) {
+      recover(r);
+      pthread_mutex_unlock(&r->lock);
+    } else if(rc == 0) {
+      pthread_mutex_unlock(&r->lock);
+    } else if(rc == EBUSY) {
+      sched_yield();
+    } else {
+      return -1;
+    }
+    spins = 0;
+  }
+
+  return 0;
+}
+
+static int read_retry(struct pytt_shm_region_t *r, uint32_t seq)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&r->seq, __ATOMIC_RELAXED) != seq;
+}
+
+static pytt_shm_t *shm_attach(void *map, size_t size)
+{
+  struct pytt_shm_region_t *r = map;
+  pytt_shm_t *shm = malloc(sizeof(pytt_shm_t));
+
+  shm->region = r;
+  shm->size = size;
+  shm->data_size = r->data_size;
+  shm->bucket_bits = (uint16_t) r->bucket_bits;
+
+  return shm;
+}
+
+pytt_shm_t *pytt_shm_create(const char *name, unsigned int bucket_bits,
+			    size_t data_size, size_t size)
+{
+  struct pytt_shm_region_t *r;
+  pthread_mutexattr_t attr;
+  void *map;
+  int fd = -1;
+
+  if(bucket_bits > 40 || size < region_header_size(bucket_bits)) {
+    return NULL;
+  }
+
+  if(name) {
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0) {
+      return NULL;
+    }
+    if(ftruncate(fd, size)) {
+      close(fd);
+      shm_unlink(name);
+      return NULL;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  } else {
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  }
+
+  if(map == MAP_FAILED) {
+    if(name) {
+      shm_unlink(name);
+    }
+    return NULL;
+  }
+
+  /* Fresh shared memory is zeroed, so the buckets are already empty. */
+  r = map;
+  r->size = size;
+  r->data_size = data_size;
+  r->used = region_header_size(bucket_bits);
+  r->bucket_bits = bucket_bits;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&r->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  /* Whoever opens the table next only looks at it once this is set. */
+  __atomic_store_n(&r->magic, PYTT_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  return shm_attach(map, size);
+}
+
+pytt_shm_t *pytt_shm_open(const char *name)
+{
+  struct pytt_shm_region_t *r;
+  struct stat st;
+  void *map;
+  int fd = shm_open(name, O_RDWR, 0);
+
+  if(fd < 0) {
+    return NULL;
+  }
+
+  if(fstat(fd, &st) || (size_t) st.st_size < sizeof(struct pytt_shm_region_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) {
+    return NULL;
+  }
+
+  r = map;
+  if(__atomic_load_n(&r->magic, __ATOMIC_ACQUIRE) != PYTT_SHM_MAGIC
+     || r->size != (uint64_t) st.st_size
+     || r->bucket_bits > 40
+     || region_header_size(r->bucket_bits) > r->size) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  return shm_attach(map, st.st_size);
+}
+
+void pytt_shm_close(pytt_shm_t *shm)
+{
+  munmap(shm->region, shm->size);
+  free(shm);
+}
+
+int pytt_shm_unlink(const char *name)
+{
+  return shm_unlink(name);
+}
+
+/* The link that points to the entry for the key, or to the 0 at the end
+ * of its bucket. Only for writers, who hold the lock. */
+static shm_offset_t *find_link(pytt_shm_t *shm, pytt_hash_t hash,
+			       const void *key, uint16_t keylen)
+{
+  struct pytt_shm_region_t *r = shm->region;
+  shm_offset_t *link = &r->buckets[hash & (((pytt_hash_t) 1 << shm->bucket_bits) - 1)];
+  uint32_t tag = (uint32_t) (hash >> 32);
+
+  while(*link) {
+    shm_entry_t *ent = SHM_AT(r, *link);
+
+    if(ent->tag == tag && ent->keylen == keylen
+       && !memcmp(ent->data + shm->data_size, key, keylen)) {
+      break;
+    }
+    link = &ent->next;
+  }
+
+  return link;
+}
+
+int pytt_shm_put(pytt_shm_t *shm, const void *key, uint16_t keylen, const void *data)
+{
+  struct pytt_shm_region_t *r = shm->region;
+  pytt_hash_t hash = pytt_hash_seeded(PYTT_DEFAULT_HASH_INITIALIZER, key, keylen);
+  shm_offset_t *link, off;
+  shm_entry_t *ent;
+
+  if(write_begin(r)) {
+    return -1;
+  }
+
+  link = find_link(shm, hash, key, keylen);
+  if(*link) {
+    ent = SHM_AT(r, *link);
+    memcpy(ent->data, data, shm->data_size);
+    write_end(r);
+    return 0;
+  }
+
+  off = block_alloc(r, block_size(shm->data_size, keylen));
+  if(! off) {
+    write_end(r);
+    return -1;
+  }
+
+  ent = SHM_AT(r, off);
+  ent->next = 0;
+  ent->tag = (uint32_t) (hash >> 32);
+  ent->keylen = keylen;
+  ent->pad = 0;
+  memcpy(ent->data, data, shm->data_size);
+  memcpy(ent->data + shm->data_size, key, keylen);
+
+  __atomic_store_n(link, off, __ATOMIC_RELAXED);
+  ++r->count;
+
+  write_end(r);
+
+  return 0;
+}
+
+int pytt_shm_get(pytt_shm_t *shm, const void *key, uint16_t keylen, void *data)
+{
+  struct pytt_shm_region_t *r = shm->region;
+  pytt_hash_t hash = pytt_hash_seeded(PYTT_DEFAULT_HASH_INITIALIZER, key, keylen);
+  shm_offset_t *bucket = &r->buckets[hash & (((pytt_hash_t) 1 << shm->bucket_bits) - 1)];
+  uint32_t tag = (uint32_t) (hash >> 32);
+  size_t entry_size = sizeof(shm_entry_t) + shm->data_size + keylen;
+  size_t limit = shm->size > entry_size ? shm->size - entry_size : 0;
+  size_t steps, max_steps = shm->size / PYTT_SHM_ALIGN;
+  uint32_t seq;
+  int found;
+
+  for(;;) {
+    shm_offset_t off;
+
+    if(read_begin(r, &seq)) {
+      return -1;
+    }
+    found = 0;
+    steps = 0;
+
+    /* A writer may change anything under our feet, so every offset is
+     * checked before it is followed. If one is off, seq has moved on and
+     * the lookup starts again. */
+    off = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    while(off && off <= limit && ++steps < max_steps) {
+      shm_entry_t *ent = SHM_AT(r, off);
+
+      if(ent->tag == tag && ent->keylen == keylen
+	 && !memcmp(ent->data + shm->data_size, key, keylen)) {
+	memcpy(data, ent->data, shm->data_size);
+	found = 1;
+	break;
+      }
+
+      off = __atomic_load_n(&ent->next, __ATOMIC_RELAXED);
+    }
+
+    if(! read_retry(r, seq)) {
+      return found;
+    }
+  }
+}
+
+int pytt_shm_remove(pytt_shm_t *shm, const void *key, uint16_t keylen)
+{
+  struct pytt_shm_region_t *r = shm->region;
+  pytt_hash_t hash = pytt_hash_seeded(PYTT_DEFAULT_HASH_INITIALIZER, key, keylen);
+  shm_offset_t *link, off;
+  shm_entry_t *ent;
+
+  if(write_begin(r)) {
+    return -1;
+  }
+
+  link = find_link(shm, hash, key, keylen);
+  off = *link;
+  if(off) {
+    ent = SHM_AT(r, off);
+    __atomic_store_n(link, ent->next, __ATOMIC_RELAXED);
+    block_free(r, off, block_size(shm->data_size, keylen));
+    --r->count;
+  }
+
+  write_end(r);
+
+  return off != 0;
+}
+
+size_t pytt_shm_count(pytt_shm_t *shm)
+{
+  return __atomic_load_n(&shm->region->count, __ATOMIC_RELAXED);
+}
+
+int pytt_shm_torn(pytt_shm_t *shm)
+{
+  return (int) __atomic_load_n(&shm->region->torn, __ATOMIC_RELAXED);
+}
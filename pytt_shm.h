@@ -0,0 +1,77 @@
+/* Pytt - A simple hash table in C.
+ *
+ * Tables in shared memory, for processes that all want the same table.
+ *
+ * The buckets and entries live in one mapping, either a named POSIX
+ * shared memory object that any process can open, or an anonymous one
+ * that processes forked after pytt_shm_create inherit. Entries link by
+ * offset from the start of the mapping, so it may sit at a different
+ * address in each process. Its size is fixed when it is created, and
+ * entries come out of it with their own free lists.
+ *
+ * Writers take a process-shared mutex, so there may be any number, but
+ * the table is built for one writer and many readers. Readers take no
+ * lock at all: every change is bracketed by a sequence counter, and a
+ * lookup that overlaps one starts again. That's why pytt_shm_get copies
+ * the data out instead of returning a pointer into the mapping.
+ *
+ * The mutex is robust. If a writer dies holding it, the next process to
+ * write, or a reader that has waited long enough, counts the entries
+ * again and lets the others go on. The entry it was writing may be left
+ * with half old, half new data, which pytt_shm_torn tells about.
+ *
+ * Hashes are the ones from pytt_hash_seeded with
+ * PYTT_DEFAULT_HASH_INITIALIZER, the same in every process.
+ */
+
+#ifndef PYTT_SHM_H
+#define PYTT_SHM_H
+
+#include "pytt.h"
+
+typedef struct pytt_shm_t
+{
+  /** The mapping, laid out as a struct pytt_shm_region_t. */
+  struct pytt_shm_region_t *region;
+  size_t         size;
+  size_t         data_size;
+  uint16_t       bucket_bits;
+} pytt_shm_t;
+
+/** Create a table of 2^bucket_bits buckets in size bytes of shared
+ *  memory, which entries get what the buckets leave of. name is a POSIX
+ *  shared memory name ("/something") that must not exist yet, or NULL
+ *  for memory shared only with child processes. Returns NULL if the
+ *  memory can't be had or size is too small for the buckets. */
+extern pytt_shm_t   *pytt_shm_create(const char *name, unsigned int bucket_bits,
+				     size_t data_size, size_t size);
+/** Open a table another process created under name. Returns NULL if it
+ *  doesn't exist or isn't a table. */
+extern pytt_shm_t   *pytt_shm_open(const char *name);
+/** Unmap a table. It lives on until every process has closed it and
+ *  its name is unlinked. */
+extern void          pytt_shm_close(pytt_shm_t *shm);
+/** Remove the name of a table, like shm_unlink. */
+extern int           pytt_shm_unlink(const char *name);
+
+/** Set the data for a key, adding its entry if it isn't there. Returns
+ *  -1 if the table has no room left or its lock can't be had, otherwise
+ *  0. */
+extern int           pytt_shm_put(pytt_shm_t *shm, const void *key, uint16_t keylen,
+				  const void *data);
+/** Copy the data for a key into data. Returns 0 if the key isn't in the
+ *  table, -1 if its lock can't be had, otherwise 1. Never blocks on
+ *  writers, but retries while one is changing the table. */
+extern int           pytt_shm_get(pytt_shm_t *shm, const void *key, uint16_t keylen,
+				  void *data);
+/** Remove the entry for a key. Returns 0 if it wasn't there, -1 if the
+ *  lock can't be had, otherwise 1. */
+extern int           pytt_shm_remove(pytt_shm_t *shm, const void *key, uint16_t keylen);
+
+/** Number of entries in the table. */
+extern size_t        pytt_shm_count(pytt_shm_t *shm);
+/** Returns 1 if a writer ever died in the middle of changing the table,
+ *  so that one entry may hold torn data, otherwise 0. */
+extern int           pytt_shm_torn(pytt_shm_t *shm);
+
+#endif /* PYTT_SHM_H */
@@ -0,0 +1,410 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pytt.h"
+
+/*
+   Timings of the basic table operations, repeated enough to tell a real
+   slowdown from noise, and compared against a stored baseline.
+
+   Each run fills a fresh chained table with pytt_entry_create, looks
+   every key up again in a random order with pytt_entry_get, walks the
+   entries, and destroys the table with pytt_destroy, timing each phase
+   in ns per key. That is done for 8-byte integer keys and for short
+   strings. A run is thrown away first to warm up.
+
+   Results go to stdout as CSV, one row per workload and operation with
+   the median, a 95% confidence interval for it, and every run's time,
+   so a saved copy serves as a baseline:
+
+     regress_bench > baseline.csv
+     regress_bench -compare baseline.csv
+
+   -compare prints each median next to the baseline's and marks it
+   SLOWER when the runs are slower with a one-sided Mann-Whitney test at
+   p < 0.01 and the median is more than -threshold percent (default 5)
+   above the baseline's, faster in the opposite case. The exit status is
+   1 if anything got slower. -save writes this run's CSV to a file as
+   well, to roll the baseline forward.
+
+   The test only sees the spread between runs of one process, and whole
+   processes can differ by more than that (heap layout, CPU frequency,
+   neighbours). Record the baseline on the machine that compares, and
+   raise -threshold where it is noisy.
+
+   Usage: regress_bench [-runs n] [-keys n] [-threshold percent]
+			[-compare baseline.csv] [-save results.csv]
+*/
+
+#define MAX_RUNS	1000
+#define MAX_ROWS	64
+#define SIGNIFICANT_Z	2.326
+
+enum { CREATE, GET, ITERATE, DESTROY, OPS };
+
+static const char *const op_names[OPS] = { "create", "get", "iterate", "destroy" };
+
+typedef struct workload_t
+{
+  const char    *name;
+  size_t         count;
+  const void   **keys;
+  uint16_t      *keylens;
+  unsigned char *bytes;
+} workload_t;
+
+typedef struct row_t
+{
+  char           workload[32];
+  char           op[32];
+  unsigned long  keys;
+  int            runs;
+  double         median;
+  double         low;
+  double         high;
+  double        *samples;
+} row_t;
+
+static void make_workload(workload_t *w, const char *name, size_t count)
+{
+  uint64_t state = 1;
+  size_t i;
+
+  w->name = name;
+  w->count = count;
+  w->keys = malloc(count * sizeof(void *));
+  w->keylens = malloc(count * sizeof(uint16_t));
+  w->bytes = malloc(count * 16);
+
+  for(i = 0; i != count; ++i) {
+    unsigned char *key = w->bytes + i * 16;
+
+    if(name[0] == 'i') {
+      uint64_t num = bench_rand(&state);
+      memcpy(key, &num, sizeof(num));
+      w->keylens[i] = sizeof(num);
+    } else {
+      w->keylens[i] = (uint16_t) sprintf((char *) key, "key%lu", (unsigned long) i);
+    }
+    w->keys[i] = key;
+  }
+}
+
+static void free_workload(workload_t *w)
+{
+  free(w->keys);
+  free(w->keylens);
+  free(w->bytes);
+}
+
+/* One run of every operation, in ns per key. */
+static void run(const workload_t *w, const size_t *order, double ns[OPS])
+{
+  unsigned int bits = 0;
+  uint64_t found = 0;
+  pytt_entry_t *ent;
+  double start;
+  size_t i;
+  pytt_t *ht;
+
+  while(((size_t) 1 << bits) < w->count) {
+    ++bits;
+  }
+  ht = pytt_create(bits, sizeof(uint64_t));
+
+  start = bench_now();
+  for(i = 0; i != w->count; ++i) {
+    pytt_entry_create(ht, w->keys[i], w->keylens[i]);
+  }
+  ns[CREATE] = bench_now() - start;
+
+  start = bench_now();
+  for(i = 0; i != w->count; ++i) {
+    found += pytt_entry_get(ht, w->keys[order[i]], w->keylens[order[i]]) != NULL;
+  }
+  ns[GET] = bench_now() - start;
+
+  start = bench_now();
+  for(ent = ht->first; ent; ent = ent->hdr.next) {
+    found += ent->hdr.keylen;
+  }
+  ns[ITERATE] = bench_now() - start;
+
+  start = bench_now();
+  pytt_destroy(ht);
+  ns[DESTROY] = bench_now() - start;
+
+  for(i = 0; i != OPS; ++i) {
+    ns[i] *= 1e9 / w->count;
+  }
+
+  bench_sink = found;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/* Median and its 95% confidence interval, from the order statistics
+ * n/2 -+ 1.96 sqrt(n)/2, which holds whatever the distribution. */
+static void summarize(row_t *row)
+{
+  double *sorted = malloc(row->runs * sizeof(double));
+  int n = row->runs, lo, hi;
+
+  memcpy(sorted, row->samples, n * sizeof(double));
+  qsort(sorted, n, sizeof(double), compare_double);
+
+  row->median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  lo = (int) floor(n / 2.0 - 0.98 * sqrt((double) n));
+  hi = (int) ceil(n / 2.0 + 0.98 * sqrt((double) n));
+  row->low = sorted[lo < 0 ? 0 : lo];
+  row->high = sorted[hi > n - 1 ? n - 1 : hi];
+
+  free(sorted);
+}
+
+static void write_rows(FILE *out, const row_t *rows, int count)
+{
+  int r, i;
+
+  fprintf(out, "workload,op,keys,runs,median_ns,ci_low_ns,ci_high_ns,samples_ns\n");
+  for(r = 0; r != count; ++r) {
+    fprintf(out, "%s,%s,%lu,%d,%.3f,%.3f,%.3f,", rows[r].workload, rows[r].op, rows[r].keys,
+	    rows[r].runs, rows[r].median, rows[r].low, rows[r].high);
+    for(i = 0; i != rows[r].runs; ++i) {
+      fprintf(out, "%s%.3f", i ? " " : "", rows[r].samples[i]);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+/* Reads what write_rows wrote. Returns the number of rows, or -1 if the
+ * file can't be opened. */
+static int read_rows(const char *path, row_t *rows)
+{
+  FILE *in = fopen(path, "r");
+  char line[32768];
+  char *p, *end;
+  int count = 0, used, runs;
+  row_t *row;
+
+  if(! in) {
+    return -1;
+  }
+
+  while(count != MAX_ROWS && fgets(line, sizeof(line), in)) {
+    row = &rows[count];
+    if(sscanf(line, "%31[^,],%31[^,],%lu,%d,%lf,%lf,%lf,%n", row->workload, row->op,
+	      &row->keys, &row->runs, &row->median, &row->low, &row->high, &used) != 7
+       || row->runs <= 0 || row->runs > MAX_RUNS) {
+      continue;
+    }
+
+    runs = row->runs;
+    row->samples = malloc(runs * sizeof(double));
+    p = line + used;
+    for(row->runs = 0; row->runs != runs; ++row->runs) {
+      row->samples[row->runs] = strtod(p, &end);
+      if(end == p) {
+	break;
+      }
+      p = end;
+    }
+    if(row->runs) {
+      ++count;
+    } else {
+      free(row->samples);
+    }
+  }
+
+  fclose(in);
+
+  return count;
+}
+
+/* z of the Mann-Whitney U statistic, positive when a tends to be larger
+ * than b. */
+static double mann_whitney_z(const double *a, int na, const double *b, int nb)
+{
+  double u = 0, mean, sd;
+  int i, j;
+
+  for(i = 0; i != na; ++i) {
+    for(j = 0; j != nb; ++j) {
+      u += a[i] > b[j] ? 1 : a[i] == b[j] ? 0.5 : 0;
+    }
+  }
+
+  mean = (double) na * nb / 2;
+  sd = sqrt((double) na * nb * (na + nb + 1) / 12);
+
+  return sd > 0 ? (u - mean) / sd : 0;
+}
+
+/* Prints each row next to its baseline. Returns the number of rows that
+ * got slower. */
+static int compare(const row_t *rows, int count, const row_t *base, int base_count,
+		   double threshold)
+{
+  const row_t *old;
+  const char *verdict;
+  int slower = 0;
+  double z, change;
+  int r, b;
+
+  printf("%-8s %-8s %10s %10s %8s %7s  %s\n",
+	 "workload", "op", "baseline", "median", "change", "z", "");
+
+  for(r = 0; r != count; ++r) {
+    old = NULL;
+    for(b = 0; b != base_count; ++b) {
+      if(! strcmp(base[b].workload, rows[r].workload) && ! strcmp(base[b].op, rows[r].op)
+	 && base[b].keys == rows[r].keys) {
+	old = &base[b];
+      }
+    }
+
+    if(! old) {
+      printf("%-8s %-8s %10s %10.2f %8s %7s  new\n", rows[r].workload, rows[r].op, "-",
+	     rows[r].median, "", "");
+      continue;
+    }
+
+    z = mann_whitney_z(rows[r].samples, rows[r].runs, old->samples, old->runs);
+    change = old->median > 0 ? (rows[r].median / old->median - 1) * 100 : 0;
+
+    verdict = "";
+    if(z > SIGNIFICANT_Z && change > threshold) {
+      verdict = "SLOWER";
+      ++slower;
+    } else if(z < -SIGNIFICANT_Z && change < -threshold) {
+      verdict = "faster";
+    }
+
+    printf("%-8s %-8s %10.2f %10.2f %+7.1f%% %7.2f  %s\n", rows[r].workload, rows[r].op,
+	   old->median, rows[r].median, change, z, verdict);
+  }
+
+  return slower;
+}
+
+int main(int argc, char **argv)
+{
+  const char *const workloads[] = { "ints", "words" };
+  const char *baseline = NULL, *save = NULL;
+  size_t count = (size_t) 1 << 18;
+  double threshold = 5;
+  int runs = 15;
+  row_t rows[MAX_ROWS], base[MAX_ROWS];
+  int nrows = 0, nbase = 0, slower = 0;
+  uint64_t state = 4;
+  double ns[OPS];
+  size_t *order;
+  workload_t w;
+  size_t i, j, t;
+  int arg, wl, r, op;
+  FILE *out;
+
+  for(arg = 1; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    if(! strcmp(argv[arg], "-runs")) {
+      runs = atoi(argv[arg + 1]);
+    } else if(! strcmp(argv[arg], "-keys")) {
+      count = (size_t) atol(argv[arg + 1]);
+    } else if(! strcmp(argv[arg], "-threshold")) {
+      threshold = atof(argv[arg + 1]);
+    } else if(! strcmp(argv[arg], "-compare")) {
+      baseline = argv[arg + 1];
+    } else if(! strcmp(argv[arg], "-save")) {
+      save = argv[arg + 1];
+    } else {
+      break;
+    }
+  }
+
+  if(arg != argc || runs < 2 || runs > MAX_RUNS || count < 1) {
+    fprintf(stderr, "Usage: regress_bench [-runs n] [-keys n] [-threshold percent]\n"
+	    "                     [-compare baseline.csv] [-save results.csv]\n");
+    return 2;
+  }
+
+  if(baseline) {
+    nbase = read_rows(baseline, base);
+    if(nbase < 0) {
+      fprintf(stderr, "Unable to open %s.\n", baseline);
+      return 2;
+    }
+  }
+
+  order = malloc(count * sizeof(size_t));
+
+  for(wl = 0; wl != sizeof(workloads) / sizeof(workloads[0]); ++wl) {
+    make_workload(&w, workloads[wl], count);
+
+    // Lookups go in a random order, so large tables miss the cache.
+    for(i = 0; i != count; ++i) {
+      order[i] = i;
+    }
+    for(i = count - 1; i > 0; --i) {
+      j = bench_rand(&state) % (i + 1);
+      t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+
+    for(op = 0; op != OPS; ++op) {
+      row_t *row = &rows[nrows + op];
+      strcpy(row->workload, w.name);
+      strcpy(row->op, op_names[op]);
+      row->keys = (unsigned long) count;
+      row->runs = runs;
+      row->samples = malloc(runs * sizeof(double));
+    }
+
+    run(&w, order, ns);
+    for(r = 0; r != runs; ++r) {
+      run(&w, order, ns);
+      for(op = 0; op != OPS; ++op) {
+	rows[nrows + op].samples[r] = ns[op];
+      }
+    }
+
+    for(op = 0; op != OPS; ++op) {
+      summarize(&rows[nrows + op]);
+    }
+    nrows += OPS;
+
+    free_workload(&w);
+  }
+
+  if(baseline) {
+    slower = compare(rows, nrows, base, nbase, threshold);
+  } else {
+    write_rows(stdout, rows, nrows);
+  }
+
+  if(save) {
+    out = fopen(save, "w");
+    if(! out) {
+      fprintf(stderr, "Unable to write %s.\n", save);
+    } else {
+      write_rows(out, rows, nrows);
+      fclose(out);
+    }
+  }
+
+  for(r = 0; r != nrows; ++r) {
+    free(rows[r].samples);
+  }
+  for(r = 0; r != nbase; ++r) {
+    free(base[r].samples);
+  }
+  free(order);
+
+  return slower ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+static int callbacks;
+
+static void count_callback(pytt_entry_t *ent)
+{
+  ++callbacks;
+}
+
+static int every_third(pytt_entry_t *ent, void *arg)
+{
+  return ((int_entry_t *) ent)->value % 3 == 0;
+}
+
+static int all(pytt_entry_t *ent, void *arg)
+{
+  return 1;
+}
+
+static int none(pytt_entry_t *ent, void *arg)
+{
+  return 0;
+}
+
+static void fill(pytt_t *ht, int n)
+{
+  int_entry_t *he;
+  char key[32];
+  int i;
+
+  for(i = 0; i != n; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+}
+
+/* Keys below n must all be there, except every step-th one (none for 0),
+ * and the list must hold exactly those and link up both ways. */
+static int check(pytt_t *ht, int n, int step, const char *what)
+{
+  pytt_entry_t *ent, *prev = NULL;
+  int_entry_t *he;
+  char key[32];
+  int i, expected = 0, count = 0;
+
+  for(i = 0; i != n; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_get(ht, key, strlen(key));
+    if((step && i % step == 0) ? (he != NULL) : (! he || he->value != i)) {
+      printf("Wrong result for %s %s\n", key, what);
+      return 1;
+    }
+    expected += !(step && i % step == 0);
+  }
+
+  for(ent = ht->first; ent; prev = ent, ent = ent->hdr.next) {
+    if(ent->hdr.prev != prev) {
+      printf("Broken list %s\n", what);
+      return 1;
+    }
+    ++count;
+  }
+
+  if(count != expected) {
+    printf("%d entries instead of %d %s\n", count, expected, what);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int run(pytt_t *ht, const char *what)
+{
+  int failure = 0;
+  size_t removed;
+
+  fill(ht, 3000);
+  ht->remove_callback = count_callback;
+  callbacks = 0;
+
+  if(pytt_remove_if(ht, none, NULL) != 0) {
+    failure = 1;
+  }
+  failure |= check(ht, 3000, 0, what);
+
+  removed = pytt_remove_if(ht, every_third, NULL);
+  if(removed != 1000 || callbacks != 1000) {
+    printf("Removed %lu %s\n", (unsigned long) removed, what);
+    failure = 1;
+  }
+  failure |= check(ht, 3000, 3, what);
+
+  // The buckets still work for new entries.
+  fill(ht, 3000);
+  failure |= check(ht, 3000, 0, what);
+
+  if(pytt_remove_if(ht, all, NULL) != 3000) {
+    failure = 1;
+  }
+  failure |= check(ht, 3000, 1, what);
+
+  fill(ht, 100);
+  failure |= check(ht, 100, 0, what);
+
+  pytt_destroy(ht);
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  pytt_snapshot_t *snap;
+  pytt_t *ht;
+  char key[32];
+  int failure = 0;
+  int i;
+
+  // Few buckets so they hold long runs of removed and kept entries.
+  failure |= run(pytt_create(6, sizeof(int)), "in a chained table");
+  failure |= run(pytt_create(14, sizeof(int)), "in a roomy table");
+  failure |= run(pytt_create_custom(6, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS),
+		 "in a tagged table");
+  failure |= run(pytt_create_custom(6, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_TTL),
+		 "in a TTL table");
+
+  // A snapshot keeps seeing what was removed.
+  ht = pytt_create(8, sizeof(int));
+  fill(ht, 1000);
+  snap = pytt_snapshot(ht);
+
+  pytt_remove_if(ht, every_third, NULL);
+  failure |= check(ht, 1000, 3, "with a snapshot");
+
+  for(i = 0; i != 1000; ++i) {
+    int_entry_t *he;
+
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_snapshot_get(snap, key, strlen(key));
+    if(! he || he->value != i) {
+      printf("Snapshot lost %s\n", key);
+      failure = 1;
+    }
+  }
+
+  pytt_snapshot_destroy(snap);
+  pytt_destroy(ht);
+
+  printf("Remove if test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
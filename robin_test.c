@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pytt_robin.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+/* Every entry must sit dist - 1 slots past its home slot. */
+static int check_slots(pytt_robin_t *ht)
+{
+  size_t mask = ((size_t) 1 << ht->slot_bits) - 1;
+  size_t i, used = 0;
+
+  for(i = 0; i <= mask; ++i) {
+    pytt_robin_slot_t *s = &ht->slots[i];
+    pytt_hash_t hash;
+
+    if(! s->dist) {
+      continue;
+    }
+
+    ++used;
+    hash = pytt_hash_seeded(ht->hash_initializer, pytt_robin_entry_get_key_ptr(ht, s->ent),
+			    s->ent->hdr.keylen);
+    if((((size_t) hash + s->dist - 1) & mask) != i) {
+      printf("Slot %lu is misplaced\n", (unsigned long) i);
+      return 1;
+    }
+  }
+
+  return used != ht->count;
+}
+
+int main(int argc, char **argv)
+{
+  // Start tiny so that the table has to grow a few times.
+  pytt_robin_t *ht = pytt_robin_create(2, sizeof(int));
+  int_entry_t *he;
+  pytt_entry_t *ent;
+  unsigned int longest, before;
+  double mean;
+  char key[32];
+  int failure = 0;
+  int count;
+  int i, round;
+
+  for(i = 0; i != 100000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_robin_entry_create(ht, key, strlen(key) + 1);
+    he->value = i;
+  }
+
+  // Creating again returns the same entries.
+  for(i = 0; i < 100000; i += 7) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_robin_entry_create(ht, key, strlen(key) + 1);
+    if(he->value != i) {
+      failure = 1;
+    }
+  }
+
+  for(i = 0; i < 100000; i += 2) {
+    sprintf(key, "key%d", i);
+    pytt_robin_entry_remove(ht, key, strlen(key) + 1);
+  }
+
+  for(i = 0; i != 100000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_robin_entry_get(ht, key, strlen(key) + 1);
+    if((i & 1) ? (! he || he->value != i || strcmp(he->key, key)) : he != NULL) {
+      printf("Wrong result for %s\n", key);
+      failure = 1;
+    }
+  }
+
+  count = 0;
+  for(ent = ht->first; ent; ent = ent->hdr.next) {
+    ++count;
+  }
+
+  printf("%d entries, %d listed, 2^%d slots\n", (int) ht->count, count, ht->slot_bits);
+  if(count != 50000 || ht->count != 50000 || check_slots(ht)) {
+    failure = 1;
+  }
+
+  pytt_robin_destroy(ht);
+
+  // Fill to 90% and churn: probe lengths must not creep up with removals.
+  ht = pytt_robin_create(16, sizeof(int));
+  for(i = 0; i != 58982; ++i) {
+    sprintf(key, "key%d", i);
+    pytt_robin_entry_create(ht, key, strlen(key) + 1);
+  }
+
+  pytt_robin_probe_stats(ht, &before, &mean);
+  printf("Load %.3f: longest probe %u, mean %.3f\n",
+	 (double) ht->count / (1 << ht->slot_bits), before, mean);
+
+  for(round = 1; round != 20; ++round) {
+    for(i = 0; i < 58982; i += 3) {
+      sprintf(key, "key%d", (round - 1) * 58982 + i);
+      pytt_robin_entry_remove(ht, key, strlen(key) + 1);
+      sprintf(key, "key%d", round * 58982 + i);
+      pytt_robin_entry_create(ht, key, strlen(key) + 1);
+    }
+    for(i = 1; i < 58982; i += 3) {
+      sprintf(key, "key%d", (round - 1) * 58982 + i);
+      pytt_robin_entry_remove(ht, key, strlen(key) + 1);
+      sprintf(key, "key%d", round * 58982 + i);
+      pytt_robin_entry_create(ht, key, strlen(key) + 1);
+    }
+    for(i = 2; i < 58982; i += 3) {
+      sprintf(key, "key%d", (round - 1) * 58982 + i);
+      pytt_robin_entry_remove(ht, key, strlen(key) + 1);
+      sprintf(key, "key%d", round * 58982 + i);
+      pytt_robin_entry_create(ht, key, strlen(key) + 1);
+    }
+  }
+
+  pytt_robin_probe_stats(ht, &longest, &mean);
+  printf("After churn: longest probe %u, mean %.3f\n", longest, mean);
+
+  if(ht->slot_bits != 16 || ht->count != 58982 || check_slots(ht) || mean > 6.0) {
+    failure = 1;
+  }
+
+  for(i = 0; i != 58982; ++i) {
+    sprintf(key, "key%d", 19 * 58982 + i);
+    if(! pytt_robin_entry_get(ht, key, strlen(key) + 1)) {
+      printf("Lost %s\n", key);
+      failure = 1;
+      break;
+    }
+  }
+
+  printf("Robin Hood test %s.\n", failure ? "failed" : "succeeded");
+
+  pytt_robin_destroy(ht);
+
+  return failure;
+}
@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pytt_shm.h"
+
+typedef struct pair_t
+{
+  int value;
+  int twice;
+} pair_t;
+
+/* Keys below n must all be there, with their value plus offset. */
+static int check(pytt_shm_t *shm, int n, int offset, const char *what)
+{
+  pair_t pair;
+  char key[32];
+  int i;
+
+  for(i = 0; i != n; ++i) {
+    sprintf(key, "key%d", i);
+    if(! pytt_shm_get(shm, key, strlen(key), &pair) || pair.value != i + offset) {
+      printf("Wrong result for %s %s\n", key, what);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Reads while the parent writes, and fails if it ever sees half a pair. */
+static int reader(pytt_shm_t *shm)
+{
+  pair_t pair;
+  int round, torn = 0, seen = 0;
+
+  for(round = 0; round != 200000; ++round) {
+    if(pytt_shm_get(shm, "hot", 3, &pair)) {
+      torn |= pair.twice != 2 * pair.value;
+      ++seen;
+    }
+  }
+
+  return torn || ! seen;
+}
+
+#define BIG_WORDS 1024
+#define BIG_KEYS  64
+
+/* A writer killed in the middle of a put leaves the lock with a dead
+ * owner and seq odd. Everyone else must get going again, and only the
+ * entry it was writing may be torn. Returns 1 if the kill ever landed
+ * inside a write, 0 if not, or -1 on failure. */
+static int killed_writer(void)
+{
+  static int big[BIG_WORDS];
+  struct timespec pause;
+  pytt_shm_t *shm;
+  char key[32];
+  int attempt, i, j, torn, found, hit = 0;
+  pid_t pid;
+
+  for(attempt = 0; attempt != 20 && ! hit; ++attempt) {
+    shm = pytt_shm_create(NULL, 4, sizeof(big), 1 << 20);
+    if(! shm) {
+      return -1;
+    }
+
+    pid = fork();
+    if(pid == 0) {
+      for(i = 0; ; ++i) {
+	for(j = 0; j != BIG_WORDS; ++j) {
+	  big[j] = i;
+	}
+	sprintf(key, "big%d", i % BIG_KEYS);
+	pytt_shm_put(shm, key, strlen(key), big);
+      }
+    }
+
+    pause.tv_sec = 0;
+    pause.tv_nsec = 1000000 + attempt * 500000;
+    nanosleep(&pause, NULL);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    // Anything still waiting on the dead writer trips the alarm.
+    alarm(10);
+    for(i = torn = found = 0; i != BIG_KEYS; ++i) {
+      sprintf(key, "big%d", i);
+      if(pytt_shm_get(shm, key, strlen(key), big) == 1) {
+	++found;
+	for(j = 1; j != BIG_WORDS; ++j) {
+	  if(big[j] != big[0]) {
+	    ++torn;
+	    break;
+	  }
+	}
+      }
+    }
+    hit = pytt_shm_torn(shm);
+
+    if(torn > hit || pytt_shm_count(shm) != (size_t) found
+       || pytt_shm_put(shm, "after", 5, big) || pytt_shm_get(shm, "after", 5, big) != 1) {
+      printf("Wrong table after a writer died\n");
+      pytt_shm_close(shm);
+      return -1;
+    }
+    alarm(0);
+
+    pytt_shm_close(shm);
+  }
+
+  return hit;
+}
+
+int main(int argc, char **argv)
+{
+  char name[64];
+  pytt_shm_t *shm, *other;
+  pair_t pair;
+  char key[32];
+  int failure = 0;
+  int status, i;
+  pid_t pid;
+
+  sprintf(name, "/pytt_shm_test_%d", (int) getpid());
+
+  shm = pytt_shm_create(name, 12, sizeof(pair_t), 1 << 20);
+  if(! shm) {
+    // Some sandboxes have no /dev/shm. Anonymous memory still works.
+    printf("No named shared memory, testing anonymous only\n");
+    name[0] = 0;
+    shm = pytt_shm_create(NULL, 12, sizeof(pair_t), 1 << 20);
+  }
+
+  for(i = 0; i != 10000; ++i) {
+    sprintf(key, "key%d", i);
+    pair.value = i;
+    pair.twice = 2 * i;
+    pytt_shm_put(shm, key, strlen(key), &pair);
+  }
+
+  failure |= check(shm, 10000, 0, "after filling");
+
+  // Another mapping of the same table sees the same entries.
+  if(name[0]) {
+    other = pytt_shm_open(name);
+    if(! other) {
+      printf("Can't open %s\n", name);
+      failure = 1;
+    } else {
+      failure |= check(other, 10000, 0, "in another mapping");
+      pytt_shm_close(other);
+    }
+  }
+
+  // And so does a child, while the parent keeps writing.
+  pair.value = 0;
+  pair.twice = 0;
+  pytt_shm_put(shm, "hot", 3, &pair);
+
+  pid = fork();
+  if(pid == 0) {
+    _exit(check(shm, 10000, 0, "in a child") | reader(shm));
+  }
+
+  for(i = 1; i != 200000; ++i) {
+    pair.value = i;
+    pair.twice = 2 * i;
+    pytt_shm_put(shm, "hot", 3, &pair);
+    if(i % 1000 == 0) {
+      pytt_shm_remove(shm, "hot", 3);
+    }
+  }
+
+  if(pid < 0 || waitpid(pid, &status, 0) != pid || ! WIFEXITED(status) || WEXITSTATUS(status)) {
+    printf("The child saw something wrong\n");
+    failure = 1;
+  }
+
+  // Removed entries go away and their space comes back.
+  for(i = 0; i != 10000; i += 2) {
+    sprintf(key, "key%d", i);
+    if(! pytt_shm_remove(shm, key, strlen(key)) || pytt_shm_get(shm, key, strlen(key), &pair)) {
+      failure = 1;
+    }
+  }
+  if(pytt_shm_count(shm) != 5001) {
+    printf("%lu entries left\n", (unsigned long) pytt_shm_count(shm));
+    failure = 1;
+  }
+
+  for(i = 0; pytt_shm_put(shm, "key0", 4, &pair) == 0 && i != 100000; ++i) {
+    sprintf(key, "more%d", i);
+    if(pytt_shm_put(shm, key, strlen(key), &pair)) {
+      break;
+    }
+  }
+  if(i == 100000) {
+    printf("The table never filled up\n");
+    failure = 1;
+  }
+
+  switch(killed_writer()) {
+  case -1:
+    failure = 1;
+    break;
+  case 0:
+    printf("No kill landed inside a write\n");
+    break;
+  }
+
+  pytt_shm_close(shm);
+  if(name[0]) {
+    pytt_shm_unlink(name);
+    if(pytt_shm_open(name)) {
+      failure = 1;
+    }
+  }
+
+  printf("Shared memory test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+static void fill(pytt_t *ht, int from, int to)
+{
+  int_entry_t *he;
+  char key[32];
+  int i;
+
+  for(i = from; i != to; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+}
+
+static void drop(pytt_t *ht, int from, int to)
+{
+  char key[32];
+  int i;
+
+  for(i = from; i != to; ++i) {
+    sprintf(key, "key%d", i);
+    pytt_entry_remove(ht, key, strlen(key));
+  }
+}
+
+/* Exactly the keys from..to-1 must be there, the list must link up both
+ * ways, and every bucket must be one run of the list. */
+static int check(pytt_t *ht, int from, int to, const char *what)
+{
+  pytt_entry_t *ent, *prev = NULL;
+  int_entry_t *he;
+  size_t count = 0, runs = 0, used = 0, b;
+  char key[32];
+  int i;
+
+  for(i = from; i != to; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_get(ht, key, strlen(key));
+    if(! he || he->value != i) {
+      printf("Wrong result for %s %s\n", key, what);
+      return 1;
+    }
+  }
+
+  for(ent = ht->first; ent; prev = ent, ent = ent->hdr.next) {
+    if(ent->hdr.prev != prev) {
+      printf("Broken list %s\n", what);
+      return 1;
+    }
+    runs += (ent->hdr.flags & PYTT_ENTRY_LAST_IN_BUCKET) != 0;
+    ++count;
+  }
+
+  for(b = 0; b != pytt_get_bucket_count(ht); ++b) {
+    used += ht->buckets[b] != NULL;
+  }
+
+  if(count != (size_t) (to - from) || pytt_get_entry_count(ht) != count || runs != used) {
+    printf("%lu entries, %lu runs in %lu buckets %s\n", (unsigned long) count,
+	   (unsigned long) runs, (unsigned long) used, what);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int run(pytt_t *ht, const char *what)
+{
+  int failure = 0;
+
+  fill(ht, 0, 10000);
+
+  // Shrinking and growing keeps every entry reachable.
+  if(pytt_resize(ht, 8) || ht->bucket_bits != 8) {
+    failure = 1;
+  }
+  failure |= check(ht, 0, 10000, what);
+
+  if(pytt_resize(ht, ht->max_bucket_bits + 1) != -1 || pytt_resize(ht, 14)) {
+    failure = 1;
+  }
+  failure |= check(ht, 0, 10000, what);
+
+  // Compacting keeps them too, in the same order.
+  drop(ht, 0, 9000);
+  if(pytt_compact(ht)) {
+    failure = 1;
+  }
+  failure |= check(ht, 9000, 10000, what);
+
+  // And the table works as before.
+  fill(ht, 0, 9000);
+  drop(ht, 9000, 10000);
+  failure |= check(ht, 0, 9000, what);
+
+  pytt_destroy(ht);
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  pytt_snapshot_t *snap;
+  pytt_entry_t *ent;
+  pytt_t *ht;
+  int failure = 0;
+
+  failure |= run(pytt_create(14, sizeof(int)), "in a chained table");
+  failure |= run(pytt_create_custom(14, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS),
+		 "in a tagged table");
+  failure |= run(pytt_create_custom(14, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_TTL),
+		 "in a TTL table");
+  failure |= run(pytt_create_numa(14, sizeof(int), PYTT_HUGE_PAGES, -1),
+		 "in a huge page table");
+
+  // An arena table comes out of compaction in address order.
+  ht = pytt_create_numa(14, sizeof(int), 0, 0);
+  fill(ht, 0, 10000);
+  drop(ht, 0, 10000);
+  fill(ht, 0, 5000);
+  pytt_compact(ht);
+  for(ent = ht->first; ent && ent->hdr.next; ent = ent->hdr.next) {
+    if((char *) ent->hdr.next < (char *) ent) {
+      printf("Compacted entries out of order\n");
+      failure = 1;
+      break;
+    }
+  }
+  failure |= check(ht, 0, 5000, "after compacting an arena");
+  pytt_destroy(ht);
+
+  // Expiry still finds entries that moved.
+  ht = pytt_create_custom(10, sizeof(int), malloc, free,
+			  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_TTL);
+  pytt_entry_create_ttl(ht, "soon", 4, 10);
+  pytt_entry_create_ttl(ht, "late", 4, 1000);
+  pytt_compact(ht);
+  if(pytt_expire(ht, 20, 0) != 1 || pytt_entry_get(ht, "soon", 4) || ! pytt_entry_get(ht, "late", 4)) {
+    printf("Wrong expiry after compacting\n");
+    failure = 1;
+  }
+  pytt_destroy(ht);
+
+  // An auto-shrinking table follows its size both ways.
+  ht = pytt_create_custom(16, sizeof(int), malloc, free,
+			  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_AUTO_SHRINK);
+  fill(ht, 0, 50000);
+  drop(ht, 100, 50000);
+  failure |= check(ht, 0, 100, "after shrinking");
+  if(ht->bucket_bits > 8) {
+    printf("Still %d bucket bits after shrinking\n", ht->bucket_bits);
+    failure = 1;
+  }
+  fill(ht, 100, 60000);
+  failure |= check(ht, 0, 60000, "after growing");
+  if(ht->bucket_bits != 16) {
+    printf("Only %d bucket bits after growing\n", ht->bucket_bits);
+    failure = 1;
+  }
+
+  // Snapshots pin the layout.
+  snap = pytt_snapshot(ht);
+  if(pytt_resize(ht, 10) != -1 || pytt_compact(ht) != -1) {
+    failure = 1;
+  }
+  drop(ht, 100, 60000);
+  if(ht->bucket_bits != 16) {
+    failure = 1;
+  }
+  pytt_snapshot_destroy(snap);
+  pytt_destroy(ht);
+
+  printf("Shrink test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
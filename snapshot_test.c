@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+static void set(pytt_t *ht, int i, int value)
+{
+  char key[32];
+
+  sprintf(key, "key%d", i);
+  ((int_entry_t *) pytt_entry_create(ht, key, strlen(key)))->value = value;
+}
+
+static void del(pytt_t *ht, int i)
+{
+  char key[32];
+
+  sprintf(key, "key%d", i);
+  pytt_entry_remove(ht, key, strlen(key));
+}
+
+/* Keys below n must have value(i), or be missing where that is -1. */
+static int check(pytt_snapshot_t *snap, int n, int (*value)(int), const char *what)
+{
+  char key[32];
+  int i;
+
+  for(i = 0; i != n; ++i) {
+    int_entry_t *he;
+
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_snapshot_get(snap, key, strlen(key));
+    if(value(i) < 0 ? he != NULL : (! he || he->value != value(i))) {
+      printf("Wrong result for %s %s\n", key, what);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* What the table holds at each stage of the test. */
+static int first(int i)  { return i < 1000 ? i : -1; }
+static int second(int i) { return i % 3 == 0 ? -1 : i < 1000 ? i + 10000 : i < 1500 ? i : -1; }
+
+static void count(pytt_entry_t *ent, void *arg)
+{
+  *(long *) arg += ((int_entry_t *) ent)->value;
+}
+
+static long total(pytt_snapshot_t *snap)
+{
+  long sum = 0;
+  pytt_snapshot_foreach(snap, count, &sum);
+  return sum;
+}
+
+static int run(pytt_t *ht, const char *what)
+{
+  pytt_snapshot_t *s1, *s2, *s3;
+  long sum1 = 0;
+  int failure = 0;
+  int i;
+
+  for(i = 0; i != 1000; ++i) {
+    set(ht, i, i);
+    sum1 += i;
+  }
+
+  // Nothing has changed yet.
+  s1 = pytt_snapshot(ht);
+  failure |= check(s1, 2000, first, what);
+
+  // Remove some, add some, and change the rest through pytt_entry_create.
+  for(i = 0; i != 1500; ++i) {
+    if(i % 3 == 0) {
+      del(ht, i);
+    } else {
+      set(ht, i, i < 1000 ? i + 10000 : i);
+    }
+  }
+
+  failure |= check(s1, 2000, first, what);
+  failure |= total(s1) != sum1;
+
+  // A second snapshot, then changes that both have to be kept from.
+  s2 = pytt_snapshot(ht);
+  for(i = 0; i != 2000; ++i) {
+    set(ht, i, -5);
+  }
+  s3 = pytt_snapshot(ht);
+
+  failure |= check(s1, 2000, first, what);
+  failure |= check(s2, 2000, second, what);
+
+  // Dropping the newer one hands its copies down to the older.
+  pytt_snapshot_destroy(s2);
+  for(i = 0; i != 2000; i += 2) {
+    del(ht, i);
+  }
+  failure |= check(s1, 2000, first, what);
+  failure |= total(s1) != sum1;
+  failure |= total(s3) != -5 * 2000;
+
+  pytt_snapshot_destroy(s1);
+
+  // s3 is left for pytt_destroy.
+  pytt_destroy(ht);
+
+  if(failure) {
+    printf("Snapshots of %s table are wrong\n", what);
+  }
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  int failure = 0;
+
+  // Few buckets, so chains are long and share buckets.
+  failure |= run(pytt_create(6, sizeof(int)), "chained");
+  failure |= run(pytt_create(16, sizeof(int)), "roomy");
+  failure |= run(pytt_create_custom(6, sizeof(int), malloc, free,
+				    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS), "tagged");
+
+  {
+    pytt_intern_t *pool = pytt_intern_create(8);
+    failure |= run(pytt_create_interned(6, sizeof(int), pool), "interned");
+    pytt_intern_destroy(pool);
+  }
+
+  printf("Snapshot test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
@@ -0,0 +1,584 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "pytt.h"
+#include "pytt_cuckoo.h"
+#include "pytt_inline.h"
+#include "pytt_robin.h"
+}
+
+/*
+   The same workloads on pytt tables, the other in-tree backends and
+   std::unordered_map, for picking a configuration with numbers rather
+   than guesses.
+
+   Key sets: the words of data.txt (made unique with a suffix once they
+   run out), random 64-bit integers, and long URL-like strings. Sizes go
+   from L1-resident up to 10 times the last level cache. Each size times
+   insert, get-hit, get-miss, iterate and erase, in ns per key, and prints
+   one row per measurement as CSV, or JSON with -json.
+
+   With -perf, each phase is also measured with hardware counters
+   (cycles, instructions, L1D, LLC, dTLB and branch misses), reported per
+   key. Counters the kernel or the machine doesn't provide are left
+   empty.
+
+   Usage: suite_bench [-json] [-perf] [max_keys]
+
+   max_keys defaults to what fills 10 times the last level cache at about
+   64 bytes per entry, capped at 2^22 so a default run stays short.
+*/
+
+#define MIN_KEYS        (1 << 10)
+#define DEFAULT_CAP     (1 << 22)
+#define OPS_PER_SIZE    (1 << 20)
+
+struct bench_key_t
+{
+  const void    *p;
+  uint16_t       len;
+  const std::string *str;
+  uint64_t       num;
+};
+
+struct workload_t
+{
+  const char    *name;
+  bool           ints;
+  std::vector<std::string> hit_strs, miss_strs;
+  std::vector<uint64_t> hit_nums, miss_nums;
+  std::vector<bench_key_t> hits, misses;
+};
+
+typedef struct u64_entry_t
+{
+  PYTT_HDR;
+  uint64_t value;
+} u64_entry_t;
+
+PYTT_INLINE_TYPED(u64_entry_t, u64_table, uint64_t)
+
+static unsigned int bits_for(size_t n)
+{
+  unsigned int bits = 0;
+
+  while(((size_t) 1 << bits) < n) {
+    ++bits;
+  }
+
+  return bits;
+}
+
+/* Backends. Each is a set of static functions on an opaque table, so the
+ * timing loops get specialized for every one of them. */
+
+struct pytt_backend
+{
+  static const char *name() { return "pytt"; }
+  static bool supports(const workload_t &) { return true; }
+  static void *create(const workload_t &, size_t n) { return pytt_create(bits_for(n), sizeof(uint64_t)); }
+  static void insert(void *ht, const bench_key_t &k, uint64_t v)
+  { *(uint64_t *) pytt_entry_create((pytt_t *) ht, k.p, k.len)->data = v; }
+  static bool get(void *ht, const bench_key_t &k)
+  { return pytt_entry_get((pytt_t *) ht, k.p, k.len) != NULL; }
+  static void erase(void *ht, const bench_key_t &k)
+  { pytt_entry_remove((pytt_t *) ht, k.p, k.len); }
+  static uint64_t iterate(void *ht)
+  {
+    uint64_t sum = 0;
+    for(pytt_entry_t *ent = ((pytt_t *) ht)->first; ent; ent = ent->hdr.next) {
+      sum += *(uint64_t *) ent->data;
+    }
+    return sum;
+  }
+  static void destroy(void *ht) { pytt_destroy((pytt_t *) ht); }
+};
+
+struct pytt_tags_backend : pytt_backend
+{
+  static const char *name() { return "pytt_tags"; }
+  static void *create(const workload_t &, size_t n)
+  {
+    return pytt_create_custom(bits_for(n), sizeof(uint64_t), malloc, free,
+			      PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS);
+  }
+};
+
+struct pytt_inline_backend
+{
+  static const char *name() { return "pytt_inline"; }
+  static bool supports(const workload_t &w) { return w.ints; }
+  static void *create(const workload_t &, size_t n) { return u64_table_create(bits_for(n)); }
+  static void insert(void *ht, const bench_key_t &k, uint64_t v)
+  { u64_table_entry_create((u64_table_t *) ht, k.num)->value = v; }
+  static bool get(void *ht, const bench_key_t &k)
+  { return u64_table_entry_get((u64_table_t *) ht, k.num) != NULL; }
+  static void erase(void *ht, const bench_key_t &k)
+  { u64_table_entry_remove((u64_table_t *) ht, k.num); }
+  static uint64_t iterate(void *ht)
+  {
+    uint64_t sum = 0;
+    for(u64_entry_t *ent = ((u64_table_t *) ht)->first; ent; ent = u64_table_entry_next(ent)) {
+      sum += ent->value;
+    }
+    return sum;
+  }
+  static void destroy(void *ht) { u64_table_destroy((u64_table_t *) ht); }
+};
+
+struct cuckoo_backend
+{
+  static const char *name() { return "cuckoo"; }
+  static bool supports(const workload_t &) { return true; }
+  /* Four slots per bucket and room to spare. */
+  static void *create(const workload_t &, size_t n) { return pytt_cuckoo_create(bits_for(n / 3 + 1), sizeof(uint64_t)); }
+  static void insert(void *ht, const bench_key_t &k, uint64_t v)
+  { *(uint64_t *) pytt_cuckoo_entry_create((pytt_cuckoo_t *) ht, k.p, k.len)->data = v; }
+  static bool get(void *ht, const bench_key_t &k)
+  { return pytt_cuckoo_entry_get((pytt_cuckoo_t *) ht, k.p, k.len) != NULL; }
+  static void erase(void *ht, const bench_key_t &k)
+  { pytt_cuckoo_entry_remove((pytt_cuckoo_t *) ht, k.p, k.len); }
+  static uint64_t iterate(void *ht)
+  {
+    uint64_t sum = 0;
+    for(pytt_entry_t *ent = ((pytt_cuckoo_t *) ht)->first; ent; ent = ent->hdr.next) {
+      sum += *(uint64_t *) ent->data;
+    }
+    return sum;
+  }
+  static void destroy(void *ht) { pytt_cuckoo_destroy((pytt_cuckoo_t *) ht); }
+};
+
+struct robin_backend
+{
+  static const char *name() { return "robin"; }
+  static bool supports(const workload_t &) { return true; }
+  static void *create(const workload_t &, size_t n) { return pytt_robin_create(bits_for(n + n / 8), sizeof(uint64_t)); }
+  static void insert(void *ht, const bench_key_t &k, uint64_t v)
+  { *(uint64_t *) pytt_robin_entry_create((pytt_robin_t *) ht, k.p, k.len)->data = v; }
+  static bool get(void *ht, const bench_key_t &k)
+  { return pytt_robin_entry_get((pytt_robin_t *) ht, k.p, k.len) != NULL; }
+  static void erase(void *ht, const bench_key_t &k)
+  { pytt_robin_entry_remove((pytt_robin_t *) ht, k.p, k.len); }
+  static uint64_t iterate(void *ht)
+  {
+    uint64_t sum = 0;
+    for(pytt_entry_t *ent = ((pytt_robin_t *) ht)->first; ent; ent = ent->hdr.next) {
+      sum += *(uint64_t *) ent->data;
+    }
+    return sum;
+  }
+  static void destroy(void *ht) { pytt_robin_destroy((pytt_robin_t *) ht); }
+};
+
+/* std::unordered_map keyed by std::string, or by the integer itself for
+ * the integer keys, which is how it would be used for either. */
+struct std_backend
+{
+  typedef std::unordered_map<std::string, uint64_t> str_map;
+  typedef std::unordered_map<uint64_t, uint64_t> num_map;
+
+  struct table { bool ints; str_map strs; num_map nums; };
+
+  static const char *name() { return "std_unordered_map"; }
+  static bool supports(const workload_t &) { return true; }
+  static void *create(const workload_t &w, size_t n)
+  {
+    table *t = new table;
+    t->ints = w.ints;
+    if(w.ints) {
+      t->nums.reserve(n);
+    } else {
+      t->strs.reserve(n);
+    }
+    return t;
+  }
+  static void insert(void *ht, const bench_key_t &k, uint64_t v)
+  {
+    table *t = (table *) ht;
+    if(t->ints) {
+      t->nums[k.num] = v;
+    } else {
+      t->strs[*k.str] = v;
+    }
+  }
+  static bool get(void *ht, const bench_key_t &k)
+  {
+    table *t = (table *) ht;
+    return t->ints ? t->nums.find(k.num) != t->nums.end() : t->strs.find(*k.str) != t->strs.end();
+  }
+  static void erase(void *ht, const bench_key_t &k)
+  {
+    table *t = (table *) ht;
+    if(t->ints) {
+      t->nums.erase(k.num);
+    } else {
+      t->strs.erase(*k.str);
+    }
+  }
+  static uint64_t iterate(void *ht)
+  {
+    table *t = (table *) ht;
+    uint64_t sum = 0;
+    if(t->ints) {
+      for(num_map::const_iterator i = t->nums.begin(); i != t->nums.end(); ++i) {
+	sum += i->second;
+      }
+    } else {
+      for(str_map::const_iterator i = t->strs.begin(); i != t->strs.end(); ++i) {
+	sum += i->second;
+      }
+    }
+    return sum;
+  }
+  static void destroy(void *ht) { delete (table *) ht; }
+};
+
+/* Workloads */
+
+static void finish_keys(workload_t &w)
+{
+  size_t i;
+
+  w.hits.resize(w.ints ? w.hit_nums.size() : w.hit_strs.size());
+  w.misses.resize(w.hits.size());
+
+  for(i = 0; i != w.hits.size(); ++i) {
+    bench_key_t &h = w.hits[i], &m = w.misses[i];
+
+    if(w.ints) {
+      h.p = &w.hit_nums[i];
+      m.p = &w.miss_nums[i];
+      h.len = m.len = sizeof(uint64_t);
+      h.num = w.hit_nums[i];
+      m.num = w.miss_nums[i];
+      h.str = m.str = NULL;
+    } else {
+      h.p = w.hit_strs[i].data();
+      m.p = w.miss_strs[i].data();
+      h.len = (uint16_t) w.hit_strs[i].size();
+      m.len = (uint16_t) w.miss_strs[i].size();
+      h.str = &w.hit_strs[i];
+      m.str = &w.miss_strs[i];
+      h.num = m.num = 0;
+    }
+  }
+}
+
+/* The second column of data.txt, repeated with a numbered suffix when
+ * more keys are wanted than it has words. Misses get a suffix that no
+ * hit has. */
+static bool make_words(workload_t &w, size_t n)
+{
+  std::vector<std::string> words;
+  char line[256], word[256];
+  FILE *f = fopen("data.txt", "r");
+  size_t i;
+
+  if(! f) {
+    return false;
+  }
+  while(fgets(line, sizeof(line), f)) {
+    if(sscanf(line, "%*s %255s", word) == 1) {
+      words.push_back(word);
+    }
+  }
+  fclose(f);
+
+  if(words.empty()) {
+    return false;
+  }
+
+  w.name = "words";
+  w.ints = false;
+  for(i = 0; i != n; ++i) {
+    const std::string &base = words[i % words.size()];
+    size_t round = i / words.size();
+
+    w.hit_strs.push_back(round ? base + "." + std::to_string(round) : base);
+    w.miss_strs.push_back(base + "~" + std::to_string(i));
+  }
+
+  return true;
+}
+
+static void make_ints(workload_t &w, size_t n)
+{
+  uint64_t hit_state = 1, miss_state = 2;
+  size_t i;
+
+  w.name = "int64";
+  w.ints = true;
+  for(i = 0; i != n; ++i) {
+    w.hit_nums.push_back(bench_rand(&hit_state));
+    w.miss_nums.push_back(bench_rand(&miss_state));
+  }
+}
+
+static void make_urls(workload_t &w, size_t n)
+{
+  static const char *sections[] = { "news", "sport", "products", "users", "static/img" };
+  uint64_t state = 3;
+  char url[256];
+  size_t i;
+
+  w.name = "url";
+  w.ints = false;
+  for(i = 0; i != n; ++i) {
+    uint64_t r = bench_rand(&state);
+
+    snprintf(url, sizeof(url), "https://www.example.com/%s/%lu/item-%016llx.html?ref=home",
+	     sections[r % 5], (unsigned long) i, (unsigned long long) r);
+    w.hit_strs.push_back(url);
+    snprintf(url, sizeof(url), "https://www.example.com/%s/%lu/item-%016llx.html?ref=miss",
+	     sections[r % 5], (unsigned long) i, (unsigned long long) r);
+    w.miss_strs.push_back(url);
+  }
+}
+
+/* Running */
+
+static bool json = false;
+static bool first_row = true;
+
+/* With -perf, hardware counters are read around every phase and reported
+ * per key next to the time. */
+static bool perf = false;
+static bench_counters_t counters;
+
+enum { INSERT, GET_HIT, GET_MISS, ITERATE, ERASE, PHASES };
+
+static const char *const phase_names[PHASES] = {
+  "insert", "get_hit", "get_miss", "iterate", "erase"
+};
+
+struct phase_t
+{
+  double         seconds;
+  /* -1 once a counter has failed to give a value. */
+  int64_t        counts[BENCH_COUNTERS];
+  double         start;
+};
+
+static void phase_begin(phase_t &p)
+{
+  if(perf) {
+    bench_counters_start(&counters);
+  }
+  p.start = bench_now();
+}
+
+static void phase_end(phase_t &p)
+{
+  int64_t values[BENCH_COUNTERS];
+  int c;
+
+  p.seconds += bench_now() - p.start;
+  if(perf) {
+    bench_counters_stop(&counters, values);
+    for(c = 0; c != BENCH_COUNTERS; ++c) {
+      p.counts[c] = p.counts[c] < 0 || values[c] < 0 ? -1 : p.counts[c] + values[c];
+    }
+  }
+}
+
+static void print_header()
+{
+  int c;
+
+  if(json) {
+    printf("[\n");
+    return;
+  }
+
+  printf("workload,table,keys,op,ns");
+  for(c = 0; perf && c != BENCH_COUNTERS; ++c) {
+    printf(",%s", bench_counter_names[c]);
+  }
+  printf("\n");
+}
+
+/* Counters that aren't available are left empty in CSV and null in JSON. */
+static void report(const workload_t &w, const char *table, size_t n, int op,
+		   const phase_t &p, double keys)
+{
+  int c;
+
+  if(json) {
+    printf("%s  {\"workload\": \"%s\", \"table\": \"%s\", \"keys\": %lu, \"op\": \"%s\", \"ns\": %.2f",
+	   first_row ? "" : ",\n", w.name, table, (unsigned long) n, phase_names[op],
+	   p.seconds * 1e9 / keys);
+    for(c = 0; perf && c != BENCH_COUNTERS; ++c) {
+      if(p.counts[c] < 0) {
+	printf(", \"%s\": null", bench_counter_names[c]);
+      } else {
+	printf(", \"%s\": %.3f", bench_counter_names[c], p.counts[c] / keys);
+      }
+    }
+    printf("}");
+  } else {
+    printf("%s,%s,%lu,%s,%.2f", w.name, table, (unsigned long) n, phase_names[op],
+	   p.seconds * 1e9 / keys);
+    for(c = 0; perf && c != BENCH_COUNTERS; ++c) {
+      if(p.counts[c] < 0) {
+	printf(",");
+      } else {
+	printf(",%.3f", p.counts[c] / keys);
+      }
+    }
+    printf("\n");
+  }
+  first_row = false;
+  fflush(stdout);
+}
+
+template<class B>
+static void run(const workload_t &w, size_t n, const std::vector<size_t> &order)
+{
+  size_t rounds = OPS_PER_SIZE / n + 1;
+  phase_t phases[PHASES];
+  uint64_t found = 0;
+  size_t r, i;
+  int op;
+
+  if(! B::supports(w)) {
+    return;
+  }
+
+  memset(phases, 0, sizeof(phases));
+
+  for(r = 0; r != rounds; ++r) {
+    void *ht = B::create(w, n);
+
+    phase_begin(phases[INSERT]);
+    for(i = 0; i != n; ++i) {
+      B::insert(ht, w.hits[i], i);
+    }
+    phase_end(phases[INSERT]);
+
+    phase_begin(phases[GET_HIT]);
+    for(i = 0; i != n; ++i) {
+      found += B::get(ht, w.hits[order[i]]);
+    }
+    phase_end(phases[GET_HIT]);
+
+    phase_begin(phases[GET_MISS]);
+    for(i = 0; i != n; ++i) {
+      found += B::get(ht, w.misses[order[i]]);
+    }
+    phase_end(phases[GET_MISS]);
+
+    phase_begin(phases[ITERATE]);
+    found += B::iterate(ht);
+    phase_end(phases[ITERATE]);
+
+    phase_begin(phases[ERASE]);
+    for(i = 0; i != n; ++i) {
+      B::erase(ht, w.hits[order[i]]);
+    }
+    phase_end(phases[ERASE]);
+
+    B::destroy(ht);
+  }
+
+  bench_sink = found;
+
+  for(op = 0; op != PHASES; ++op) {
+    report(w, B::name(), n, op, phases[op], (double) n * rounds);
+  }
+}
+
+static void run_all(workload_t &w, size_t n)
+{
+  std::vector<size_t> order(n);
+  uint64_t state = 4;
+  size_t i;
+
+  finish_keys(w);
+
+  /* Lookups and erases go in a random order, so large tables miss. */
+  for(i = 0; i != n; ++i) {
+    order[i] = i;
+  }
+  for(i = n - 1; i > 0; --i) {
+    size_t j = bench_rand(&state) % (i + 1), t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+
+  run<pytt_backend>(w, n, order);
+  run<pytt_tags_backend>(w, n, order);
+  run<pytt_inline_backend>(w, n, order);
+  run<cuckoo_backend>(w, n, order);
+  run<robin_backend>(w, n, order);
+  run<std_backend>(w, n, order);
+}
+
+int main(int argc, char **argv)
+{
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  size_t max_keys, n;
+  int arg = 1;
+
+  for(; arg < argc && argv[arg][0] == '-'; ++arg) {
+    if(! strcmp(argv[arg], "-json")) {
+      json = true;
+    } else if(! strcmp(argv[arg], "-perf")) {
+      perf = true;
+    }
+  }
+
+  if(perf && ! bench_counters_open(&counters)) {
+    fprintf(stderr, "No hardware counters available, reporting times only.\n");
+    perf = false;
+  }
+
+  if(llc <= 0) {
+    llc = 8 << 20;
+  }
+  max_keys = (size_t) llc * 10 / 64;
+  if(max_keys > DEFAULT_CAP) {
+    max_keys = DEFAULT_CAP;
+  }
+  if(arg < argc && atol(argv[arg]) > 0) {
+    max_keys = atol(argv[arg]);
+  }
+
+  print_header();
+
+  /* Steps of 8x: 1k keys fit in L1, the last size is max_keys. */
+  for(n = MIN_KEYS; ; n = n * 8 < max_keys ? n * 8 : max_keys) {
+    workload_t words, ints, urls;
+
+    if(make_words(words, n)) {
+      run_all(words, n);
+    }
+    make_ints(ints, n);
+    run_all(ints, n);
+    make_urls(urls, n);
+    run_all(urls, n);
+
+    if(n >= max_keys) {
+      break;
+    }
+  }
+
+  if(json) {
+    printf("\n]\n");
+  }
+
+  if(perf) {
+    bench_counters_close(&counters);
+  }
+
+  return 0;
+}
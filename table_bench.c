@@ -0,0 +1,233 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pytt.h"
+#include "pytt_cuckoo.h"
+#include "pytt_frozen.h"
+#include "pytt_robin.h"
+
+/*
+   Lookup latency of the table backends on the same keys, reported as
+   mean and tail percentiles. Every lookup is timed on its own, so the
+   numbers include the clock overhead, but it is the same for all.
+
+   The tables are filled to 90% of 2^key_bits buckets or slots, which is
+   where open addressing starts to hurt.
+
+   Usage: table_bench [key_bits] [lookups] [data_size]
+*/
+
+/* Bytes of data per entry. Large values show how much a table touches
+ * entries it doesn't return. */
+static size_t data_size = sizeof(uint64_t);
+
+typedef struct backend_t
+{
+  const char *name;
+  void       *(*create)(int key_bits);
+  void        (*insert)(void *ht, const uint64_t *key);
+  /* Optional, turns the filled table into the one to look up in. */
+  void       *(*finish)(void *ht);
+  int         (*lookup)(void *ht, const uint64_t *key);
+  /* Optional, for tables that can't remove. */
+  void        (*remove)(void *ht, const uint64_t *key);
+  void        (*destroy)(void *ht);
+} backend_t;
+
+static void *chained_create(int key_bits)
+{
+  return pytt_create(key_bits, data_size);
+}
+
+static void *tagged_create(int key_bits)
+{
+  return pytt_create_custom(key_bits, data_size, malloc, free,
+			    PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS);
+}
+
+static void chained_insert(void *ht, const uint64_t *key)
+{
+  pytt_entry_create(ht, key, sizeof(*key));
+}
+
+static int chained_lookup(void *ht, const uint64_t *key)
+{
+  return pytt_entry_get(ht, key, sizeof(*key)) != NULL;
+}
+
+static void chained_remove(void *ht, const uint64_t *key)
+{
+  pytt_entry_remove(ht, key, sizeof(*key));
+}
+
+static void chained_destroy(void *ht)
+{
+  pytt_destroy(ht);
+}
+
+static void *cuckoo_create(int key_bits)
+{
+  /* Start small and let it grow to its working size. */
+  return pytt_cuckoo_create(key_bits > 4 ? key_bits - 4 : 0, data_size);
+}
+
+static void cuckoo_insert(void *ht, const uint64_t *key)
+{
+  pytt_cuckoo_entry_create(ht, key, sizeof(*key));
+}
+
+static int cuckoo_lookup(void *ht, const uint64_t *key)
+{
+  return pytt_cuckoo_entry_get(ht, key, sizeof(*key)) != NULL;
+}
+
+static void cuckoo_remove(void *ht, const uint64_t *key)
+{
+  pytt_cuckoo_entry_remove(ht, key, sizeof(*key));
+}
+
+static void cuckoo_destroy(void *ht)
+{
+  pytt_cuckoo_destroy(ht);
+}
+
+static void *robin_create(int key_bits)
+{
+  return pytt_robin_create(key_bits, data_size);
+}
+
+static void robin_insert(void *ht, const uint64_t *key)
+{
+  pytt_robin_entry_create(ht, key, sizeof(*key));
+}
+
+static int robin_lookup(void *ht, const uint64_t *key)
+{
+  return pytt_robin_entry_get(ht, key, sizeof(*key)) != NULL;
+}
+
+static void robin_remove(void *ht, const uint64_t *key)
+{
+  pytt_robin_entry_remove(ht, key, sizeof(*key));
+}
+
+static void robin_destroy(void *ht)
+{
+  pytt_robin_destroy(ht);
+}
+
+static void *frozen_finish(void *ht)
+{
+  pytt_frozen_t *fz = pytt_freeze(ht);
+  pytt_destroy(ht);
+  return fz;
+}
+
+static int frozen_lookup(void *fz, const uint64_t *key)
+{
+  return pytt_frozen_get(fz, key, sizeof(*key)) != NULL;
+}
+
+static void frozen_destroy(void *fz)
+{
+  pytt_frozen_destroy(fz);
+}
+
+static const backend_t backends[] = {
+  { "chained", chained_create, chained_insert, NULL, chained_lookup, chained_remove, chained_destroy },
+  { "tagged",  tagged_create,  chained_insert, NULL, chained_lookup, chained_remove, chained_destroy },
+  { "cuckoo",  cuckoo_create,  cuckoo_insert,  NULL, cuckoo_lookup,  cuckoo_remove,  cuckoo_destroy },
+  { "robin",   robin_create,   robin_insert,   NULL, robin_lookup,   robin_remove,   robin_destroy },
+  { "frozen",  chained_create, chained_insert, frozen_finish, frozen_lookup, NULL, frozen_destroy },
+};
+
+static int compare_ns(const void *a, const void *b)
+{
+  float x = *(const float *) a, y = *(const float *) b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const float *sorted, size_t n, double p)
+{
+  return sorted[(size_t) (p * (n - 1))];
+}
+
+static void run(const backend_t *be, int key_bits, size_t lookups)
+{
+  uint64_t nkeys = ((uint64_t) 1 << key_bits) * 9 / 10;
+  uint64_t state = 1, i, found = 0;
+  float *ns = malloc(lookups * sizeof(float));
+  double start, insert_time, remove_time, total = 0;
+  void *ht = be->create(key_bits);
+
+  start = bench_now();
+  for(i = 0; i != nkeys; ++i) {
+    be->insert(ht, &i);
+  }
+  if(be->finish) {
+    ht = be->finish(ht);
+  }
+  insert_time = bench_now() - start;
+
+  /* Half hits, half misses. */
+  for(i = 0; i != lookups; ++i) {
+    uint64_t key = bench_rand(&state) % (2 * nkeys);
+    double t = bench_now();
+    found += be->lookup(ht, &key);
+    ns[i] = (float) ((bench_now() - t) * 1e9);
+    total += ns[i];
+  }
+
+  start = bench_now();
+  for(i = 0; i < nkeys && be->remove; i += 2) {
+    be->remove(ht, &i);
+  }
+  remove_time = bench_now() - start;
+
+  be->destroy(ht);
+
+  qsort(ns, lookups, sizeof(float), compare_ns);
+
+  printf("%-10s %9.1f ", be->name, insert_time * 1e9 / nkeys);
+  if(be->remove) {
+    printf("%9.1f ", remove_time * 2e9 / nkeys);
+  } else {
+    printf("%9s ", "-");
+  }
+  printf("%9.1f %9.1f %9.1f %9.1f %9.1f\n",
+	 total / lookups, percentile(ns, lookups, 0.5), percentile(ns, lookups, 0.99),
+	 percentile(ns, lookups, 0.999), ns[lookups - 1]);
+
+  bench_sink = found;
+  free(ns);
+}
+
+int main(int argc, char **argv)
+{
+  int key_bits = 20;
+  size_t lookups = 2000000;
+  size_t b;
+
+  if(argc > 1 && atoi(argv[1]) > 0) {
+    key_bits = atoi(argv[1]);
+  }
+  if(argc > 2 && atol(argv[2]) > 0) {
+    lookups = atol(argv[2]);
+  }
+  if(argc > 3 && atol(argv[3]) > 0) {
+    data_size = atol(argv[3]);
+  }
+
+  printf("Buckets: 2^%d, lookups: %lu, data: %lu bytes (ns)\n", key_bits,
+	 (unsigned long) lookups, (unsigned long) data_size);
+  printf("%-10s %9s %9s %9s %9s %9s %9s %9s\n", "",
+	 "insert", "remove", "mean", "p50", "p99", "p999", "max");
+
+  for(b = 0; b != sizeof(backends) / sizeof(backends[0]); ++b) {
+    run(&backends[b], key_bits, lookups);
+  }
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+/* Keys below n must all be there, except every step-th one (none for 0). */
+static int check(pytt_t *ht, int n, int step, const char *what)
+{
+  char key[32];
+  int i;
+
+  for(i = 0; i != n; ++i) {
+    int_entry_t *he;
+
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_get(ht, key, strlen(key));
+    if((step && i % step == 0) ? (he != NULL) : (! he || he->value != i)) {
+      printf("Wrong result for %s %s\n", key, what);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Counts the blocks out, and fails those of at least fail_size bytes. */
+static int blocks;
+static size_t fail_size = (size_t) -1;
+
+static void *counting_alloc(size_t size)
+{
+  if(size >= fail_size) {
+    return NULL;
+  }
+  ++blocks;
+  return malloc(size);
+}
+
+static void counting_free(void *p)
+{
+  --blocks;
+  free(p);
+}
+
+int main(int argc, char **argv)
+{
+  // Few buckets, so chains are longer than the tags and spill over.
+  pytt_t *ht = pytt_create_custom(6, sizeof(int), malloc, free,
+				  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS);
+  int_entry_t *he;
+  char key[32];
+  int failure = 0;
+  int i;
+
+  for(i = 0; i != 2000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+
+  failure |= check(ht, 2000, 0, "after inserting");
+
+  // Removing entries from the tags has to pull spilled ones back in.
+  for(i = 0; i < 2000; i += 3) {
+    sprintf(key, "key%d", i);
+    pytt_entry_remove(ht, key, strlen(key));
+  }
+
+  failure |= check(ht, 2000, 3, "after removing");
+
+  for(i = 0; i < 2000; i += 3) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+
+  failure |= check(ht, 2000, 0, "after reinserting");
+
+  pytt_destroy(ht);
+
+  // Expired entries found through the tags go away like any other.
+  ht = pytt_create_custom(10, sizeof(int), malloc, free,
+			  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS | PYTT_TTL);
+  for(i = 0; i != 1000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create_ttl(ht, key, strlen(key), (i & 1) ? 0 : 10);
+    he->value = i;
+  }
+
+  pytt_set_time(ht, 20);
+  failure |= check(ht, 1000, 2, "after expiry");
+  if(pytt_expire(ht, 20, 0) != 0) {
+    failure = 1;
+  }
+
+  pytt_destroy(ht);
+
+  // The tags come from the table's allocator, aligned, and follow the
+  // buckets in use as the table shrinks and grows again.
+  ht = pytt_create_custom(10, sizeof(int), counting_alloc, counting_free,
+			  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS);
+  for(i = 0; i != 1000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+  if(pytt_resize(ht, 4) || ! ht->tags || ((size_t) ht->tags & 63)) {
+    failure = 1;
+  }
+  failure |= check(ht, 1000, 0, "after shrinking");
+  if(pytt_resize(ht, 10) || ! ht->tags || ((size_t) ht->tags & 63)) {
+    failure = 1;
+  }
+  failure |= check(ht, 1000, 0, "after growing");
+  pytt_destroy(ht);
+  if(blocks) {
+    printf("%d blocks left over\n", blocks);
+    failure = 1;
+  }
+
+  // Without memory for the tags the table does without them.
+  fail_size = 32768;
+  ht = pytt_create_custom(10, sizeof(int), counting_alloc, counting_free,
+			  PYTT_DEFAULT_HASH_INITIALIZER, PYTT_BUCKET_TAGS);
+  if(ht->tags || (ht->flags & PYTT_BUCKET_TAGS)) {
+    failure = 1;
+  }
+  for(i = 0; i != 1000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create(ht, key, strlen(key));
+    he->value = i;
+  }
+  failure |= check(ht, 1000, 0, "without tags");
+  pytt_destroy(ht);
+  fail_size = (size_t) -1;
+
+  printf("Bucket tags test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
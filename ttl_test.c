@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "pytt.h"
+
+typedef struct int_entry_t
+{
+  struct pytt_entry_hdr_t hdr;
+  int value;
+  char key[];
+} int_entry_t;
+
+static int count_entries(pytt_t *ht)
+{
+  pytt_entry_t *ent = ht->first;
+  int count = 0;
+
+  while(ent) {
+    ++count;
+    ent = ent->hdr.next;
+  }
+
+  return count;
+}
+
+int main(int argc, char **argv)
+{
+  pytt_t *ht = pytt_create_custom(6, 4, NULL, NULL, 0x20071023, PYTT_TTL);
+  int_entry_t *he;
+  char key[32];
+  int failure = 0;
+  size_t reaped;
+  int i;
+
+  // 1000 entries expiring at 1..1000, plus some that are far away
+  // and some that never expire.
+  for(i = 0; i != 1000; ++i) {
+    sprintf(key, "key%d", i);
+    he = (int_entry_t *) pytt_entry_create_ttl(ht, key, strlen(key), i + 1);
+    he->value = i;
+  }
+
+  for(i = 0; i != 10; ++i) {
+    sprintf(key, "far%d", i);
+    pytt_entry_create_ttl(ht, key, strlen(key), 50000000 + i);
+    sprintf(key, "forever%d", i);
+    pytt_entry_create(ht, key, strlen(key));
+  }
+
+  // Lazy expiry: key9 expired at 10.
+  pytt_set_time(ht, 10);
+  if(pytt_entry_get(ht, "key9", 4)) {
+    puts("key9 should have expired lazily");
+    failure = 1;
+  }
+  if(! pytt_entry_get(ht, "key10", 5)) {
+    puts("key10 should still be alive");
+    failure = 1;
+  }
+
+  // Reap in small batches. Ticks 1..500 leave 499 dead entries
+  // (key9 is already gone).
+  reaped = 0;
+  while(1) {
+    size_t n = pytt_expire(ht, 500, 64);
+    if(n > 64) {
+      puts("pytt_expire went over budget");
+      failure = 1;
+    }
+    if(! n) {
+      break;
+    }
+    reaped += n;
+  }
+
+  printf("Reaped %d entries at 500, %d left\n", (int) reaped, count_entries(ht));
+  if(reaped != 499 || count_entries(ht) != 520) {
+    failure = 1;
+  }
+
+  // Refreshing a ttl moves the entry in the wheel.
+  pytt_entry_set_ttl(ht, pytt_entry_get(ht, "key600", 6), 10000);
+  reaped = pytt_expire(ht, 1000, 0);
+  printf("Reaped %d entries at 1000, %d left\n", (int) reaped, count_entries(ht));
+  if(reaped != 499 || ! pytt_entry_get(ht, "key600", 6)) {
+    failure = 1;
+  }
+
+  // Re-creating an expired key gives a fresh entry.
+  he = (int_entry_t *) pytt_entry_create(ht, "key600", 6);
+  he->value = -1;
+  pytt_set_time(ht, 20000);
+  he = (int_entry_t *) pytt_entry_create(ht, "key600", 6);
+  if(pytt_entry_get_expiry(ht, (pytt_entry_t *) he) != 0) {
+    puts("re-created entry should not have an expiry");
+    failure = 1;
+  }
+
+  reaped = pytt_expire(ht, 60000000, 0);
+  printf("Reaped %d entries at 60000000, %d left\n", (int) reaped, count_entries(ht));
+  if(reaped != 10 || count_entries(ht) != 11) {
+    failure = 1;
+  }
+
+  for(i = 0; i != 10; ++i) {
+    sprintf(key, "forever%d", i);
+    if(! pytt_entry_get(ht, key, strlen(key))) {
+      printf("%s disappeared\n", key);
+      failure = 1;
+    }
+  }
+
+  pytt_destroy(ht);
+
+  // A far-away entry and a large jump of the clock: the wheel must skip
+  // the empty slots rather than tick through them.
+  {
+    clock_t start = clock();
+    double seconds;
+    int calls;
+
+    ht = pytt_create_custom(6, 4, NULL, NULL, 0x20071023, PYTT_TTL);
+    pytt_entry_create_ttl(ht, "late", 4, 4000000000ULL);
+    pytt_entry_create_ttl(ht, "soon", 4, 1);
+
+    reaped = pytt_expire(ht, 1000000000ULL, 1);
+    reaped += pytt_expire(ht, 1000000000ULL, 1);
+    if(reaped != 1 || pytt_entry_get(ht, "soon", 4) || ! pytt_entry_get(ht, "late", 4)) {
+      puts("Wrong entries after a jump");
+      failure = 1;
+    }
+
+    for(calls = 0; calls != 100 && ! pytt_expire(ht, 5000000000ULL, 0); ++calls) {
+    }
+    if(calls == 100 || count_entries(ht) != 0) {
+      puts("The far entry was never reaped");
+      failure = 1;
+    }
+
+    // It used to take seconds.
+    seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    if(seconds > 0.5) {
+      printf("Jumping the clock took %.2f s\n", seconds);
+      failure = 1;
+    }
+
+    pytt_destroy(ht);
+  }
+
+  printf("TTL test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}
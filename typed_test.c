@@ -32,7 +32,32 @@ int main(int argc, char **argv)
     ie = int_table_entry_next(ie);
   }
 
-  return 0;
+  // Both tables use the default seed, so one hash serves both.
+  {
+    int_table_t *other = int_table_create(8);
+    pytt_hash_t hash = int_table_hash(ht, "four");
+    int failure = 0;
+
+    ie = int_table_entry_create_hashed(other, hash, "four");
+    ie->value = 44;
+
+    if(int_table_entry_get_hashed(ht, hash, "four")->value != 4
+       || int_table_entry_get(other, "four")->value != 44) {
+      failure = 1;
+    }
+
+    int_table_entry_remove_hashed(other, hash, "four");
+    if(int_table_entry_get_hashed(other, hash, "four")) {
+      failure = 1;
+    }
+
+    printf("Prehashed lookups %s.\n", failure ? "failed" : "succeeded");
+
+    int_table_destroy(other);
+    int_table_destroy(ht);
+
+    return failure;
+  }
 }
 
 PYTT_IMPLEMENT_TYPED_WITH_OPTIONS(int_entry_t, int_table,
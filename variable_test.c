@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pytt.h"
+
+/* Key i gets i % 97 bytes of data, each of them (char) i. */
+static size_t size_for(int i)
+{
+  return (size_t) (i % 97);
+}
+
+static void fill(pytt_t *ht, int n)
+{
+  pytt_entry_t *ent;
+  char key[32];
+  int i;
+
+  for(i = 0; i != n; ++i) {
+    sprintf(key, "key%d", i);
+    ent = pytt_entry_create_sized(ht, key, strlen(key), size_for(i));
+    memset(pytt_entry_data(ht, ent), (char) i, size_for(i));
+  }
+}
+
+static int check(pytt_t *ht, int n, const char *what)
+{
+  pytt_entry_t *ent;
+  unsigned char *data;
+  char key[32];
+  size_t j;
+  int i;
+
+  for(i = 0; i != n; ++i) {
+    sprintf(key, "key%d", i);
+    ent = pytt_entry_get(ht, key, strlen(key));
+    if(! ent || pytt_entry_data_size(ht, ent) != size_for(i)
+       || memcmp(pytt_entry_get_key_ptr(ht, ent), key, strlen(key))) {
+      printf("Wrong entry for %s %s\n", key, what);
+      return 1;
+    }
+
+    data = pytt_entry_data(ht, ent);
+    if((size_t) data % sizeof(uint64_t)) {
+      printf("Unaligned data for %s %s\n", key, what);
+      return 1;
+    }
+    for(j = 0; j != size_for(i); ++j) {
+      if(data[j] != (unsigned char) i) {
+	printf("Wrong data for %s %s\n", key, what);
+	return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int run(pytt_t *ht, const char *what)
+{
+  pytt_entry_t *ent;
+  pytt_snapshot_t *snap;
+  int failure = 0;
+
+  fill(ht, 5000);
+  failure |= check(ht, 5000, what);
+
+  // Growing and shrinking keeps the data that fits.
+  ent = pytt_entry_create_sized(ht, "key1", 4, 1000);
+  if(pytt_entry_data_size(ht, ent) != 1000 || ((unsigned char *) pytt_entry_data(ht, ent))[0] != 1) {
+    printf("Growing lost the data %s\n", what);
+    failure = 1;
+  }
+  ent = pytt_entry_set_data_size(ht, ent, size_for(1));
+  if(pytt_entry_get(ht, "key1", 4) != ent) {
+    failure = 1;
+  }
+  failure |= check(ht, 5000, what);
+
+  // Snapshots copy entries with their own sizes.
+  snap = pytt_snapshot(ht);
+  ent = pytt_entry_create_sized(ht, "key2", 4, 500);
+  memset(pytt_entry_data(ht, ent), 0, 500);
+  ent = pytt_snapshot_get(snap, "key2", 4);
+  if(! ent || pytt_entry_data_size(ht, ent) != size_for(2)
+     || ((unsigned char *) pytt_entry_data(ht, ent))[1] != 2) {
+    printf("Snapshot lost the data %s\n", what);
+    failure = 1;
+  }
+  pytt_snapshot_destroy(snap);
+  pytt_entry_set_data_size(ht, pytt_entry_get(ht, "key2", 4), size_for(2));
+  memset(pytt_entry_data(ht, pytt_entry_get(ht, "key2", 4)), 2, size_for(2));
+
+  if(pytt_compact(ht)) {
+    failure = 1;
+  }
+  failure |= check(ht, 5000, what);
+
+  pytt_entry_remove(ht, "key3", 4);
+  if(pytt_entry_get(ht, "key3", 4) || pytt_get_entry_count(ht) != 4999) {
+    failure = 1;
+  }
+
+  pytt_destroy(ht);
+
+  return failure;
+}
+
+int main(int argc, char **argv)
+{
+  pytt_t *ht;
+  int failure = 0;
+
+  failure |= run(pytt_create_custom(8, 0, malloc, free, PYTT_DEFAULT_HASH_INITIALIZER,
+				    PYTT_VARIABLE_DATA), "in a chained table");
+  failure |= run(pytt_create_custom(8, 0, malloc, free, PYTT_DEFAULT_HASH_INITIALIZER,
+				    PYTT_VARIABLE_DATA | PYTT_BUCKET_TAGS), "in a tagged table");
+  failure |= run(pytt_create_custom(8, 0, malloc, free, PYTT_DEFAULT_HASH_INITIALIZER,
+				    PYTT_VARIABLE_DATA | PYTT_TTL), "in a TTL table");
+  failure |= run(pytt_create_numa(8, 0, PYTT_VARIABLE_DATA, 0), "in an arena table");
+
+  // Plain entries get no data, and fixed tables ignore the size.
+  ht = pytt_create_custom(8, 0, malloc, free, PYTT_DEFAULT_HASH_INITIALIZER, PYTT_VARIABLE_DATA);
+  if(pytt_entry_data_size(ht, pytt_entry_create(ht, "plain", 5)) != 0) {
+    failure = 1;
+  }
+  pytt_destroy(ht);
+
+  ht = pytt_create(8, sizeof(int));
+  if(pytt_entry_data_size(ht, pytt_entry_create_sized(ht, "fixed", 5, 100)) != sizeof(int)
+     || pytt_entry_data(ht, pytt_entry_get(ht, "fixed", 5)) != pytt_entry_get(ht, "fixed", 5)->data) {
+    failure = 1;
+  }
+  pytt_destroy(ht);
+
+  printf("Variable data test %s.\n", failure ? "failed" : "succeeded");
+
+  return failure;
+}